@@ -1,19 +1,31 @@
 #include "./builder.hpp"
 
+#include <dds/build/deps_log.hpp>
+#include <dds/build/iter_compilations.hpp>
+#include <dds/build/object_cache.hpp>
 #include <dds/build/plan/compile_exec.hpp>
 #include <dds/build/plan/full.hpp>
+#include <dds/build/prebuilt_cache.hpp>
 #include <dds/catch2_embedded.hpp>
 #include <dds/compdb.hpp>
 #include <dds/error/errors.hpp>
 #include <dds/usage_reqs.hpp>
+#include <dds/util/hash.hpp>
+#include <dds/util/intern.hpp>
 #include <dds/util/log.hpp>
 #include <dds/util/output.hpp>
+#include <dds/util/parallel.hpp>
 #include <dds/util/time.hpp>
 
 #include <fansi/styled.hpp>
 #include <fmt/ostream.h>
+#include <range/v3/iterator/operations.hpp>
+#include <range/v3/view/iota.hpp>
 
+#include <algorithm>
 #include <array>
+#include <functional>
+#include <map>
 #include <set>
 
 using namespace dds;
@@ -22,10 +34,16 @@ using namespace fansi::literals;
 namespace {
 
 struct state {
-    bool generate_catch2_header = false;
-    bool generate_catch2_main   = false;
+    bool generate_catch2_header   = false;
+    bool generate_catch2_main     = false;
+    bool precompile_catch2_header = false;
 };
 
+/// The subdirectory of the build root in which the Catch2 header is precompiled
+const fs::path catch2_pch_subdir = "_catch-2.10.2/pch";
+/// The header that is precompiled for tests that use the Catch2 test driver, within the build root
+const fs::path catch2_pch_header = catch2_pch_subdir / "catch2/catch.hpp";
+
 void log_failure(const test_failure& fail) {
     dds_log(error,
             "Test .br.yellow[{}] .br.red[{}] [Exited {}]"_styled,
@@ -42,6 +60,38 @@ void log_failure(const test_failure& fail) {
     }
 }
 
+/**
+ * Whether the Catch2 header is precompiled with the given toolchain. A toolchain that creates an
+ * object file along with the precompiled header would require that object to be linked into every
+ * test, so the header is not precompiled for such toolchains.
+ */
+bool use_catch2_pch(const toolchain& tc) noexcept {
+    return tc.supports_pch() && !tc.pch_creates_object();
+}
+
+/**
+ * @brief Plan the precompilation of the Catch2 header for the tests that use the Catch2 test
+ * driver. The header is precompiled as part of the build, before those tests are compiled.
+ *
+ * Tests are compiled with additional include directories and warnings, but neither affects
+ * whether a precompiled header can be used. If the header cannot be precompiled, the tests will
+ * include the plain header instead.
+ */
+compile_file_plan plan_catch2_pch(const build_params& params) {
+    fs::path test_include_root = params.out_root / "_catch-2.10.2";
+
+    auto sf = source_file::from_path(test_include_root / "catch2/catch.hpp", test_include_root);
+    assert(sf.has_value());
+
+    auto plan = compile_file_plan::precompile_header(shared_compile_file_rules{},
+                                                     std::move(*sf),
+                                                     "Catch2",
+                                                     catch2_pch_subdir);
+    assert(compile_file_plan::pch_header_path(catch2_pch_subdir, plan.source())
+           == catch2_pch_header);
+    return plan;
+}
+
 lm::library
 prepare_catch2_driver(test_lib test_driver, const build_params& params, build_env_ref env_) {
     fs::path test_include_root = params.out_root / "_catch-2.10.2";
@@ -114,10 +164,11 @@ library_plan prepare_library(state&                  st,
                              const library_root&     lib,
                              const package_manifest& pkg_man) {
     library_build_params lp;
-    lp.out_subdir      = sdt.params.subdir;
-    lp.build_apps      = sdt.params.build_apps;
-    lp.build_tests     = sdt.params.build_tests;
-    lp.enable_warnings = sdt.params.enable_warnings;
+    lp.out_subdir       = sdt.params.subdir;
+    lp.build_apps       = sdt.params.build_apps;
+    lp.build_tests      = sdt.params.build_tests;
+    lp.enable_warnings  = sdt.params.enable_warnings;
+    lp.unity_batch_size = sdt.params.unity_batch_size;
     if (lp.build_tests) {
         if (pkg_man.test_driver == test_lib::catch_
             || pkg_man.test_driver == test_lib::catch_main) {
@@ -126,6 +177,11 @@ library_plan prepare_library(state&                  st,
             if (pkg_man.test_driver == test_lib::catch_main) {
                 lp.test_uses.push_back({".dds", "Catch-Main"});
                 st.generate_catch2_main = true;
+                // Only the test driver may configure Catch2, so every test can use the same
+                // precompiled header
+                if (st.precompile_catch2_header) {
+                    lp.test_pch_header = catch2_pch_header;
+                }
             }
         }
     }
@@ -134,19 +190,31 @@ library_plan prepare_library(state&                  st,
                                 pkg_man.namespace_.str + "/" + lib.manifest().name.str);
 }
 
-package_plan prepare_one(state& st, const sdist_target& sd) {
+package_plan
+prepare_one(state& st, const sdist_target& sd, const std::vector<library_root>& libs) {
     package_plan pkg{sd.sd.manifest.id.name.str, sd.sd.manifest.namespace_.str};
-    auto         libs = collect_libraries(sd.sd.path);
     for (const auto& lib : libs) {
         pkg.add_library(prepare_library(st, sd, lib, sd.sd.manifest));
     }
     return pkg;
 }
 
-build_plan prepare_build_plan(state& st, const std::vector<sdist_target>& sdists) {
+build_plan prepare_build_plan(state&                           st,
+                              const std::vector<sdist_target>& sdists,
+                              const std::vector<bool>&         prebuilt) {
+    // Scanning the source trees of the packages dominates planning, and the packages are
+    // independent, so scan them in parallel
+    std::vector<std::vector<library_root>> libs(sdists.size());
+    parallel_run_or_throw(ranges::views::iota(std::size_t(0), sdists.size()), 0, [&](auto idx) {
+        libs[idx] = collect_libraries(sdists[idx].sd.path);
+    });
+
     build_plan plan;
-    for (const auto& sd_target : sdists) {
-        plan.add_package(prepare_one(st, sd_target));
+    for (std::size_t idx = 0; idx < sdists.size(); ++idx) {
+        auto& pkg = plan.add_package(prepare_one(st, sdists[idx], libs[idx]));
+        if (prebuilt[idx]) {
+            pkg.mark_prebuilt();
+        }
     }
     return plan;
 }
@@ -169,6 +237,8 @@ prepare_ureqs(const build_plan& plan, const toolchain& toolchain, path_ref out_r
             }
         }
     }
+    // Check the requirements of every library up front, rather than when they are first used
+    ureqs.compute_closures();
     return ureqs;
 }
 
@@ -280,116 +350,375 @@ void write_cmake(build_env_ref env, const build_plan& plan, path_ref cmake_out)
 }
 
 /**
- * @brief Calculate a hash of the directory layout of the given directory.
+ * @brief Choose fixed names for the directories whose locations would otherwise be recorded in
+ * compile commands and compiler outputs.
  *
- * Because a tweaks-dir is specifically designed to have files added/removed within it, and
- * its contents are inspected by `__has_include`, we need to have a way to invalidate any caches
- * when the content of that directory changes. We don't care to hash the contents of the files,
- * since those will already break any caches.
+ * Each package directory is named by its package ID. The maps are ordered such that a directory
+ * comes before the directories within it, since compilers apply the last matching prefix map.
+ */
+std::vector<path_prefix_map> path_prefix_maps(const build_params&              params,
+                                              const std::vector<sdist_target>& sdists) {
+    std::vector<path_prefix_map> maps;
+    for (auto& sd : sdists) {
+        maps.push_back({fs::weakly_canonical(sd.sd.path), sd.sd.manifest.id.to_string()});
+    }
+    maps.push_back({fs::weakly_canonical(params.out_root), "dds-out"});
+    if (params.tweaks_dir) {
+        maps.push_back({fs::weakly_canonical(*params.tweaks_dir), "dds-tweaks"});
+    }
+    std::sort(maps.begin(), maps.end(), [](auto& left, auto& right) {
+        return left.from < right.from;
+    });
+    auto dup = std::unique(maps.begin(), maps.end(), [](auto& left, auto& right) {
+        return left.from == right.from;
+    });
+    maps.erase(dup, maps.end());
+    for (auto& map : maps) {
+        dds_log(debug, "Mapping path prefix [{}] to '{}'", map.from.string(), map.to);
+    }
+    return maps;
+}
+
+/**
+ * @brief Calculate a hash of the names and the content of the files in the given tweaks directory
  */
-std::string hash_tweaks_dir(const fs::path& tweaks_dir) {
-    if (!fs::is_directory(tweaks_dir)) {
-        return "0";  // No tweaks directory, no cache to bust
-    }
-    std::vector<fs::path> children{fs::recursive_directory_iterator{tweaks_dir},
-                                   fs::recursive_directory_iterator{}};
-    std::sort(children.begin(), children.end());
-    // A really simple inline djb2 hash
-    std::uint32_t hash = 5381;
-    for (auto& p : children) {
-        for (std::uint32_t c : fs::weakly_canonical(p).string()) {
-            hash = ((hash << 5) + hash) + c;
+std::string hash_tweaks_content(const fs::path& tweaks_dir) {
+    sha256 hash;
+    if (fs::is_directory(tweaks_dir)) {
+        std::vector<fs::path> children{fs::recursive_directory_iterator{tweaks_dir},
+                                       fs::recursive_directory_iterator{}};
+        std::sort(children.begin(), children.end());
+        for (auto& p : children) {
+            hash.update(p.lexically_relative(tweaks_dir).generic_string());
+            hash.update("\n");
+            if (fs::is_regular_file(p)) {
+                hash.update(sha256_file(p));
+            }
         }
     }
-    return std::to_string(hash);
+    return hash.hex_digest();
 }
 
-template <typename Func>
-void with_build_plan(const build_params&              params,
-                     const std::vector<sdist_target>& sdists,
-                     Func&&                           fn) {
-    fs::create_directories(params.out_root);
-    auto db = database::open(params.out_root / ".dds.db");
-
-    state     st;
-    auto      plan  = prepare_build_plan(st, sdists);
-    auto      ureqs = prepare_ureqs(plan, params.toolchain, params.out_root);
-    build_env env{
-        params.toolchain,
-        params.out_root,
-        db,
-        toolchain_knobs{
-            .is_tty     = stdout_is_a_tty(),
-            .tweaks_dir = params.tweaks_dir,
-        },
-        ureqs,
-    };
+/**
+ * The packages of a build that share their outputs through the prebuilt dependency cache
+ */
+struct prebuilt_deps {
+    std::optional<prebuilt_cache> cache;
+    /// The cache key of each sdist of the build, or `nullopt` if its outputs cannot be shared
+    std::vector<std::optional<std::string>> keys;
+    /// Whether the outputs of each sdist were restored from the cache
+    std::vector<bool> restored;
+};
 
-    if (env.knobs.tweaks_dir) {
-        env.knobs.cache_buster = hash_tweaks_dir(*env.knobs.tweaks_dir);
-        dds_log(trace,
-                "Build cache-buster value for tweaks-dir [{}] content is '{}'",
-                *env.knobs.tweaks_dir,
-                *env.knobs.cache_buster);
+/**
+ * @brief Calculate the prebuilt dependency cache key of each of the given sdists.
+ *
+ * The key of a package covers the keys of the packages that it depends on, so that a change
+ * anywhere within its dependency tree will change the key.
+ */
+std::vector<std::optional<std::string>> prebuilt_keys(const build_params&              params,
+                                                      const std::vector<sdist_target>& sdists) {
+    auto tc_fingerprint = toolchain_fingerprint(params.toolchain);
+    auto tweaks_hash    = params.tweaks_dir ? hash_tweaks_content(*params.tweaks_dir) : "";
+
+    std::map<std::string, std::size_t> by_name;
+    for (std::size_t idx = 0; idx < sdists.size(); ++idx) {
+        by_name.emplace(sdists[idx].sd.manifest.id.name.str, idx);
+    }
+
+    std::vector<std::optional<std::string>> keys(sdists.size());
+    std::vector<bool>                       visited(sdists.size());
+    std::function<std::optional<std::string>(std::size_t)> key_of = [&](std::size_t idx) {
+        if (visited[idx]) {
+            // Either already computed, or a dependency cycle, which leaves the package uncached
+            return keys[idx];
+        }
+        visited[idx]   = true;
+        const auto& sd = sdists[idx];
+        if (!sd.params.cacheable) {
+            return keys[idx];
+        }
+        sha256 hash;
+        hash.update(fmt::format("{}\n{}\n{}\n{}\n",
+                                sd.sd.manifest.id.to_string(),
+                                tc_fingerprint,
+                                tweaks_hash,
+                                params.map_path_prefixes));
+        // The parameters that change which outputs are built, and how
+        hash.update(fmt::format("{} {} {} {}\n",
+                                sd.params.enable_warnings,
+                                sd.params.build_apps,
+                                sd.params.build_tests,
+                                sd.params.unity_batch_size));
+        for (auto& dep : sd.sd.manifest.dependencies) {
+            auto found = by_name.find(dep.name.str);
+            if (found == by_name.end()) {
+                // The dependency is not built here, so we cannot tell what it will be
+                return keys[idx];
+            }
+            auto dep_key = key_of(found->second);
+            if (!dep_key) {
+                return keys[idx];
+            }
+            hash.update(*dep_key + "\n");
+        }
+        keys[idx] = hash.hex_digest();
+        return keys[idx];
+    };
+    for (std::size_t idx = 0; idx < sdists.size(); ++idx) {
+        key_of(idx);
     }
+    return keys;
+}
 
-    if (st.generate_catch2_main) {
-        auto catch_lib                  = prepare_test_driver(params, test_lib::catch_main, env);
-        ureqs.add(".dds", "Catch-Main") = catch_lib;
+/**
+ * The directories that hold the outputs of building the given sdist
+ */
+std::vector<fs::path> prebuilt_dirs(const build_params& params, const sdist_target& sd) {
+    return {params.out_root / sd.params.subdir,
+            params.out_root / library_plan::generated_include_root(sd.params.subdir)};
+}
+
+void restore_prebuilt(prebuilt_deps&                   prebuilt,
+                      const build_params&              params,
+                      const std::vector<sdist_target>& sdists) {
+    prebuilt.restored.resize(sdists.size());
+    if (params.use_prebuilt_cache) {
+        prebuilt.cache.emplace(prebuilt_cache::default_path());
+        prebuilt.keys = prebuilt_keys(params, sdists);
     }
-    if (st.generate_catch2_header) {
-        auto catch_lib             = prepare_test_driver(params, test_lib::catch_, env);
-        ureqs.add(".dds", "Catch") = catch_lib;
+    for (std::size_t idx = 0; idx < sdists.size(); ++idx) {
+        auto dirs = prebuilt_dirs(params, sdists[idx]);
+        auto key  = prebuilt.cache ? prebuilt.keys[idx] : std::nullopt;
+        if (key && prebuilt.cache->restore(*key, dirs)) {
+            dds_log(info, "Using prebuilt {}", sdists[idx].sd.manifest.id.to_string());
+            prebuilt.restored[idx] = true;
+        } else {
+            // The outputs will be built in place, and will no longer match what was restored
+            prebuilt_cache::forget_restored(dirs);
+        }
     }
+}
 
-    if (params.generate_compdb) {
-        generate_compdb(plan, env);
+void store_prebuilt(const prebuilt_deps&             prebuilt,
+                    const build_params&              params,
+                    const std::vector<sdist_target>& sdists) {
+    if (!prebuilt.cache) {
+        return;
+    }
+    for (std::size_t idx = 0; idx < sdists.size(); ++idx) {
+        auto& key = prebuilt.keys[idx];
+        if (key && !prebuilt.restored[idx]) {
+            dds_log(debug, "Storing prebuilt {}", sdists[idx].sd.manifest.id.to_string());
+            prebuilt.cache->store(*key, prebuilt_dirs(params, sdists[idx]));
+        }
     }
+}
 
-    plan.render_all(env);
+/**
+ * Whether the given file is within the given directory. Both paths must be canonical.
+ */
+bool is_within(path_ref file, path_ref dir) noexcept {
+    auto mismatch = std::mismatch(dir.begin(), dir.end(), file.begin(), file.end());
+    return mismatch.first == dir.end();
+}
 
-    fn(std::move(env), std::move(plan));
+database open_build_database(path_ref out_root) {
+    fs::create_directories(out_root);
+    return database::open(out_root / ".dds.db");
 }
 
 }  // namespace
 
-void builder::compile_files(const std::vector<fs::path>& files, const build_params& params) const {
-    with_build_plan(params, _sdists, [&](build_env_ref env, build_plan plan) {
-        plan.compile_files(env, params.parallel_jobs, files);
-    });
-}
-
-void builder::build(const build_params& params) const {
-    with_build_plan(params, _sdists, [&](build_env_ref env, const build_plan& plan) {
-        dds::stopwatch sw;
-        plan.compile_all(env, params.parallel_jobs);
-        dds_log(info, "Compilation completed in {:L}ms", sw.elapsed_ms().count());
+struct build_session::impl {
+    std::vector<sdist_target> sdists;
+    build_params              params;
+
+    database                     db;
+    std::unique_ptr<deps_store>  deps;
+    std::vector<path_prefix_map> prefix_maps;
+    std::optional<object_cache>  objects;
+    prebuilt_deps                prebuilt;
+
+    // Modification times of files within these directories are kept between builds
+    std::vector<fs::path> kept_stat_dirs;
+    stat_cache            stats;
+    include_probe_cache   probes;
+
+    /// The build plan, and the environment in which it is executed
+    struct prepared_plan {
+        build_plan               plan;
+        usage_requirement_map    ureqs;
+        std::optional<build_env> env;
+    };
+    std::unique_ptr<prepared_plan> prepared;
+
+    impl(std::vector<sdist_target> sdists_, build_params params_)
+        : sdists(std::move(sdists_))
+        , params(std::move(params_))
+        , db(open_build_database(params.out_root)) {
+        if (params.use_deps_log) {
+            deps = std::make_unique<deps_log>(deps_log::open(params.out_root / ".dds.deps"));
+        } else {
+            deps = make_database_deps_store(db);
+        }
+        deps = make_memoized_deps_store(std::move(deps));
 
-        sw.reset();
-        plan.archive_all(env, params.parallel_jobs);
-        dds_log(info, "Archiving completed in {:L}ms", sw.elapsed_ms().count());
+        if (params.map_path_prefixes) {
+            prefix_maps = path_prefix_maps(params, sdists);
+        }
 
-        sw.reset();
-        plan.link_all(env, params.parallel_jobs);
-        dds_log(info, "Runtime binary linking completed in {:L}ms", sw.elapsed_ms().count());
+        if (params.use_object_cache) {
+            objects.emplace(object_cache::default_path(),
+                            params.object_cache_size ? params.object_cache_size
+                                                     : object_cache::default_max_size,
+                            prefix_maps);
+        }
 
-        sw.reset();
-        auto test_failures = plan.run_all_tests(env, params.parallel_jobs);
-        dds_log(info, "Test execution finished in {:L}ms", sw.elapsed_ms().count());
+        restore_prebuilt(prebuilt, params, sdists);
 
-        for (auto& fail : test_failures) {
-            log_failure(fail);
+        for (auto& sd : sdists) {
+            kept_stat_dirs.push_back(fs::weakly_canonical(sd.sd.path));
         }
-        if (!test_failures.empty()) {
-            throw_user_error<errc::test_failure>();
+        if (params.tweaks_dir) {
+            kept_stat_dirs.push_back(fs::weakly_canonical(*params.tweaks_dir));
         }
+    }
 
-        if (params.emit_lmi) {
-            write_lmi(env, plan, params.out_root, *params.emit_lmi);
+    /**
+     * Create the build plan and its environment, unless they are already prepared
+     */
+    prepared_plan& prepare() {
+        // Files outside of the source distributions, including the outputs of the build, may have
+        // changed since the previous build without being reported
+        auto out_root  = fs::weakly_canonical(params.out_root);
+        auto unchecked = [&](path_ref file) {
+            return is_within(file, out_root)
+                || std::none_of(kept_stat_dirs.begin(), kept_stat_dirs.end(), [&](auto& dir) {
+                       return is_within(file, dir);
+                   });
+        };
+        stats.forget_if(unchecked);
+        probes.forget_if(unchecked);
+
+        if (prepared) {
+            return *prepared;
         }
 
-        if (params.emit_cmake) {
-            write_cmake(env, plan, *params.emit_cmake);
+        state st;
+        st.precompile_catch2_header = use_catch2_pch(params.toolchain);
+
+        dds::stopwatch sw;
+        auto           pp = std::make_unique<prepared_plan>();
+        pp->plan  = prepare_build_plan(st, sdists, prebuilt.restored);
+        pp->ureqs = prepare_ureqs(pp->plan, params.toolchain, params.out_root);
+        pp->env.emplace(build_env{
+            params.toolchain,
+            params.out_root,
+            db,
+            *deps,
+            toolchain_knobs{
+                .is_tty      = stdout_is_a_tty(),
+                .tweaks_dir  = params.tweaks_dir,
+                .prefix_maps = prefix_maps,
+            },
+            pp->ureqs,
+            objects ? &*objects : nullptr,
+            &stats,
+            &probes,
+        });
+        auto& env = *pp->env;
+
+        if (st.generate_catch2_main) {
+            auto catch_lib = prepare_test_driver(params, test_lib::catch_main, env);
+            pp->ureqs.add(".dds", "Catch-Main") = catch_lib;
         }
-    });
+        if (st.generate_catch2_header) {
+            auto catch_lib                 = prepare_test_driver(params, test_lib::catch_, env);
+            pp->ureqs.add(".dds", "Catch") = catch_lib;
+        }
+
+        if (st.generate_catch2_main || st.generate_catch2_header) {
+            // Adding the test drivers discarded the closures of the usage requirements
+            pp->ureqs.compute_closures();
+        }
+        if (st.generate_catch2_main && st.precompile_catch2_header) {
+            pp->plan.set_test_pch_compilation(plan_catch2_pch(params));
+        }
+        pp->plan.memoize(env);
+        auto n_compiles = ranges::distance(iter_compilations(pp->plan));
+        auto n_kib      = (pp->plan.memory_usage() + string_table::global().memory_usage()) / 1024;
+        dds_log(info,
+                "Planned {:L} compilations in {:L}ms, using about {:L} KiB of memory",
+                n_compiles,
+                sw.elapsed_ms().count(),
+                n_kib);
+
+        if (params.generate_compdb) {
+            generate_compdb(pp->plan, env);
+        }
+
+        prepared = std::move(pp);
+        return *prepared;
+    }
+};
+
+build_session::build_session(std::vector<sdist_target> sdists, build_params params)
+    : _impl(std::make_unique<impl>(std::move(sdists), std::move(params))) {}
+
+build_session::~build_session() = default;
+
+void build_session::file_changed(path_ref file) {
+    _impl->stats.forget(file);
+    _impl->probes.forget(file);
+}
+
+void build_session::files_added_or_removed() { _impl->prepared.reset(); }
+
+void build_session::compile_files(const std::vector<fs::path>& files) {
+    auto& prepared = _impl->prepare();
+    prepared.plan.render_all(*prepared.env);
+    prepared.plan.compile_files(*prepared.env, _impl->params.parallel_jobs, files);
+}
+
+void build_session::build() {
+    auto& params   = _impl->params;
+    auto& prepared = _impl->prepare();
+    auto& plan     = prepared.plan;
+    auto& env      = *prepared.env;
+    plan.render_all(env);
+
+    test_options tests{
+        .rerun         = params.rerun_tests,
+        .changed_files = params.changed_files,
+        .timeout       = std::chrono::seconds(params.test_timeout),
+    };
+    dds::stopwatch sw;
+    auto           test_failures = plan.build_all(env, params.parallel_jobs, tests);
+    dds_log(info, "Build completed in {:L}ms", sw.elapsed_ms().count());
+
+    store_prebuilt(_impl->prebuilt, params, _impl->sdists);
+
+    for (auto& fail : test_failures) {
+        log_failure(fail);
+    }
+    if (!test_failures.empty()) {
+        throw_user_error<errc::test_failure>();
+    }
+
+    if (params.emit_lmi) {
+        write_lmi(env, plan, params.out_root, *params.emit_lmi);
+    }
+
+    if (params.emit_cmake) {
+        write_cmake(env, plan, *params.emit_cmake);
+    }
+}
+
+void builder::compile_files(const std::vector<fs::path>& files, const build_params& params) const {
+    build_session{_sdists, params}.compile_files(files);
+}
+
+void builder::build(const build_params& params) const {
+    build_session{_sdists, params}.build();
 }
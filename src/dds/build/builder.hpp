@@ -5,6 +5,7 @@
 
 #include <cassert>
 #include <map>
+#include <memory>
 
 namespace dds {
 
@@ -22,6 +23,12 @@ struct sdist_build_params {
     bool build_apps = false;
     /// Whether to enable build warnings
     bool enable_warnings = false;
+    /// Whether the outputs may be shared with other projects through the prebuilt dependency
+    /// cache. Only appropriate for packages that never change, such as those in the package cache.
+    bool cacheable = false;
+    /// If greater than one, the maximum number of source files of a library that are compiled
+    /// together as a single unity batch
+    int unity_batch_size = 0;
 };
 
 /**
@@ -49,6 +56,9 @@ public:
         _sdists.push_back({std::move(sd), std::move(params)});
     }
 
+    /// The source distributions that have been added
+    auto& sdists() const noexcept { return _sdists; }
+
     /**
      * Execute the build
      */
@@ -60,4 +70,48 @@ public:
     void compile_files(const std::vector<fs::path>& files, const build_params& params) const;
 };
 
+/**
+ * The state of building a set of source distributions with a fixed set of parameters, which is kept
+ * between builds: The build database stays open, along with the dependency information that was
+ * loaded from it, the build plan is reused until files are added or removed, and the modification
+ * times of the files of the source distributions are remembered until they are reported to have
+ * changed. This allows a long-running process, such as `dds daemon`, to repeat a build without
+ * rediscovering the whole project.
+ */
+class build_session {
+    struct impl;
+    std::unique_ptr<impl> _impl;
+
+public:
+    /**
+     * Open the build database and restore any prebuilt dependencies. The build plan is created by
+     * the first build.
+     */
+    build_session(std::vector<sdist_target> sdists, build_params params);
+    ~build_session();
+
+    /**
+     * Execute the build
+     */
+    void build();
+
+    /**
+     * Compile one or more source files
+     */
+    void compile_files(const std::vector<fs::path>& files);
+
+    /**
+     * Report that the content of the given file has changed, so that its modification time is
+     * checked again by the next build. Files outside of the source distributions and the tweaks
+     * directory need not be reported, since they are always checked again.
+     */
+    void file_changed(path_ref file);
+
+    /**
+     * Report that files have been added, removed, or renamed, so that the next build creates the
+     * build plan again. Each such file should also be reported to `file_changed()`.
+     */
+    void files_added_or_removed();
+};
+
 }  // namespace dds
@@ -0,0 +1,440 @@
+#include "./deps_log.hpp"
+
+#include <dds/util/log.hpp>
+
+#include <neo/assert.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <string_view>
+#include <system_error>
+
+using namespace dds;
+
+namespace {
+
+/*
+ * The log file begins with an eight-byte magic string and a 32-bit format version. Each record
+ * that follows begins with a 32-bit header, of which the top two bits are the type of the record
+ * and the low thirty bits are the size of the record's payload. Payloads are always a multiple of
+ * four bytes. All integers are stored in the host's byte order, as the log is never shared between
+ * machines.
+ *
+ * - A path record holds the path string, padded with NULs, followed by the bitwise complement of
+ *   the ID that the record assigns to the path. IDs are assigned sequentially from zero, so the
+ *   trailing value catches most forms of corruption.
+ * - A command record holds the output ID, the average duration in milliseconds, the number of
+ *   compilations in that average, the lengths of the command and its output, then the command
+ *   string and output string, padded with NULs.
+ * - A deps record holds the output ID, followed by twelve bytes for each input: The input ID,
+ *   and the modification time of the input when it was recorded.
+ */
+
+constexpr std::string_view log_magic   = "dds-deps";
+constexpr std::uint32_t    log_version = 1;
+
+constexpr std::uint32_t max_payload_size = (1u << 30) - 1;
+constexpr std::size_t   header_size      = log_magic.size() + sizeof(std::uint32_t);
+
+enum class record_type : std::uint32_t {
+    path    = 0,
+    command = 1,
+    deps    = 2,
+};
+
+/// Do not bother compacting the log until it has at least this many superseded records
+constexpr std::size_t min_dead_records_to_compact = 1000;
+
+std::size_t padded_size(std::size_t n) noexcept { return (n + 3) & ~std::size_t(3); }
+
+void put_u32(std::string& buf, std::uint32_t v) {
+    char bytes[sizeof v];
+    std::memcpy(bytes, &v, sizeof v);
+    buf.append(bytes, sizeof v);
+}
+
+void put_i64(std::string& buf, std::int64_t v) {
+    char bytes[sizeof v];
+    std::memcpy(bytes, &v, sizeof v);
+    buf.append(bytes, sizeof v);
+}
+
+void put_padded(std::string& buf, std::string_view str) {
+    buf.append(str);
+    buf.append(padded_size(str.size()) - str.size(), '\0');
+}
+
+void put_record_header(std::string& buf, record_type type, std::size_t payload_size) {
+    neo_assert(expects,
+               payload_size <= max_payload_size && payload_size % 4 == 0,
+               "Invalid dependency log record size",
+               payload_size);
+    put_u32(buf, (static_cast<std::uint32_t>(type) << 30) | std::uint32_t(payload_size));
+}
+
+void put_path_record(std::string& buf, std::string_view path, std::uint32_t id) {
+    put_record_header(buf, record_type::path, padded_size(path.size()) + 4);
+    put_padded(buf, path);
+    put_u32(buf, ~id);
+}
+
+void put_command_record(std::string&                 buf,
+                        std::uint32_t                output_id,
+                        std::uint32_t                n_compilations,
+                        const completed_compilation& cmd) {
+    auto max_ms       = std::int64_t(std::numeric_limits<std::uint32_t>::max());
+    auto avg_ms       = std::clamp(cmd.duration.count(), std::int64_t(0), max_ms);
+    auto strings_size = cmd.quoted_command.size() + cmd.output.size();
+    put_record_header(buf, record_type::command, 20 + padded_size(strings_size));
+    put_u32(buf, output_id);
+    put_u32(buf, std::uint32_t(avg_ms));
+    put_u32(buf, n_compilations);
+    put_u32(buf, std::uint32_t(cmd.quoted_command.size()));
+    put_u32(buf, std::uint32_t(cmd.output.size()));
+    buf.append(cmd.quoted_command);
+    buf.append(cmd.output);
+    buf.append(padded_size(strings_size) - strings_size, '\0');
+}
+
+void put_deps_record(std::string&                      buf,
+                     std::uint32_t                     output_id,
+                     const std::vector<std::uint32_t>& input_ids,
+                     const std::vector<std::int64_t>&  input_mtimes) {
+    put_record_header(buf, record_type::deps, 4 + input_ids.size() * 12);
+    put_u32(buf, output_id);
+    for (auto i = 0u; i < input_ids.size(); ++i) {
+        put_u32(buf, input_ids[i]);
+        put_i64(buf, input_mtimes[i]);
+    }
+}
+
+/**
+ * Reads integers from a byte buffer, without regard for alignment
+ */
+struct byte_reader {
+    std::string_view data;
+
+    std::uint32_t u32(std::size_t offset) const noexcept {
+        std::uint32_t ret;
+        std::memcpy(&ret, data.data() + offset, sizeof ret);
+        return ret;
+    }
+
+    std::int64_t i64(std::size_t offset) const noexcept {
+        std::int64_t ret;
+        std::memcpy(&ret, data.data() + offset, sizeof ret);
+        return ret;
+    }
+};
+
+void write_all(std::ostream& out, const std::string& buf, path_ref path) {
+    errno = 0;
+    out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+    out.flush();
+    if (!out) {
+        auto e = errno ? errno : EIO;
+        throw std::system_error(std::error_code(e, std::system_category()),
+                                "Failed to write to dependency log " + path.string());
+    }
+}
+
+}  // namespace
+
+deps_log::deps_log(path_ref path)
+    : _path(path) {}
+
+deps_log deps_log::open(path_ref path) {
+    deps_log ret{path};
+    ret._load();
+    auto n_live = ret._n_live_records();
+    auto n_dead = ret._n_records - n_live;
+    if (n_dead >= min_dead_records_to_compact && n_dead > n_live) {
+        dds_log(debug,
+                "Compacting dependency log [{}] ({} of {} records are stale)",
+                path.string(),
+                n_dead,
+                ret._n_records);
+        ret._compact();
+    }
+    ret._out = dds::open(path, std::ios::out | std::ios::binary | std::ios::app);
+    return ret;
+}
+
+void deps_log::_write_header(std::ostream& out) const {
+    std::string buf{log_magic};
+    put_u32(buf, log_version);
+    write_all(out, buf, _path);
+}
+
+void deps_log::_load() {
+    std::string content;
+    if (fs::exists(_path)) {
+        auto in = dds::open(_path, std::ios::in | std::ios::binary);
+        std::ostringstream strm;
+        strm << in.rdbuf();
+        content = std::move(strm).str();
+    }
+
+    byte_reader reader{content};
+    if (content.size() < header_size || reader.data.substr(0, log_magic.size()) != log_magic
+        || reader.u32(log_magic.size()) != log_version) {
+        if (!content.empty()) {
+            dds_log(warn,
+                    "Dependency log [{}] is not a valid dependency log, or is from a different "
+                    "version of dds. It will be replaced.",
+                    _path.string());
+        }
+        auto out = dds::open(_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        _write_header(out);
+        return;
+    }
+
+    auto valid_end = header_size;
+    auto pos       = header_size;
+    while (pos + 4 <= content.size()) {
+        auto hdr  = reader.u32(pos);
+        auto type = static_cast<record_type>(hdr >> 30);
+        auto size = std::size_t(hdr & max_payload_size);
+        auto body = pos + 4;
+        if (size % 4 != 0 || size > content.size() - body) {
+            break;
+        }
+        auto n_paths = _paths.size();
+
+        if (type == record_type::path) {
+            if (size < 4 || reader.u32(body + size - 4) != ~std::uint32_t(n_paths)) {
+                break;
+            }
+            auto str = reader.data.substr(body, size - 4);
+            while (!str.empty() && str.back() == '\0') {
+                str.remove_suffix(1);
+            }
+            _ids.emplace(std::string(str), std::uint32_t(n_paths));
+            _paths.emplace_back(str);
+            _entries.emplace_back();
+        } else if (type == record_type::command) {
+            if (size < 20) {
+                break;
+            }
+            auto out_id  = reader.u32(body);
+            auto cmd_len = std::size_t(reader.u32(body + 12));
+            auto out_len = std::size_t(reader.u32(body + 16));
+            if (out_id >= n_paths || 20 + padded_size(cmd_len + out_len) != size) {
+                break;
+            }
+            auto& ent          = _entries[out_id];
+            ent.has_command    = true;
+            ent.n_compilations = reader.u32(body + 8);
+            ent.command        = completed_compilation{
+                std::string(reader.data.substr(body + 20, cmd_len)),
+                std::string(reader.data.substr(body + 20 + cmd_len, out_len)),
+                std::chrono::milliseconds(reader.u32(body + 4)),
+            };
+        } else if (type == record_type::deps) {
+            if (size < 4 || (size - 4) % 12 != 0) {
+                break;
+            }
+            auto out_id   = reader.u32(body);
+            auto n_inputs = (size - 4) / 12;
+            bool okay     = out_id < n_paths;
+            for (auto i = 0u; okay && i < n_inputs; ++i) {
+                okay = reader.u32(body + 4 + i * 12) < n_paths;
+            }
+            if (!okay) {
+                break;
+            }
+            auto& ent    = _entries[out_id];
+            ent.has_deps = true;
+            ent.input_ids.clear();
+            ent.input_mtimes.clear();
+            for (auto i = 0u; i < n_inputs; ++i) {
+                ent.input_ids.push_back(reader.u32(body + 4 + i * 12));
+                ent.input_mtimes.push_back(reader.i64(body + 8 + i * 12));
+            }
+        } else {
+            break;
+        }
+
+        ++_n_records;
+        pos       = body + size;
+        valid_end = pos;
+    }
+
+    if (valid_end != content.size()) {
+        // Probably a write that was interrupted. Everything before the damage is still good.
+        dds_log(warn,
+                "Dependency log [{}] has a damaged tail. {} bytes will be discarded, and some "
+                "files may be recompiled.",
+                _path.string(),
+                content.size() - valid_end);
+        fs::resize_file(_path, valid_end);
+    }
+}
+
+std::size_t deps_log::_n_live_records() const noexcept {
+    std::size_t n = _paths.size();
+    for (auto& ent : _entries) {
+        n += std::size_t(ent.has_command) + std::size_t(ent.has_deps);
+    }
+    return n;
+}
+
+void deps_log::_compact() {
+    // Only keep the paths that are still referenced, and renumber them
+    constexpr auto             unused = ~std::uint32_t(0);
+    std::vector<std::uint32_t> new_ids(_paths.size(), unused);
+    std::vector<std::uint32_t> old_ids;
+    auto                       keep = [&](std::uint32_t id) {
+        if (new_ids[id] == unused) {
+            new_ids[id] = std::uint32_t(old_ids.size());
+            old_ids.push_back(id);
+        }
+    };
+    for (auto id = 0u; id < _entries.size(); ++id) {
+        auto& ent = _entries[id];
+        if (ent.has_command || ent.has_deps) {
+            keep(id);
+            std::for_each(ent.input_ids.begin(), ent.input_ids.end(), keep);
+        }
+    }
+
+    std::vector<std::string> paths;
+    std::vector<entry>       entries;
+    for (auto old_id : old_ids) {
+        auto& ent = entries.emplace_back(std::move(_entries[old_id]));
+        for (auto& input_id : ent.input_ids) {
+            input_id = new_ids[input_id];
+        }
+        paths.push_back(std::move(_paths[old_id]));
+    }
+
+    std::string buf{log_magic};
+    put_u32(buf, log_version);
+    for (auto id = 0u; id < paths.size(); ++id) {
+        put_path_record(buf, paths[id], id);
+    }
+    _n_records = paths.size();
+    for (auto id = 0u; id < entries.size(); ++id) {
+        auto& ent = entries[id];
+        if (ent.has_command) {
+            put_command_record(buf, id, ent.n_compilations, ent.command);
+            ++_n_records;
+        }
+        if (ent.has_deps) {
+            put_deps_record(buf, id, ent.input_ids, ent.input_mtimes);
+            ++_n_records;
+        }
+    }
+
+    // Write the new log next to the old one, then replace it, so that a crash cannot leave us
+    // with a partial log
+    auto tmp_path = _path;
+    tmp_path += ".tmp";
+    {
+        auto out = dds::open(tmp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        write_all(out, buf, tmp_path);
+    }
+    safe_rename(tmp_path, _path);
+
+    _paths   = std::move(paths);
+    _entries = std::move(entries);
+    _ids.clear();
+    _given_ids.clear();
+    for (auto id = 0u; id < _paths.size(); ++id) {
+        _ids.emplace(_paths[id], id);
+    }
+}
+
+std::uint32_t deps_log::_intern(std::string canon_path, std::string& pending) {
+    auto found = _ids.find(canon_path);
+    if (found != _ids.end()) {
+        return found->second;
+    }
+    auto id = std::uint32_t(_paths.size());
+    put_path_record(pending, canon_path, id);
+    ++_n_records;
+    _ids.emplace(canon_path, id);
+    _paths.push_back(std::move(canon_path));
+    _entries.emplace_back();
+    return id;
+}
+
+std::uint32_t deps_log::_id_of(path_ref p, std::string& pending) {
+    // Paths are stored in canonical form, as they are in the build database, but computing the
+    // canonical form is expensive. Remember the paths that we have already resolved.
+    auto key   = p.generic_string();
+    auto found = _given_ids.find(key);
+    if (found != _given_ids.end()) {
+        return found->second;
+    }
+    auto id = _intern(fs::weakly_canonical(p).generic_string(), pending);
+    _given_ids.emplace(std::move(key), id);
+    return id;
+}
+
+void deps_log::record(const std::vector<file_deps_info>& infos) {
+    // Build up all of the new records, then write them at once
+    std::string pending;
+    for (auto& info : infos) {
+        dds_log(trace, "Update dependency info on {}", info.output.string());
+        std::vector<std::uint32_t> input_ids;
+        std::vector<std::int64_t>  input_mtimes;
+        for (auto& input : info.inputs) {
+            input_ids.push_back(_id_of(input, pending));
+            input_mtimes.push_back(recorded_input_mtime(input).time_since_epoch().count());
+        }
+
+        auto  out_id = _id_of(info.output, pending);
+        auto& ent    = _entries[out_id];
+        // Maintain the average duration using the same rules as the build database
+        auto dur = info.command.duration;
+        if (!ent.has_command) {
+            ent.n_compilations = 1;
+        } else if (dur >= std::chrono::milliseconds(500)) {
+            auto n             = std::min(10u, ent.n_compilations + 1);
+            auto avg           = ent.command.duration;
+            ent.n_compilations = n;
+            dur                = avg + (dur - avg) / n;
+        } else {
+            dur = ent.command.duration;
+        }
+        ent.has_command = true;
+        ent.command     = completed_compilation{info.command.quoted_command,
+                                            info.command.output,
+                                            dur};
+        put_command_record(pending, out_id, ent.n_compilations, ent.command);
+
+        ent.has_deps     = true;
+        ent.input_ids    = std::move(input_ids);
+        ent.input_mtimes = std::move(input_mtimes);
+        put_deps_record(pending, out_id, ent.input_ids, ent.input_mtimes);
+        _n_records += 2;
+    }
+    write_all(_out, pending, _path);
+}
+
+std::shared_ptr<const std::vector<recorded_compilation>> deps_log::load_all() const {
+    auto ret = std::make_shared<std::vector<recorded_compilation>>();
+    for (auto id = 0u; id < _entries.size(); ++id) {
+        auto& ent = _entries[id];
+        if (!ent.has_command) {
+            continue;
+        }
+        auto& comp = ret->emplace_back(recorded_compilation{
+            .output_path = _paths[id],
+            .command     = ent.command,
+            .inputs      = {},
+        });
+        comp.inputs.reserve(ent.input_ids.size());
+        for (auto i = 0u; i < ent.input_ids.size(); ++i) {
+            comp.inputs.push_back(input_file_info{
+                _paths[ent.input_ids[i]],
+                fs::file_time_type(fs::file_time_type::duration(ent.input_mtimes[i])),
+            });
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <dds/build/file_deps.hpp>
+#include <dds/util/fs.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dds {
+
+/**
+ * A `deps_store` that keeps dependency information in an append-only binary log file, rather than
+ * in the SQLite build database.
+ *
+ * The log is a short header followed by a sequence of records. A record either introduces a new
+ * path (assigning it the next integer ID), replaces the command of an output, or replaces the set
+ * of inputs of an output. Updating an output appends new records without rewriting the old ones,
+ * and the whole log is read into memory at once when it is opened. Once enough records have been
+ * superseded by later records, the log is rewritten without them when it is next opened.
+ *
+ * If the log ends with an incomplete or corrupt record, such as after a crash during a write, the
+ * damaged tail is discarded and the records before it remain usable.
+ *
+ * A `deps_log` is not safe for concurrent use by multiple threads or processes.
+ */
+class deps_log : public deps_store {
+    struct entry {
+        bool                       has_command    = false;
+        bool                       has_deps       = false;
+        std::uint32_t              n_compilations = 0;
+        completed_compilation      command;
+        std::vector<std::uint32_t> input_ids;
+        std::vector<std::int64_t>  input_mtimes;
+    };
+
+    fs::path     _path;
+    std::fstream _out;
+
+    /// Every known path, indexed by ID
+    std::vector<std::string> _paths;
+    /// The ID of each path, by the path's canonical form
+    std::unordered_map<std::string, std::uint32_t> _ids;
+    /// The ID of paths that have been given to `record()`, as they were given
+    std::unordered_map<std::string, std::uint32_t> _given_ids;
+    /// The recorded information of each output, indexed by the ID of the output's path
+    std::vector<entry> _entries;
+
+    /// The total number of records in the log
+    std::size_t _n_records = 0;
+
+    explicit deps_log(path_ref path);
+
+    void          _load();
+    void          _compact();
+    void          _write_header(std::ostream&) const;
+    std::uint32_t _id_of(path_ref p, std::string& pending);
+    std::uint32_t _intern(std::string canon_path, std::string& pending);
+    std::size_t   _n_live_records() const noexcept;
+
+public:
+    /**
+     * Open the dependency log at the given path, creating it if it does not exist.
+     */
+    static deps_log open(path_ref path);
+
+    deps_log(deps_log&&) = default;
+
+    /// The path to the log file
+    path_ref path() const noexcept { return _path; }
+
+    void record(const std::vector<file_deps_info>& infos) override;
+
+    std::shared_ptr<const std::vector<recorded_compilation>> load_all() const override;
+};
+
+}  // namespace dds
@@ -0,0 +1,189 @@
+#include <dds/build/deps_log.hpp>
+
+#include <dds/db/database.hpp>
+#include <dds/temp.hpp>
+#include <dds/util/time.hpp>
+
+#include <catch2/catch.hpp>
+#include <fmt/core.h>
+
+#include <fstream>
+#include <iostream>
+
+using namespace std::literals;
+
+namespace {
+
+struct tmp_project {
+    dds::temporary_dir tempdir  = dds::temporary_dir::create();
+    dds::fs::path      log_path = tempdir.path() / "deps.log";
+
+    tmp_project() { dds::fs::create_directories(tempdir.path()); }
+
+    dds::fs::path touch(std::string_view name) {
+        auto p = tempdir.path() / name;
+        std::ofstream{p} << "content";
+        return dds::fs::weakly_canonical(p);
+    }
+
+    dds::file_deps_info
+    make_info(const dds::fs::path& out, std::vector<dds::fs::path> inputs, std::string cmd) {
+        return dds::file_deps_info{
+            .output  = out,
+            .inputs  = std::move(inputs),
+            .command = {std::move(cmd), "compiler output", 600ms},
+        };
+    }
+};
+
+}  // namespace
+
+TEST_CASE_METHOD(tmp_project, "Dependency information survives reopening the log") {
+    auto src = touch("foo.cpp");
+    auto hdr = touch("foo.hpp");
+    auto obj = tempdir.path() / "foo.o";
+    {
+        auto log = dds::deps_log::open(log_path);
+        CHECK(log.load_all()->empty());
+        log.record({make_info(obj, {src, hdr}, "cc -c foo.cpp")});
+    }
+
+    auto log   = dds::deps_log::open(log_path);
+    auto comps = *log.load_all();
+    REQUIRE(comps.size() == 1);
+    auto& comp = comps.front();
+    CHECK(comp.output_path == dds::fs::weakly_canonical(obj).generic_string());
+    CHECK(comp.command.quoted_command == "cc -c foo.cpp");
+    CHECK(comp.command.output == "compiler output");
+    CHECK(comp.command.duration == 600ms);
+    REQUIRE(comp.inputs.size() == 2);
+    CHECK(comp.inputs[0].path == src);
+    CHECK(comp.inputs[0].last_mtime == dds::fs::last_write_time(src));
+    CHECK(comp.inputs[1].path == hdr);
+}
+
+TEST_CASE_METHOD(tmp_project, "Recording an output replaces its prior information") {
+    auto src   = touch("foo.cpp");
+    auto hdr   = touch("foo.hpp");
+    auto obj   = tempdir.path() / "foo.o";
+    auto info1 = make_info(obj, {src, hdr}, "cc -c foo.cpp");
+    auto info2 = make_info(obj, {src}, "cc -O2 -c foo.cpp");
+    info2.command.duration = 1600ms;
+    {
+        auto log = dds::deps_log::open(log_path);
+        log.record({info1});
+        log.record({info2});
+    }
+
+    auto comps = *dds::deps_log::open(log_path).load_all();
+    REQUIRE(comps.size() == 1);
+    CHECK(comps[0].command.quoted_command == "cc -O2 -c foo.cpp");
+    CHECK(comps[0].inputs.size() == 1);
+    // The duration is averaged in the same way as the build database
+    CHECK(comps[0].command.duration == 1100ms);
+}
+
+TEST_CASE_METHOD(tmp_project, "A damaged tail of the log is discarded") {
+    auto src  = touch("foo.cpp");
+    auto src2 = touch("bar.cpp");
+    {
+        auto log = dds::deps_log::open(log_path);
+        log.record({make_info(tempdir.path() / "foo.o", {src}, "cc -c foo.cpp")});
+        log.record({make_info(tempdir.path() / "bar.o", {src2}, "cc -c bar.cpp")});
+    }
+
+    // Chop off part of the last record, as if a write was interrupted
+    dds::fs::resize_file(log_path, dds::fs::file_size(log_path) - 6);
+    {
+        auto comps = *dds::deps_log::open(log_path).load_all();
+        REQUIRE(comps.size() == 2);
+        CHECK(comps[0].inputs.size() == 1);
+        // The command of 'bar.o' was written, but its inputs were lost
+        CHECK(comps[1].inputs.empty());
+    }
+
+    // The log remains usable after the damage is removed
+    {
+        auto log = dds::deps_log::open(log_path);
+        log.record({make_info(tempdir.path() / "bar.o", {src2}, "cc -c bar.cpp")});
+    }
+    auto comps = *dds::deps_log::open(log_path).load_all();
+    REQUIRE(comps.size() == 2);
+    CHECK(comps[1].inputs.size() == 1);
+}
+
+TEST_CASE_METHOD(tmp_project, "A log that is not a dependency log is replaced") {
+    std::ofstream{log_path} << "Not a dependency log";
+    auto comps = *dds::deps_log::open(log_path).load_all();
+    CHECK(comps.empty());
+}
+
+TEST_CASE_METHOD(tmp_project, "A log with many stale records is compacted") {
+    auto src = touch("foo.cpp");
+    auto hdr = touch("foo.hpp");
+    auto obj = tempdir.path() / "foo.o";
+    {
+        auto log = dds::deps_log::open(log_path);
+        for (int i = 0; i < 1000; ++i) {
+            log.record({make_info(obj, {src, hdr}, "cc -c foo.cpp -DN=" + std::to_string(i))});
+        }
+    }
+    auto size_before = dds::fs::file_size(log_path);
+
+    auto comps = *dds::deps_log::open(log_path).load_all();
+    CHECK(dds::fs::file_size(log_path) < size_before / 100);
+    REQUIRE(comps.size() == 1);
+    CHECK(comps[0].command.quoted_command == "cc -c foo.cpp -DN=999");
+    CHECK(comps[0].inputs.size() == 2);
+
+    // Opening the log above rewrote it with only the live records. Reading that rewritten log
+    // gives the same information, and new records can be appended to it.
+    auto size_compacted = dds::fs::file_size(log_path);
+    {
+        auto log = dds::deps_log::open(log_path);
+        CHECK(dds::fs::file_size(log_path) == size_compacted);
+        comps = *log.load_all();
+        REQUIRE(comps.size() == 1);
+        CHECK(comps[0].inputs[1].path == hdr);
+        log.record({make_info(obj, {src}, "cc -c foo.cpp -DN=1000")});
+    }
+    comps = *dds::deps_log::open(log_path).load_all();
+    REQUIRE(comps.size() == 1);
+    CHECK(comps[0].command.quoted_command == "cc -c foo.cpp -DN=1000");
+    CHECK(comps[0].inputs.size() == 1);
+}
+
+TEST_CASE_METHOD(tmp_project, "Dependency store load and update time", "[.][bench]") {
+    std::vector<dds::fs::path> headers;
+    for (int i = 0; i < 200; ++i) {
+        headers.push_back(touch(fmt::format("header-{}.hpp", i)));
+    }
+    std::vector<dds::file_deps_info> infos;
+    for (int i = 0; i < 1000; ++i) {
+        auto src = touch(fmt::format("source-{}.cpp", i));
+        auto ins = headers;
+        ins.insert(ins.begin(), src);
+        infos.push_back(make_info(tempdir.path() / fmt::format("source-{}.o", i),
+                                  std::move(ins),
+                                  fmt::format("c++ -c source-{}.cpp", i)));
+    }
+
+    auto db     = dds::database::open(tempdir.path() / "deps.db");
+    auto db_log = dds::make_database_deps_store(db);
+    auto log    = dds::deps_log::open(log_path);
+
+    auto measure = [&](std::string_view name, dds::deps_store& store) {
+        dds::stopwatch timer;
+        store.record(infos);
+        auto update_ms = timer.elapsed_ms().count();
+        timer.reset();
+        auto comps   = store.load_all();
+        auto load_ms = timer.elapsed_ms().count();
+        CHECK(comps->size() == infos.size());
+        std::cout << name << ": Recorded " << infos.size() << " outputs with "
+                  << infos[0].inputs.size() << " inputs each in " << update_ms
+                  << "ms, loaded them in " << load_ms << "ms\n";
+    };
+    measure("Build database", *db_log);
+    measure("Dependency log", log);
+}
@@ -2,6 +2,7 @@
 
 #include <dds/db/database.hpp>
 #include <dds/proc.hpp>
+#include <dds/util/algo.hpp>
 #include <dds/util/log.hpp>
 #include <dds/util/shlex.hpp>
 #include <dds/util/string.hpp>
@@ -10,6 +11,9 @@
 #include <range/v3/view/filter.hpp>
 #include <range/v3/view/transform.hpp>
 
+#include <algorithm>
+#include <system_error>
+
 using namespace dds;
 
 file_deps_info dds::parse_mkfile_deps_file(path_ref where) {
@@ -23,7 +27,13 @@ file_deps_info dds::parse_mkfile_deps_str(std::string_view str) {
     // Remove escaped newlines
     auto no_newlines = replace(str, "\\\n", " ");
 
-    auto split = split_shell_string(str);
+    // Only the first rule names the output and its inputs. When compiling with C++ modules, GCC
+    // writes additional rules for the modules that are provided and imported, which are tracked
+    // separately.
+    auto first_rule = trim_view(no_newlines);
+    first_rule      = first_rule.substr(0, first_rule.find('\n'));
+
+    auto split = split_shell_string(first_rule);
     auto iter  = split.begin();
     auto stop  = split.end();
     if (iter == stop) {
@@ -31,18 +41,17 @@ file_deps_info dds::parse_mkfile_deps_str(std::string_view str) {
                 "Invalid deps listing. Shell split was empty. This is almost certainly a bug.");
         return ret;
     }
-    auto& head = *iter;
-    ++iter;
-    if (!ends_with(head, ":")) {
-        dds_log(
-            critical,
-            "Invalid deps listing. Leader item is not colon-terminated. This is probably a bug. "
-            "(Are you trying to use C++ Modules? That's not ready yet, sorry. Set `Deps-Mode` to "
-            "`None` in your toolchain file.)");
+    // The rule may have more than one target, such as the interface of a module that is provided
+    auto colon = std::find_if(iter, stop, [](const std::string& s) {
+        return s.size() > 1 && ends_with(s, ":");
+    });
+    if (colon == stop) {
+        dds_log(critical,
+                "Invalid deps listing. No target is colon-terminated. This is probably a bug.");
         return ret;
     }
-    ret.output = head.substr(0, head.length() - 1);
-    ret.inputs.insert(ret.inputs.end(), iter, stop);
+    ret.output = colon == iter ? iter->substr(0, iter->length() - 1) : *iter;
+    ret.inputs.insert(ret.inputs.end(), std::next(colon), stop);
     return ret;
 }
 
@@ -67,13 +76,77 @@ msvc_deps_info dds::parse_msvc_output_for_deps(std::string_view output, std::str
     return {deps, cleaned_output};
 }
 
+fs::file_time_type dds::recorded_input_mtime(path_ref input) {
+    std::error_code ec;
+    auto            mtime = fs::last_write_time(input, ec);
+    if (ec == std::errc::no_such_file_or_directory || ec == std::errc::not_a_directory) {
+        return absent_input_mtime;
+    }
+    if (ec) {
+        throw std::system_error(ec, "Failed to get the modification time of " + input.string());
+    }
+    return mtime;
+}
+
+std::vector<std::string> dds::parse_has_include_probes(std::string_view source) {
+    std::vector<std::string> ret;
+    constexpr std::string_view keyword = "__has_include";
+
+    auto pos = source.find(keyword);
+    while (pos != source.npos) {
+        auto rest = source.substr(pos + keyword.size());
+        pos       = source.find(keyword, pos + keyword.size());
+        if (rest.starts_with("_next")) {
+            rest.remove_prefix(5);
+        }
+        rest = trim_view(rest);
+        if (!rest.starts_with('(')) {
+            continue;
+        }
+        rest = trim_view(rest.substr(1));
+        if (rest.empty() || (rest[0] != '<' && rest[0] != '"')) {
+            continue;
+        }
+        auto close = rest.find(rest[0] == '<' ? '>' : '"', 1);
+        auto name  = rest.substr(1, close == rest.npos ? rest.npos : close - 1);
+        if (close == rest.npos || name.empty() || name.find('\n') != name.npos) {
+            continue;
+        }
+        ret.emplace_back(name);
+    }
+    sort_unique_erase(ret);
+    return ret;
+}
+
+std::vector<std::string> include_probe_cache::probes_of(path_ref file, fs::file_time_type mtime) {
+    auto key = file.string();
+    {
+        std::scoped_lock lk{_mut};
+        auto             found = _entries.find(key);
+        if (found != _entries.end() && found->second.mtime == mtime) {
+            return found->second.names;
+        }
+    }
+
+    // Read the file without holding the lock
+    auto names = parse_has_include_probes(slurp_file(file));
+
+    std::scoped_lock lk{_mut};
+    _entries.insert_or_assign(std::move(key), entry{mtime, names});
+    return names;
+}
+
+void include_probe_cache::forget(path_ref file) {
+    std::scoped_lock lk{_mut};
+    _entries.erase(file.string());
+}
+
 void dds::update_deps_info(neo::output<database> db_, const file_deps_info& deps) {
     database& db = db_;
     db.record_compilation(deps.output, deps.command);
     db.forget_inputs_of(deps.output);
     for (auto&& inp : deps.inputs) {
-        auto mtime = fs::last_write_time(inp);
-        db.record_dep(inp, deps.output, mtime);
+        db.record_dep(inp, deps.output, recorded_input_mtime(inp));
     }
 }
 
@@ -92,7 +165,7 @@ std::optional<prior_compilation> dds::get_prior_compilation(const database& db,
     auto  changed_files =  //
         inputs             //
         | ranges::views::filter([](const input_file_info& input) {
-              return !fs::exists(input.path) || fs::last_write_time(input.path) != input.last_mtime;
+              return recorded_input_mtime(input.path) != input.last_mtime;
           })
         | ranges::views::transform([](auto& info) { return info.path; })  //
         | ranges::to_vector;
@@ -101,3 +174,145 @@ std::optional<prior_compilation> dds::get_prior_compilation(const database& db,
     ret.previous_command = cmd;
     return ret;
 }
+
+namespace {
+
+class database_deps_store : public deps_store {
+    database& _db;
+
+public:
+    explicit database_deps_store(database& db)
+        : _db(db) {}
+
+    void record(const std::vector<file_deps_info>& infos) override {
+        auto tr = _db.transaction();
+        for (auto& info : infos) {
+            dds_log(trace, "Update dependency info on {}", info.output.string());
+            update_deps_info(neo::into(_db), info);
+        }
+    }
+
+    std::shared_ptr<const std::vector<recorded_compilation>> load_all() const override {
+        return std::make_shared<const std::vector<recorded_compilation>>(_db.all_compilations());
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<deps_store> dds::make_database_deps_store(database& db) {
+    return std::make_unique<database_deps_store>(db);
+}
+
+namespace {
+
+class memoized_deps_store : public deps_store {
+    std::unique_ptr<deps_store> _inner;
+
+    mutable std::shared_ptr<const std::vector<recorded_compilation>> _loaded;
+
+public:
+    explicit memoized_deps_store(std::unique_ptr<deps_store> inner)
+        : _inner(std::move(inner)) {}
+
+    void record(const std::vector<file_deps_info>& infos) override {
+        if (infos.empty()) {
+            return;
+        }
+        _inner->record(infos);
+        // The store computes the recorded modification times and average durations, so load the
+        // result of this update from the store the next time
+        _loaded.reset();
+    }
+
+    std::shared_ptr<const std::vector<recorded_compilation>> load_all() const override {
+        if (!_loaded) {
+            _loaded = _inner->load_all();
+        }
+        return _loaded;
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<deps_store> dds::make_memoized_deps_store(std::unique_ptr<deps_store> inner) {
+    return std::make_unique<memoized_deps_store>(std::move(inner));
+}
+
+compilation_history::compilation_history(const deps_store& store, stat_cache* stats) {
+    if (stats) {
+        _stats = stats;
+    }
+    // The loaded information may be shared with the store, so refer to it rather than copying it
+    _loaded = store.load_all();
+    for (auto& comp : *_loaded) {
+        if (comp.inputs.empty()) {
+            // get_prior_compilation() treats an output without inputs as never having been built
+            continue;
+        }
+        _by_output.emplace(comp.output_path, &comp);
+    }
+}
+
+const recorded_compilation* compilation_history::_find(path_ref output_path) const {
+    // The database stores canonical paths. Computing a canonical path requires a syscall for every
+    // path component, so first try the cheaper lexical normalization, which is usually the same.
+    auto found = _by_output.find(fs::absolute(output_path).lexically_normal().generic_string());
+    if (found == _by_output.end()) {
+        found = _by_output.find(fs::weakly_canonical(output_path).generic_string());
+    }
+    if (found == _by_output.end()) {
+        return nullptr;
+    }
+    return found->second;
+}
+
+std::optional<prior_compilation> compilation_history::get(path_ref output_path) const {
+    auto found = _find(output_path);
+    if (!found) {
+        return {};
+    }
+
+    auto& comp = *found;
+
+    prior_compilation ret;
+    for (auto& input : comp.inputs) {
+        auto mtime = _stats->last_write_time(input.path).value_or(absent_input_mtime);
+        if (mtime != input.last_mtime) {
+            ret.newer_inputs.push_back(input.path);
+        }
+    }
+    ret.previous_command = comp.command;
+    return ret;
+}
+
+std::unordered_set<std::string>
+compilation_history::outputs_affected_by(const std::vector<fs::path>& changed) const {
+    // Invert the recorded dependencies, mapping each input to the outputs that were built from it
+    std::unordered_map<std::string, std::vector<const std::string*>> outputs_of;
+    for (auto& [output, comp] : _by_output) {
+        for (auto& input : comp->inputs) {
+            outputs_of[input.path.generic_string()].push_back(&comp->output_path);
+        }
+    }
+
+    std::unordered_set<std::string> affected;
+    std::vector<std::string>        queue;
+    for (auto& file : changed) {
+        queue.push_back(file.generic_string());
+    }
+    while (!queue.empty()) {
+        auto file = std::move(queue.back());
+        queue.pop_back();
+        auto found = outputs_of.find(file);
+        if (found == outputs_of.end()) {
+            continue;
+        }
+        for (auto output : found->second) {
+            if (affected.insert(*output).second) {
+                // Outputs that are built from this output are also affected
+                queue.push_back(*output);
+            }
+        }
+    }
+    return affected;
+}
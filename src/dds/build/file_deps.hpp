@@ -29,11 +29,17 @@
 
 #include <dds/db/database.hpp>
 #include <dds/util/fs.hpp>
+#include <dds/util/stat_cache.hpp>
 
 #include <neo/out.hpp>
 
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace dds {
@@ -59,7 +65,9 @@ struct file_deps_info {
      */
     fs::path output;
     /**
-     * The paths to each input
+     * The paths to each input. An input that does not exist is a file that the compilation looked
+     * for but did not find, such as a header that is tested with `__has_include`. Creating such a
+     * file invalidates the output.
      */
     std::vector<fs::path> inputs;
     /**
@@ -113,6 +121,62 @@ struct msvc_deps_info {
  */
 msvc_deps_info parse_msvc_output_for_deps(std::string_view output, std::string_view leader);
 
+/**
+ * The modification time that is recorded for an input that does not exist
+ */
+inline constexpr fs::file_time_type absent_input_mtime = fs::file_time_type::min();
+
+/**
+ * Obtain the modification time of the given input, to be recorded as the time at which it was
+ * used. If the input does not exist, this is `absent_input_mtime`.
+ */
+fs::file_time_type recorded_input_mtime(path_ref input);
+
+/**
+ * Find the headers whose existence is tested with `__has_include` or `__has_include_next` in the
+ * given source text, as they are spelled within the angle brackets or quotes. Tests whose operand
+ * is produced by a macro are not found.
+ */
+std::vector<std::string> parse_has_include_probes(std::string_view source);
+
+/**
+ * A thread-safe cache of the `__has_include` tests of files, as found by
+ * `parse_has_include_probes()`. Most headers are read by many compilations, but each file is only
+ * parsed again when it has been modified since it was last parsed.
+ *
+ * As with `stat_cache`, the owner of a cache that outlives a single build should `forget()` files
+ * as they change, so that the entries of removed files are discarded.
+ */
+class include_probe_cache {
+    struct entry {
+        fs::file_time_type       mtime;
+        std::vector<std::string> names;
+    };
+
+    std::mutex                             _mut;
+    std::unordered_map<std::string, entry> _entries;
+
+public:
+    /**
+     * Get the headers that are tested for by the given file, which was last modified at `mtime`
+     */
+    std::vector<std::string> probes_of(path_ref file, fs::file_time_type mtime);
+
+    /**
+     * Discard the cached tests of the given file, if any
+     */
+    void forget(path_ref file);
+
+    /**
+     * Discard the cached tests of every file for which `pred` returns `true`
+     */
+    template <typename Pred>
+    void forget_if(Pred&& pred) {
+        std::scoped_lock lk{_mut};
+        std::erase_if(_entries, [&](auto& pair) { return pred(fs::path(pair.first)); });
+    }
+};
+
 /**
  * Update the dependency information in the build database for later reference via
  * `get_prior_compilation`.
@@ -121,6 +185,41 @@ msvc_deps_info parse_msvc_output_for_deps(std::string_view output, std::string_v
  */
 void update_deps_info(neo::output<database> db, const file_deps_info& info);
 
+/**
+ * A backend that stores the dependency information of build outputs, for later reference when
+ * checking whether those outputs are up-to-date.
+ */
+class deps_store {
+public:
+    virtual ~deps_store() = default;
+
+    /**
+     * Record new dependency information for the given outputs, replacing any information that was
+     * previously recorded for those outputs. The modification time of each input is recorded as it
+     * is at the time of this call.
+     */
+    virtual void record(const std::vector<file_deps_info>& infos) = 0;
+
+    /**
+     * Load the dependency information of every recorded output. The result is shared rather than
+     * copied, and remains valid after later calls to `record()`.
+     */
+    virtual std::shared_ptr<const std::vector<recorded_compilation>> load_all() const = 0;
+};
+
+/**
+ * Create a `deps_store` that stores dependency information in the given build database, which must
+ * outlive the returned object.
+ */
+std::unique_ptr<deps_store> make_database_deps_store(database& db);
+
+/**
+ * Create a `deps_store` that keeps the dependency information of the given store in memory after
+ * it is first loaded, so that repeated builds do not read the store again unless something new has
+ * been recorded in the meantime.
+ */
+std::unique_ptr<deps_store> make_memoized_deps_store(std::unique_ptr<deps_store> inner);
+
 /**
  * The information that is pertinent to the rebuild of a file. This will contain a list of inputs
  * that have a newer mtime than we have recorded, and the previous command and previous command
@@ -137,4 +236,49 @@ struct prior_compilation {
  */
 std::optional<prior_compilation> get_prior_compilation(const database& db, path_ref output_path);
 
+/**
+ * All of the dependency information from a `deps_store`, loaded at once, for checking many outputs
+ * for being out-of-date. `get()` may be called concurrently from any number of threads. The
+ * modification time of each distinct input file is only checked once, no matter how many outputs
+ * depend upon it.
+ */
+class compilation_history {
+    std::shared_ptr<const std::vector<recorded_compilation>>           _loaded;
+    std::unordered_map<std::string_view, const recorded_compilation*> _by_output;
+    mutable stat_cache                                                 _own_stats;
+    stat_cache*                                                        _stats = &_own_stats;
+
+    const recorded_compilation* _find(path_ref output_path) const;
+
+public:
+    /**
+     * Load the dependency information from the given store
+     * @param stats If non-null, the modification times of inputs are checked through this cache,
+     * which may outlive the history. Otherwise, the history has a cache of its own.
+     */
+    explicit compilation_history(const deps_store& store, stat_cache* stats = nullptr);
+    compilation_history(const compilation_history&) = delete;
+
+    /**
+     * Equivalent to `get_prior_compilation()`, but using the information that was loaded when the
+     * history was created.
+     */
+    std::optional<prior_compilation> get(path_ref output_path) const;
+
+    /**
+     * Determine whether any dependency information was recorded for the given output
+     */
+    bool contains(path_ref output_path) const { return _find(output_path) != nullptr; }
+
+    /**
+     * Find every recorded output that was built from any of the given files, either directly or
+     * through other recorded outputs. For example, a changed header affects the objects that were
+     * compiled with it, the archives that contain those objects, and the executables that link
+     * those archives.
+     * @param changed The canonical paths of the changed files
+     * @return The canonical paths of the affected outputs
+     */
+    std::unordered_set<std::string> outputs_affected_by(const std::vector<fs::path>& changed) const;
+};
+
 }  // namespace dds
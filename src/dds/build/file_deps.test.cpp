@@ -1,7 +1,12 @@
 #include <dds/build/file_deps.hpp>
 
+#include <dds/temp.hpp>
+
 #include <catch2/catch.hpp>
 
+#include <fstream>
+#include <unordered_set>
+
 auto path_vec = [](auto... args) { return std::vector<dds::fs::path>{args...}; };
 
 TEST_CASE("Parse Makefile deps") {
@@ -21,6 +26,23 @@ TEST_CASE("Parse Makefile deps") {
     CHECK(deps.inputs == path_vec("/foo.main.cpp", "/stdc-predef.h"));
 }
 
+TEST_CASE("Parse Makefile deps of a module unit") {
+    // GCC writes additional rules for modules, which are ignored
+    auto deps = dds::parse_mkfile_deps_str("foo.o /out/foo.gcm: foo.cpp \\\n"
+                                           " /stdc-predef.h\n"
+                                           "foo.c++m: /out/foo.gcm\n"
+                                           ".PHONY: foo.c++m\n"
+                                           "/out/foo.gcm:| foo.o\n");
+    CHECK(deps.output == "foo.o");
+    CHECK(deps.inputs == path_vec("foo.cpp", "/stdc-predef.h"));
+
+    deps = dds::parse_mkfile_deps_str("main.o: main.cpp\n"
+                                      "main.o: foo.c++m\n"
+                                      "CXX_IMPORTS += foo.c++m\n");
+    CHECK(deps.output == "main.o");
+    CHECK(deps.inputs == path_vec("main.cpp"));
+}
+
 TEST_CASE("Invalid deps") {
     // Invalid deps does not terminate. This will generate an error message in
     // the logs, but it is a non-fatal error that we can recover from.
@@ -54,4 +76,121 @@ Something else
               "C:\\foo\\bar\\filepath/quux.h",
               "C:\\foo\\bar\\filepath/cats/quux.h",
           }));
-}
\ No newline at end of file
+}
+namespace {
+
+/// A store that keeps its information in memory, and counts the times that it is loaded
+struct counting_store : dds::deps_store {
+    int&                                   n_loads;
+    std::vector<dds::recorded_compilation> comps;
+
+    explicit counting_store(int& n)
+        : n_loads(n) {}
+
+    void record(const std::vector<dds::file_deps_info>& infos) override {
+        for (auto& info : infos) {
+            auto& comp = comps.emplace_back(
+                dds::recorded_compilation{.output_path = info.output.generic_string()});
+            for (auto& input : info.inputs) {
+                comp.inputs.push_back({input, dds::recorded_input_mtime(input)});
+            }
+        }
+    }
+    std::shared_ptr<const std::vector<dds::recorded_compilation>> load_all() const override {
+        ++n_loads;
+        return std::make_shared<const std::vector<dds::recorded_compilation>>(comps);
+    }
+};
+
+}  // namespace
+
+TEST_CASE("A memoized deps store only loads again after information is recorded") {
+    int  n_loads = 0;
+    auto store   = dds::make_memoized_deps_store(std::make_unique<counting_store>(n_loads));
+    CHECK(store->load_all()->empty());
+    CHECK(store->load_all()->empty());
+    CHECK(n_loads == 1);
+
+    // Recording nothing changes nothing
+    store->record({});
+    CHECK(store->load_all()->empty());
+    CHECK(n_loads == 1);
+
+    store->record({dds::file_deps_info{.output = "foo.o"}});
+    REQUIRE(store->load_all()->size() == 1);
+    CHECK((*store->load_all())[0].output_path == "foo.o");
+    CHECK(n_loads == 2);
+}
+
+TEST_CASE("Find __has_include tests") {
+    auto probes = dds::parse_has_include_probes(R"(
+        #if __has_include(<foo.tweaks.hpp>)
+        #include <foo.tweaks.hpp>
+        #endif
+        #if __has_include_next( "bar/baz.h" ) && defined(THING)
+        #endif
+        #if __has_include(FROM_A_MACRO) || __has_include(<foo.tweaks.hpp>)
+        #endif
+        #ifdef __has_include
+        #endif
+    )");
+    CHECK(probes == std::vector<std::string>{"bar/baz.h", "foo.tweaks.hpp"});
+}
+
+TEST_CASE("Files are only searched for __has_include tests again when they are modified") {
+    auto tempdir = dds::temporary_dir::create();
+    dds::fs::create_directories(tempdir.path());
+    auto file  = tempdir.path() / "foo.hpp";
+    auto write = [&](std::string_view content) { std::ofstream{file} << content; };
+    auto t1    = dds::fs::file_time_type::clock::now();
+    auto t2    = t1 + std::chrono::seconds(1);
+
+    dds::include_probe_cache cache;
+    write("#if __has_include(<foo.tweaks.hpp>)\n#endif\n");
+    CHECK(cache.probes_of(file, t1) == std::vector<std::string>{"foo.tweaks.hpp"});
+
+    write("#if __has_include(<bar.tweaks.hpp>)\n#endif\n");
+    CHECK(cache.probes_of(file, t1) == std::vector<std::string>{"foo.tweaks.hpp"});
+    CHECK(cache.probes_of(file, t2) == std::vector<std::string>{"bar.tweaks.hpp"});
+
+    write("");
+    cache.forget(file);
+    CHECK(cache.probes_of(file, t2).empty());
+}
+
+TEST_CASE("Find the outputs that are affected by changed files") {
+    auto tempdir = dds::temporary_dir::create();
+    dds::fs::create_directories(tempdir.path());
+    auto touch = [&](std::string_view name) {
+        auto p = tempdir.path() / name;
+        std::ofstream{p} << "content";
+        return dds::fs::weakly_canonical(p);
+    };
+    auto foo_cpp = touch("foo.cpp");
+    auto foo_hpp = touch("foo.hpp");
+    auto bar_cpp = touch("bar.cpp");
+    auto foo_o   = touch("foo.o");
+    auto bar_o   = touch("bar.o");
+    auto lib_a   = touch("lib.a");
+    auto app     = touch("app");
+
+    int            n_loads = 0;
+    counting_store store{n_loads};
+    store.record({
+        dds::file_deps_info{.output = foo_o, .inputs = {foo_cpp, foo_hpp}},
+        dds::file_deps_info{.output = bar_o, .inputs = {bar_cpp}},
+        dds::file_deps_info{.output = lib_a, .inputs = {foo_o}},
+        dds::file_deps_info{.output = app, .inputs = {bar_o, lib_a}},
+    });
+
+    using path_set = std::unordered_set<std::string>;
+    dds::compilation_history history{store};
+    CHECK(history.outputs_affected_by({foo_hpp})
+          == path_set{foo_o.generic_string(), lib_a.generic_string(), app.generic_string()});
+    CHECK(history.outputs_affected_by({bar_cpp})
+          == path_set{bar_o.generic_string(), app.generic_string()});
+    CHECK(history.outputs_affected_by({touch("baz.hpp")}).empty());
+
+    CHECK(history.contains(app));
+    CHECK_FALSE(history.contains(tempdir.path() / "baz.o"));
+}
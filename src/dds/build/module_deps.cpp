@@ -0,0 +1,65 @@
+#include "./module_deps.hpp"
+
+#include <dds/util/string.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <cctype>
+
+using namespace dds;
+
+module_deps_info dds::parse_p1689_str(std::string_view str) {
+    auto  data  = nlohmann::json::parse(str);
+    auto& rules = data.at("rules");
+    if (rules.empty()) {
+        return {};
+    }
+
+    auto&            rule = rules.at(0);
+    module_deps_info ret;
+    if (auto provides = rule.find("provides"); provides != rule.end() && !provides->empty()) {
+        ret.provides = provides->at(0).at("logical-name").get<std::string>();
+    }
+    if (auto required = rule.find("requires"); required != rule.end()) {
+        for (auto& req : *required) {
+            ret.imports.push_back(req.at("logical-name").get<std::string>());
+        }
+    }
+    return ret;
+}
+
+module_deps_info dds::parse_p1689_file(path_ref where) {
+    return parse_p1689_str(slurp_file(where));
+}
+
+namespace {
+
+/// Check whether `line` begins with the given keyword, followed by something other than more of
+/// the same identifier.
+bool starts_with_keyword(std::string_view line, std::string_view kw) {
+    if (!starts_with(line, kw)) {
+        return false;
+    }
+    if (line.size() == kw.size()) {
+        return true;
+    }
+    auto next = line[kw.size()];
+    return !(std::isalnum(static_cast<unsigned char>(next)) || next == '_');
+}
+
+}  // namespace
+
+bool dds::may_use_modules(std::string_view source) noexcept {
+    for (auto line : split_view(source, "\n")) {
+        line = trim_view(line);
+        if (starts_with_keyword(line, "export")) {
+            line = trim_view(line.substr(6));
+        }
+        if (starts_with_keyword(line, "module") || starts_with_keyword(line, "import")) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool dds::file_may_use_modules(path_ref file) { return may_use_modules(slurp_file(file)); }
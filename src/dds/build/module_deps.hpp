@@ -0,0 +1,61 @@
+#pragma once
+
+/**
+ * The `module_deps` module reads the C++20 module dependencies of translation units. These cannot
+ * be collected while compiling, as is done for `#include`d files, since a translation unit that
+ * imports a module cannot be compiled until the module's interface has been built. Instead, a
+ * translation unit is first "scanned" by the compiler, which writes the modules it provides and
+ * requires in the JSON format of P1689.
+ *
+ * Scanning costs about as much as preprocessing, so only translation units that appear to declare
+ * or import a module are scanned.
+ */
+
+#include <dds/util/fs.hpp>
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace dds {
+
+/**
+ * The module dependencies of a single translation unit
+ */
+struct module_deps_info {
+    /// The name of the module, or module partition, that is provided by the translation unit
+    std::optional<std::string> provides;
+    /// The names of the modules and module partitions that are imported by the translation unit
+    std::vector<std::string> imports;
+};
+
+/**
+ * Parse P1689 module dependency information, as written by a compiler's dependency scan.
+ * @param str The JSON content that was written by the compiler
+ * @throws std::exception if the content is not valid P1689 information
+ * @note Only the first rule is read, since a scan is performed for a single translation unit.
+ */
+module_deps_info parse_p1689_str(std::string_view str);
+
+/**
+ * Parse a file containing P1689 module dependency information
+ * @see `parse_p1689_str`
+ */
+module_deps_info parse_p1689_file(path_ref where);
+
+/**
+ * Determine whether the given source code may declare or import a module. This is a quick textual
+ * check, rather than an actual scan: It looks for a line that begins with a `module`, `import`,
+ * `export module`, or `export import` declaration. A module declaration that is produced by a
+ * macro will not be detected.
+ */
+bool may_use_modules(std::string_view source) noexcept;
+
+/**
+ * Determine whether the given file may declare or import a module.
+ * @see `may_use_modules`
+ */
+bool file_may_use_modules(path_ref file);
+
+}  // namespace dds
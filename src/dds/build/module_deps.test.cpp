@@ -0,0 +1,42 @@
+#include <dds/build/module_deps.hpp>
+
+#include <catch2/catch.hpp>
+
+TEST_CASE("Parse P1689 module deps") {
+    auto deps = dds::parse_p1689_str(R"({
+        "rules": [{
+            "primary-output": "foo.cpp.o",
+            "provides": [{"logical-name": "foo:part", "is-interface": true}],
+            "requires": [{"logical-name": "bar"}, {"logical-name": "foo:other"}]
+        }],
+        "version": 0,
+        "revision": 0
+    })");
+    CHECK(deps.provides == "foo:part");
+    CHECK(deps.imports == std::vector<std::string>{"bar", "foo:other"});
+
+    // A plain translation unit provides nothing
+    deps = dds::parse_p1689_str(R"({"rules": [{"primary-output": "main.cpp.o",
+                                               "requires": [{"logical-name": "foo"}]}],
+                                    "version": 0, "revision": 0})");
+    CHECK_FALSE(deps.provides);
+    CHECK(deps.imports == std::vector<std::string>{"foo"});
+
+    deps = dds::parse_p1689_str(R"({"rules": [], "version": 0, "revision": 0})");
+    CHECK_FALSE(deps.provides);
+    CHECK(deps.imports.empty());
+
+    CHECK_THROWS(dds::parse_p1689_str("not json"));
+    CHECK_THROWS(dds::parse_p1689_str(R"({"version": 0})"));
+}
+
+TEST_CASE("Detect possible module units") {
+    CHECK(dds::may_use_modules("export module foo;\n"));
+    CHECK(dds::may_use_modules("module;\n#include <vector>\nmodule foo:impl;\n"));
+    CHECK(dds::may_use_modules("#include <string>\n  import foo;\n"));
+    CHECK(dds::may_use_modules("export import :part;"));
+    CHECK(dds::may_use_modules("import <vector>;"));
+    CHECK_FALSE(dds::may_use_modules("#include <vector>\nint main() {}\n"));
+    CHECK_FALSE(dds::may_use_modules("int importance = 2;\nimport_all();\nmodules = 1;\n"));
+    CHECK_FALSE(dds::may_use_modules("exported_module();"));
+}
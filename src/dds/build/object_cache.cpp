@@ -0,0 +1,513 @@
+#include "./object_cache.hpp"
+
+#include <dds/proc.hpp>
+#include <dds/util/flock.hpp>
+#include <dds/util/hash.hpp>
+#include <dds/util/log.hpp>
+#include <dds/util/paths.hpp>
+#include <dds/util/string.hpp>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cctype>
+#include <random>
+#include <sstream>
+#include <thread>
+
+using namespace dds;
+
+namespace {
+
+/// Bump this to invalidate every existing cache entry if the cache's keys change meaning
+constexpr std::string_view cache_key_version = "dds-object-cache 1";
+constexpr std::string_view manifest_header   = "dds-object-manifest 1";
+
+/// The digest that is recorded for an input that did not exist, such as a header that was tested
+/// with `__has_include`. The entry only matches while the file remains absent.
+constexpr std::string_view absent_digest = "absent";
+
+/// The most compilations with differing headers that are remembered for a single key
+constexpr std::size_t max_manifest_entries = 16;
+
+/// When trimming the cache, remove objects until the cache is this fraction of its maximum size
+constexpr double trim_target_fraction = 0.9;
+
+struct manifest_entry {
+    std::string                                      object_key;
+    std::vector<std::pair<std::string, std::string>> inputs;  // (digest, path)
+};
+
+/// Spread files among subdirectories by the first two digits of their key
+fs::path sharded_path(path_ref dir, std::string_view key) {
+    return dir / key.substr(0, 2) / key;
+}
+
+/**
+ * Write a file by writing a temporary file and renaming it into place, so that concurrent readers
+ * never see a partially written file.
+ */
+void write_file_atomic(path_ref dest, std::string_view content) {
+    thread_local std::mt19937_64 rng{std::random_device{}()};
+    fs::create_directories(dest.parent_path());
+    auto tmp = dest;
+    tmp += fmt::format(".tmp-{:x}", rng());
+    {
+        auto out = dds::open(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+        out.write(content.data(), static_cast<std::streamsize>(content.size()));
+        if (!out.flush()) {
+            throw std::system_error(std::make_error_code(std::errc::io_error),
+                                    "Failed to write file " + tmp.string());
+        }
+    }
+    fs::rename(tmp, dest);
+}
+
+std::string read_file(path_ref file) {
+    auto               in = dds::open(file, std::ios::in | std::ios::binary);
+    std::ostringstream strm;
+    strm << in.rdbuf();
+    return std::move(strm).str();
+}
+
+std::vector<manifest_entry> parse_manifest(std::string_view content) {
+    std::vector<manifest_entry> ret;
+    auto                        lines = split_view(content, "\n");
+    if (lines.empty() || lines.front() != manifest_header) {
+        return ret;
+    }
+    for (auto it = lines.begin() + 1; it != lines.end(); ++it) {
+        auto line = *it;
+        if (line.empty()) {
+            continue;
+        }
+        // Each entry is a line naming the object and the number of inputs, then a line per input
+        auto parts = split_view(line, " ");
+        if (parts.size() != 3 || parts[0] != "entry") {
+            return {};
+        }
+        auto& entry      = ret.emplace_back();
+        entry.object_key = std::string(parts[1]);
+        auto n_inputs    = std::stoul(std::string(parts[2]));
+        for (std::size_t n = 0; n < n_inputs; ++n) {
+            if (++it == lines.end()) {
+                return {};
+            }
+            auto space = it->find(' ');
+            if (space == it->npos) {
+                return {};
+            }
+            entry.inputs.emplace_back(std::string(it->substr(0, space)),
+                                      std::string(it->substr(space + 1)));
+        }
+    }
+    return ret;
+}
+
+std::string render_manifest(const std::vector<manifest_entry>& entries) {
+    std::string ret{manifest_header};
+    ret.push_back('\n');
+    for (auto& entry : entries) {
+        ret += fmt::format("entry {} {}\n", entry.object_key, entry.inputs.size());
+        for (auto& [digest, path] : entry.inputs) {
+            ret += fmt::format("{} {}\n", digest, path);
+        }
+    }
+    return ret;
+}
+
+/**
+ * Replace every occurrence of the directory path `dir` in `text` with `repl`, except where `dir` is
+ * only the beginning of a longer file name.
+ */
+std::string replace_dir(std::string_view text, std::string_view dir, std::string_view repl) {
+    auto continues_name = [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c))
+            || std::string_view("._-+@~").find(c) != std::string_view::npos;
+    };
+    std::string ret;
+    auto        pos = text.find(dir);
+    while (pos != text.npos) {
+        auto end = pos + dir.size();
+        if (end < text.size() && continues_name(text[end])) {
+            pos = text.find(dir, pos + 1);
+            continue;
+        }
+        ret.append(text.substr(0, pos));
+        ret.append(repl);
+        text = text.substr(end);
+        pos  = text.find(dir);
+    }
+    ret.append(text);
+    return ret;
+}
+
+struct stored_stats {
+    object_cache_stats counts;
+    std::uintmax_t     size = 0;
+};
+
+stored_stats read_stats(path_ref file) {
+    stored_stats ret;
+    if (!fs::exists(file)) {
+        return ret;
+    }
+    auto content = read_file(file);
+    for (auto line : split_view(content, "\n")) {
+        auto parts = split_view(line, " ");
+        if (parts.size() != 2) {
+            continue;
+        }
+        auto value = std::stoull(std::string(parts[1]));
+        if (parts[0] == "hits") {
+            ret.counts.hits = value;
+        } else if (parts[0] == "misses") {
+            ret.counts.misses = value;
+        } else if (parts[0] == "stores") {
+            ret.counts.stores = value;
+        } else if (parts[0] == "size") {
+            ret.size = value;
+        }
+    }
+    return ret;
+}
+
+void write_stats(path_ref file, const stored_stats& st) {
+    write_file_atomic(file,
+                      fmt::format("hits {}\nmisses {}\nstores {}\nsize {}\n",
+                                  st.counts.hits,
+                                  st.counts.misses,
+                                  st.counts.stores,
+                                  st.size));
+}
+
+double hit_rate(const object_cache_stats& st) {
+    auto n_lookups = st.hits + st.misses;
+    return n_lookups ? 100.0 * static_cast<double>(st.hits) / static_cast<double>(n_lookups) : 0;
+}
+
+/**
+ * Remove the least-recently used objects in the cache until it is no larger than `target_size`.
+ * Returns the new size of the cache.
+ */
+std::uintmax_t evict_objects(path_ref root, std::uintmax_t target_size) {
+    struct cached_object {
+        fs::file_time_type last_use;
+        std::uintmax_t     size = 0;
+        fs::path           path;
+    };
+
+    // Restoring an object updates its modification time, so it doubles as the time of last use
+    std::vector<cached_object> objects;
+    std::uintmax_t             total_size  = 0;
+    auto                       objects_dir = root / "objects";
+    if (fs::exists(objects_dir)) {
+        for (auto& ent : fs::recursive_directory_iterator{objects_dir}) {
+            if (!ent.is_regular_file() || ent.path().extension() != ".object") {
+                continue;
+            }
+            auto output_path = fs::path(ent.path()).replace_extension(".output");
+            std::error_code ec;
+            auto            output_size = fs::file_size(output_path, ec);
+            auto            size        = ent.file_size() + (ec ? 0 : output_size);
+            objects.push_back(cached_object{ent.last_write_time(), size, ent.path()});
+            total_size += size;
+        }
+    }
+
+    std::sort(objects.begin(), objects.end(), [](auto& left, auto& right) {
+        return left.last_use < right.last_use;
+    });
+
+    std::optional<fs::file_time_type> cutoff;
+    std::size_t                       n_evicted = 0;
+    for (auto& obj : objects) {
+        if (total_size <= target_size) {
+            break;
+        }
+        std::error_code ec;
+        fs::remove(obj.path, ec);
+        fs::remove(fs::path(obj.path).replace_extension(".output"), ec);
+        total_size -= obj.size;
+        cutoff = obj.last_use;
+        ++n_evicted;
+    }
+
+    // Manifests are touched whenever they are used, so manifests that have not been used since the
+    // newest evicted object can only refer to objects that are gone
+    auto manifests_dir = root / "manifests";
+    if (cutoff && fs::exists(manifests_dir)) {
+        for (auto& ent : fs::recursive_directory_iterator{manifests_dir}) {
+            if (ent.is_regular_file() && ent.last_write_time() <= *cutoff) {
+                std::error_code ec;
+                fs::remove(ent.path(), ec);
+            }
+        }
+    }
+
+    dds_log(debug, "Evicted {} objects from the object cache", n_evicted);
+    return total_size;
+}
+
+}  // namespace
+
+fs::path object_cache::default_path() noexcept { return dds_data_dir() / "obj-cache"; }
+
+object_cache::object_cache(path_ref                     root,
+                           std::uintmax_t               max_size,
+                           std::vector<path_prefix_map> prefix_maps)
+    : _root(root)
+    , _max_size(max_size)
+    , _prefix_maps(std::move(prefix_maps)) {
+    fs::create_directories(_root);
+    // Replace the longest prefixes first, so that nested directories map to their own names
+    std::sort(_prefix_maps.begin(), _prefix_maps.end(), [](auto& left, auto& right) {
+        return left.from.native().size() > right.from.native().size();
+    });
+}
+
+object_cache::~object_cache() {
+    try {
+        _finish();
+    } catch (const std::exception& e) {
+        dds_log(warn, "Failed to update the object cache [{}]: {}", _root.string(), e.what());
+    }
+}
+
+std::optional<std::string> object_cache::_hash_of(path_ref file) const {
+    std::error_code ec;
+    auto            mtime = fs::last_write_time(file, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    auto size = fs::file_size(file, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+
+    auto key = file.generic_string();
+    {
+        std::scoped_lock lk{_mut};
+        auto             found = _hashes.find(key);
+        if (found != _hashes.end() && found->second.mtime == mtime && found->second.size == size) {
+            return found->second.digest;
+        }
+    }
+
+    auto             digest = sha256_file(file);
+    std::scoped_lock lk{_mut};
+    _hashes.insert_or_assign(std::move(key), hashed_file{mtime, size, digest});
+    return digest;
+}
+
+std::string object_cache::_compiler_id(const std::string& program) const {
+    {
+        std::scoped_lock lk{_mut};
+        auto             found = _compiler_ids.find(program);
+        if (found != _compiler_ids.end()) {
+            return found->second;
+        }
+    }
+
+    // Identify the compiler by its location, size, and modification time, rather than by its
+    // content, since compilers can be large and this is enough to notice an upgrade.
+    std::string id = program;
+    if (auto exe = find_program(program)) {
+        auto canon = fs::weakly_canonical(*exe);
+        id         = fmt::format("{} {} {}",
+                         canon.string(),
+                         fs::file_size(canon),
+                         fs::last_write_time(canon).time_since_epoch().count());
+    }
+    dds_log(trace, "Identified compiler '{}' as '{}' for the object cache", program, id);
+
+    std::scoped_lock lk{_mut};
+    _compiler_ids.emplace(program, id);
+    return id;
+}
+
+std::string object_cache::_map_paths(std::string_view text) const {
+    std::string ret{text};
+    for (auto& map : _prefix_maps) {
+        ret = replace_dir(ret, map.from.string(), "[" + map.to + "]");
+    }
+    return ret;
+}
+
+std::string object_cache::_unmap_paths(std::string_view text) const {
+    std::string ret{text};
+    for (auto& map : _prefix_maps) {
+        ret = replace(ret, "[" + map.to + "]", map.from.string());
+    }
+    return ret;
+}
+
+std::optional<std::string> object_cache::compilation_key(const std::vector<std::string>& command,
+                                                         path_ref source) const {
+    if (command.empty()) {
+        return std::nullopt;
+    }
+    auto source_digest = _hash_of(source);
+    if (!source_digest) {
+        return std::nullopt;
+    }
+
+    sha256 hash;
+    hash.update(cache_key_version);
+    hash.update("\n");
+    hash.update(_compiler_id(command.front()));
+    hash.update("\n");
+    for (auto& arg : command) {
+        // Include the terminator so that ["ab", "c"] and ["a", "bc"] differ
+        auto mapped = _map_paths(arg);
+        hash.update(std::string_view(mapped.c_str(), mapped.size() + 1));
+    }
+    hash.update("\n");
+    hash.update(*source_digest);
+    return hash.hex_digest();
+}
+
+std::optional<object_cache::restored> object_cache::restore(std::string_view key,
+                                                            path_ref         object_dest) {
+    try {
+        auto manifest_path = sharded_path(_root / "manifests", key);
+        auto input_matches = [&](auto& input) {
+            auto digest = _hash_of(_unmap_paths(input.second));
+            return digest.value_or(std::string(absent_digest)) == input.first;
+        };
+        if (fs::exists(manifest_path)) {
+            for (auto& entry : parse_manifest(read_file(manifest_path))) {
+                if (!std::all_of(entry.inputs.begin(), entry.inputs.end(), input_matches)) {
+                    continue;
+                }
+                auto object_path = sharded_path(_root / "objects", entry.object_key);
+                auto output_path = object_path;
+                object_path.replace_extension(".object");
+                output_path.replace_extension(".output");
+                if (!fs::exists(object_path)) {
+                    // Evicted
+                    continue;
+                }
+
+                fs::create_directories(object_dest.parent_path());
+                fs::copy_file(object_path, object_dest, fs::copy_options::overwrite_existing);
+                // Mark the entry as recently used, so that it will be evicted last
+                auto now = fs::file_time_type::clock::now();
+                fs::last_write_time(object_path, now);
+                fs::last_write_time(manifest_path, now);
+
+                restored ret;
+                ret.compiler_output = fs::exists(output_path)
+                    ? _unmap_paths(read_file(output_path))
+                    : "";
+                for (auto& input : entry.inputs) {
+                    ret.inputs.emplace_back(_unmap_paths(input.second));
+                }
+                ++_hits;
+                return ret;
+            }
+        }
+    } catch (const std::exception& e) {
+        dds_log(warn,
+                "Failed to restore an object from the cache [{}]: {}",
+                _root.string(),
+                e.what());
+    }
+    ++_misses;
+    return std::nullopt;
+}
+
+void object_cache::store(std::string_view             key,
+                         path_ref                     object,
+                         const std::vector<fs::path>& inputs,
+                         std::string_view             compiler_output) {
+    if (inputs.empty()) {
+        // Without knowing the inputs, we could never tell whether the object is still valid
+        return;
+    }
+    try {
+        manifest_entry new_entry;
+        sha256         object_key;
+        object_key.update(key);
+        for (auto& input : inputs) {
+            auto digest = _hash_of(input);
+            if (!digest) {
+                if (fs::exists(input)) {
+                    // The input cannot be read. We can't trust it.
+                    return;
+                }
+                digest = std::string(absent_digest);
+            }
+            auto path = _map_paths(fs::weakly_canonical(input).string());
+            object_key.update(fmt::format("\n{} {}", *digest, path));
+            new_entry.inputs.emplace_back(std::move(*digest), std::move(path));
+        }
+        new_entry.object_key = object_key.hex_digest();
+
+        auto object_path = sharded_path(_root / "objects", new_entry.object_key);
+        auto output_path = object_path;
+        object_path.replace_extension(".object");
+        output_path.replace_extension(".output");
+        write_file_atomic(output_path, _map_paths(compiler_output));
+        write_file_atomic(object_path, read_file(object));
+
+        auto manifest_path = sharded_path(_root / "manifests", key);
+        auto entries       = fs::exists(manifest_path)
+                  ? parse_manifest(read_file(manifest_path))
+                  : std::vector<manifest_entry>{};
+        std::erase_if(entries, [&](auto& ent) { return ent.object_key == new_entry.object_key; });
+        entries.insert(entries.begin(), std::move(new_entry));
+        if (entries.size() > max_manifest_entries) {
+            entries.resize(max_manifest_entries);
+        }
+        write_file_atomic(manifest_path, render_manifest(entries));
+
+        ++_stores;
+        _stored_size += fs::file_size(object_path) + compiler_output.size();
+    } catch (const std::exception& e) {
+        dds_log(warn, "Failed to store an object in the cache [{}]: {}", _root.string(), e.what());
+    }
+}
+
+object_cache_stats object_cache::stats() const noexcept {
+    return object_cache_stats{
+        .hits   = _hits.load(),
+        .misses = _misses.load(),
+        .stores = _stores.load(),
+    };
+}
+
+void object_cache::_finish() {
+    auto session = stats();
+    if (session.hits + session.misses + session.stores == 0) {
+        return;
+    }
+
+    // Several processes may share the cache. Only one may update the statistics at a time.
+    shared_file_mutex mut{_root / ".lock"};
+    std::unique_lock  lk{mut};
+
+    auto stats_path = _root / "stats";
+    auto total      = read_stats(stats_path);
+    total.counts.hits += session.hits;
+    total.counts.misses += session.misses;
+    total.counts.stores += session.stores;
+    total.size += _stored_size.load();
+    if (total.size > _max_size) {
+        // The recorded size is only an estimate, since other processes may have evicted objects
+        // that we overwrote. Eviction will recompute the real size.
+        total.size = evict_objects(_root,
+                                   static_cast<std::uintmax_t>(static_cast<double>(_max_size)
+                                                               * trim_target_fraction));
+    }
+    write_stats(stats_path, total);
+
+    dds_log(info,
+            "Object cache: {} hits, {} misses ({:.1f}% hit rate). Overall: {:.1f}% hit rate, "
+            "{:L} MiB cached",
+            session.hits,
+            session.misses,
+            hit_rate(session),
+            hit_rate(total.counts),
+            total.size >> 20);
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <dds/toolchain/toolchain.hpp>
+#include <dds/util/fs.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace dds {
+
+/**
+ * Counts of the outcomes of object cache lookups
+ */
+struct object_cache_stats {
+    std::uint64_t hits   = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t stores = 0;
+};
+
+/**
+ * A content-addressed cache of compiled object files, shared between all builds of the user.
+ *
+ * A compilation is identified by a key that combines the compiler executable, the compile command,
+ * and the content of the source file. For each such key, the cache keeps a small manifest listing
+ * the headers that were used by prior compilations and the hash of their content. If every header
+ * of a manifest entry still has the same content, the object that was produced by that compilation
+ * is restored, along with the compiler's output, instead of running the compiler.
+ *
+ * Because lookups are based on file content rather than modification times, switching between
+ * branches and back will reuse the objects from the earlier build.
+ *
+ * If the cache is given path prefix maps, those directories are replaced by their fixed names in
+ * the compilation keys and in the manifests, so that builds of the same sources in different
+ * directories will share the cached objects. The compile commands should remap the same prefixes
+ * in the outputs of the compiler, or else the restored objects will refer to the directory of the
+ * build that stored them.
+ *
+ * The cache is limited in size. When the cache is destroyed, it will record its hit statistics and
+ * evict the objects that were least-recently used until the cache is within its size limit.
+ *
+ * All member functions may be called concurrently from any number of threads.
+ */
+class object_cache {
+    struct hashed_file {
+        fs::file_time_type mtime;
+        std::uintmax_t     size;
+        std::string        digest;
+    };
+
+    fs::path                     _root;
+    std::uintmax_t               _max_size;
+    std::vector<path_prefix_map> _prefix_maps;
+
+    // Content hashes and compiler identities are memoized, since they are used by many lookups
+    mutable std::mutex                                   _mut;
+    mutable std::unordered_map<std::string, hashed_file> _hashes;
+    mutable std::unordered_map<std::string, std::string> _compiler_ids;
+
+    std::atomic<std::uint64_t>  _hits{0};
+    std::atomic<std::uint64_t>  _misses{0};
+    std::atomic<std::uint64_t>  _stores{0};
+    std::atomic<std::uintmax_t> _stored_size{0};
+
+    std::optional<std::string> _hash_of(path_ref file) const;
+    std::string                _compiler_id(const std::string& program) const;
+    std::string                _map_paths(std::string_view text) const;
+    std::string                _unmap_paths(std::string_view text) const;
+    void                       _finish();
+
+public:
+    /// The default limit on the size of the cache
+    static constexpr std::uintmax_t default_max_size = std::uintmax_t(5) << 30;
+
+    /**
+     * The default location of the object cache, within the user's dds data directory
+     */
+    static fs::path default_path() noexcept;
+
+    /**
+     * Open the object cache in the given directory. It will be created if it does not exist.
+     * @param root The directory of the cache
+     * @param max_size The size that the cache should be trimmed to, in bytes
+     * @param prefix_maps Directories that should be identified by a fixed name rather than by
+     * their location. Their paths should be canonical.
+     */
+    object_cache(path_ref                     root,
+                 std::uintmax_t               max_size,
+                 std::vector<path_prefix_map> prefix_maps = {});
+    ~object_cache();
+
+    object_cache(const object_cache&) = delete;
+    object_cache& operator=(const object_cache&) = delete;
+
+    /**
+     * The result of restoring an object from the cache
+     */
+    struct restored {
+        /// The output of the compiler when the object was originally compiled
+        std::string compiler_output;
+        /// The files that were read by the original compilation
+        std::vector<fs::path> inputs;
+    };
+
+    /**
+     * Compute the key that identifies a compilation, or `nullopt` if the compilation cannot be
+     * cached, such as when the source file cannot be read.
+     * @param command The compile command
+     * @param source The source file that is compiled by the command
+     */
+    std::optional<std::string> compilation_key(const std::vector<std::string>& command,
+                                               path_ref                        source) const;
+
+    /**
+     * Restore a cached object for the given compilation key into `object_dest`. If there is no
+     * cached object whose inputs match the current content of those files, returns `nullopt`.
+     */
+    std::optional<restored> restore(std::string_view key, path_ref object_dest);
+
+    /**
+     * Store the result of a successful compilation in the cache.
+     * @param key The compilation key, as returned by `compilation_key()`
+     * @param object The object file that was produced by the compilation
+     * @param inputs Every file that was read by the compilation, including the source file, along
+     * with any file that the compilation looked for but did not find
+     * @param compiler_output The output from the compiler
+     */
+    void store(std::string_view             key,
+               path_ref                     object,
+               const std::vector<fs::path>& inputs,
+               std::string_view             compiler_output);
+
+    /**
+     * The outcomes of the lookups and stores that have been made with this object
+     */
+    object_cache_stats stats() const noexcept;
+};
+
+}  // namespace dds
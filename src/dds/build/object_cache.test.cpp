@@ -0,0 +1,152 @@
+#include <dds/build/object_cache.hpp>
+
+#include <dds/temp.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+struct tmp_cache {
+    dds::temporary_dir tempdir = dds::temporary_dir::create();
+    dds::fs::path      root    = tempdir.path() / "cache";
+    dds::fs::path      src     = tempdir.path() / "foo.cpp";
+    dds::fs::path      hdr     = tempdir.path() / "foo.hpp";
+    dds::fs::path      obj     = tempdir.path() / "out/foo.o";
+
+    std::vector<std::string> command = {"c++", "-c", "foo.cpp", "-o", "foo.o"};
+
+    tmp_cache() {
+        dds::fs::create_directories(obj.parent_path());
+        write(src, "#include \"foo.hpp\"\nint main() {}\n");
+        write(hdr, "// Header version 1\n");
+        write(obj, "object-v1");
+    }
+
+    static void write(const dds::fs::path& p, std::string_view content) {
+        std::ofstream{p, std::ios::binary} << content;
+    }
+
+    static std::string read(const dds::fs::path& p) {
+        std::ifstream      in{p, std::ios::binary};
+        std::ostringstream strm;
+        strm << in.rdbuf();
+        return strm.str();
+    }
+};
+
+}  // namespace
+
+TEST_CASE_METHOD(tmp_cache, "Restore a cached object") {
+    dds::object_cache cache{root, dds::object_cache::default_max_size};
+    auto              key = cache.compilation_key(command, src);
+    REQUIRE(key);
+    CHECK_FALSE(cache.restore(*key, obj));
+
+    cache.store(*key, obj, {src, hdr}, "some warning");
+    dds::fs::remove(obj);
+
+    auto restored = cache.restore(*key, obj);
+    REQUIRE(restored);
+    CHECK(read(obj) == "object-v1");
+    CHECK(restored->compiler_output == "some warning");
+    CHECK(restored->inputs.size() == 2);
+
+    auto st = cache.stats();
+    CHECK(st.hits == 1);
+    CHECK(st.misses == 1);
+    CHECK(st.stores == 1);
+}
+
+TEST_CASE_METHOD(tmp_cache, "Objects are keyed on the content of every input") {
+    dds::object_cache cache{root, dds::object_cache::default_max_size};
+    auto              key = *cache.compilation_key(command, src);
+    cache.store(key, obj, {src, hdr}, "");
+
+    // Changing a header means the object no longer applies
+    write(hdr, "// Header version 2, which is longer\n");
+    CHECK_FALSE(cache.restore(key, obj));
+    write(obj, "object-v2");
+    cache.store(key, obj, {src, hdr}, "");
+
+    // Going back to the prior content (such as by switching branches) restores the prior object
+    write(hdr, "// Header version 1\n");
+    REQUIRE(cache.restore(key, obj));
+    CHECK(read(obj) == "object-v1");
+
+    // Changing the command or the source file changes the key
+    auto other_cmd = command;
+    other_cmd.push_back("-O2");
+    CHECK(cache.compilation_key(other_cmd, src) != key);
+    write(src, "int main() { return 0; }\n");
+    CHECK(cache.compilation_key(command, src) != key);
+}
+
+TEST_CASE_METHOD(tmp_cache, "The least-recently used objects are evicted") {
+    std::vector<std::string> keys;
+    {
+        // A cache too small to hold even two objects
+        dds::object_cache cache{root, 1500};
+        for (int i = 0; i < 4; ++i) {
+            auto cmd = command;
+            cmd.push_back("-DN=" + std::to_string(i));
+            keys.push_back(*cache.compilation_key(cmd, src));
+            write(obj, std::string(1000, char('a' + i)));
+            cache.store(keys.back(), obj, {src, hdr}, "");
+        }
+    }
+
+    dds::object_cache cache{root, 1500};
+    CHECK_FALSE(cache.restore(keys[0], obj));
+    REQUIRE(cache.restore(keys[3], obj));
+    CHECK(read(obj) == std::string(1000, 'd'));
+}
+
+TEST_CASE_METHOD(tmp_cache, "Share objects between directories with mapped path prefixes") {
+    // Two copies of the same project, in different directories
+    auto proj_a = dds::fs::weakly_canonical(tempdir.path()) / "a/proj";
+    auto proj_b = dds::fs::weakly_canonical(tempdir.path()) / "b/proj";
+    for (auto& dir : {proj_a, proj_b}) {
+        dds::fs::create_directories(dir / "src");
+        write(dir / "src/foo.cpp", "#include \"foo.hpp\"\nint main() {}\n");
+        write(dir / "src/foo.hpp", "// Header version 1\n");
+    }
+    auto cmd_for = [&](const dds::fs::path& dir) {
+        return std::vector<std::string>{"c++",
+                                        "-I" + (dir / "src").string(),
+                                        "-c",
+                                        (dir / "src/foo.cpp").string(),
+                                        "-o",
+                                        obj.string()};
+    };
+
+    dds::object_cache cache_a{root, dds::object_cache::default_max_size, {{proj_a, "proj"}}};
+    dds::object_cache cache_b{root, dds::object_cache::default_max_size, {{proj_b, "proj"}}};
+
+    auto key = *cache_a.compilation_key(cmd_for(proj_a), proj_a / "src/foo.cpp");
+    CHECK(cache_b.compilation_key(cmd_for(proj_b), proj_b / "src/foo.cpp") == key);
+    cache_a.store(key,
+                  obj,
+                  {proj_a / "src/foo.cpp", proj_a / "src/foo.hpp"},
+                  (proj_a / "src/foo.hpp").string() + ":1: warning");
+
+    auto restored = cache_b.restore(key, obj);
+    REQUIRE(restored);
+    CHECK(restored->inputs
+          == std::vector<dds::fs::path>{proj_b / "src/foo.cpp", proj_b / "src/foo.hpp"});
+    CHECK(restored->compiler_output == (proj_b / "src/foo.hpp").string() + ":1: warning");
+
+    // A directory whose name only begins with the mapped directory's name is not mapped
+    auto cmd_a = cmd_for(proj_a);
+    auto cmd_b = cmd_for(proj_b);
+    cmd_a[1]   = "-I" + proj_a.string() + "-extra";
+    cmd_b[1]   = "-I" + proj_b.string() + "-extra";
+    CHECK(cache_a.compilation_key(cmd_a, proj_a / "src/foo.cpp")
+          != cache_b.compilation_key(cmd_b, proj_b / "src/foo.cpp"));
+
+    // The objects still depend on the content of the files in the current directory
+    write(proj_b / "src/foo.hpp", "// Header version 2\n");
+    CHECK_FALSE(cache_b.restore(key, obj));
+}
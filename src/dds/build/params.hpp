@@ -4,7 +4,9 @@
 #include <dds/toolchain/toolchain.hpp>
 #include <dds/util/fs.hpp>
 
+#include <cstdint>
 #include <optional>
+#include <vector>
 
 namespace dds {
 
@@ -15,8 +17,18 @@ struct build_params {
     std::optional<fs::path> emit_cmake{};
     std::optional<fs::path> tweaks_dir{};
     dds::toolchain          toolchain;
-    bool                    generate_compdb = true;
-    int                     parallel_jobs   = 0;
+    bool                    generate_compdb    = true;
+    int                     parallel_jobs      = 0;
+    bool                    use_deps_log       = false;
+    bool                    use_object_cache   = false;
+    std::uintmax_t          object_cache_size  = 0;  // In bytes. Zero for the default limit.
+    bool                    map_path_prefixes  = false;
+    bool                    use_prebuilt_cache = false;
+    bool                    rerun_tests        = false;
+    int                     test_timeout       = 10;  // In seconds. Zero to wait forever.
+
+    // If set, only the tests that may be affected by changes to these files are run
+    std::optional<std::vector<fs::path>> changed_files{};
 };
 
 }  // namespace dds
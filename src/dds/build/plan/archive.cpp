@@ -3,6 +3,7 @@
 #include <dds/error/errors.hpp>
 #include <dds/proc.hpp>
 #include <dds/util/log.hpp>
+#include <dds/util/signal.hpp>
 #include <dds/util/time.hpp>
 
 #include <fansi/styled.hpp>
@@ -16,13 +17,49 @@ fs::path create_archive_plan::calc_archive_file_path(const toolchain& tc) const
     return _subdir / fmt::format("{}{}{}", "lib", _name, tc.archive_suffix());
 }
 
-void create_archive_plan::archive(const build_env& env) const {
+namespace {
+
+/**
+ * Determine whether the archive must be created, based on the dependency information that was
+ * recorded when it was last created.
+ */
+bool needs_archive(const archive_spec&             ar,
+                   const std::vector<std::string>& ar_cmd,
+                   const compilation_history&      history) {
+    auto prior = history.get(ar.out_path);
+    if (!prior) {
+        dds_log(trace, "Archive {}: No recorded archive info", ar.out_path.string());
+        return true;
+    } else if (!fs::exists(ar.out_path)) {
+        dds_log(trace, "Archive {}: Output does not exist", ar.out_path.string());
+        return true;
+    } else if (!prior->newer_inputs.empty()) {
+        dds_log(trace, "Re-archive {}: Inputs have changed", ar.out_path.string());
+        return true;
+    } else if (quote_command(ar_cmd) != prior->previous_command.quoted_command) {
+        dds_log(trace, "Re-archive {}: Archive command has changed", ar.out_path.string());
+        return true;
+    }
+    dds_log(debug, "Skip archive of {} (Result is up-to-date)", ar.out_path.string());
+    return false;
+}
+
+}  // namespace
+
+void create_archive_plan::archive(const build_env&                    env,
+                                  const compilation_history&          history,
+                                  std::function<void(file_deps_info)> on_created,
+                                  job_graph::async_done               done) const {
     // Convert the file compilation plans into the paths to their respective object files.
-    const auto objects =  //
-        _compile_files    //
+    auto objects =      //
+        _compile_files  //
         | ranges::views::transform([&](auto&& cf) { return cf.calc_object_file_path(env); })
         | ranges::to_vector  //
         ;
+    // Some toolchains emit an object file along with the precompiled header, which must be linked
+    if (_pch && env.toolchain.pch_creates_object()) {
+        objects.push_back(_pch->calc_object_file_path(env));
+    }
     // Build up the archive command
     archive_spec ar;
 
@@ -35,6 +72,13 @@ void create_archive_plan::archive(const build_env& env) const {
     // in the logs
     auto out_relpath = fs::relative(ar.out_path, env.output_root).string();
 
+    // Re-creating an archive updates its modification time, which would cause everything that
+    // links to it to be relinked.
+    if (!needs_archive(ar, ar_cmd, history)) {
+        done([] {});
+        return;
+    }
+
     // Different archiving tools behave differently between platforms depending on whether the
     // archive file exists. Make it uniform by simply removing the prior copy.
     if (fs::exists(ar.out_path)) {
@@ -47,23 +91,34 @@ void create_archive_plan::archive(const build_env& env) const {
 
     // Do it!
     dds_log(info, "[{}] Archive: {}", _qual_name, out_relpath);
-    auto&& [dur_ms, ar_res] = timed<std::chrono::milliseconds>(
-        [&] { return run_proc(proc_options{.command = ar_cmd, .cwd = ar_cwd}); });
-    dds_log(info, "[{}] Archive: {} - {:L}ms", _qual_name, out_relpath, dur_ms.count());
-
-    // Check, log, and throw
-    if (!ar_res.okay()) {
-        dds_log(error,
-                "Creating static library archive [{}] failed for '{}'",
-                out_relpath,
-                _qual_name);
-        dds_log(error,
-                "Subcommand FAILED: .bold.yellow[{}]\n{}"_styled,
-                quote_command(ar_cmd),
-                ar_res.output);
-        throw_external_error<
-            errc::archive_failure>("Creating static library archive [{}] failed for '{}'",
-                                   out_relpath,
-                                   _qual_name);
-    }
+    stopwatch timer;
+    run_proc_async(proc_options{.command = ar_cmd, .cwd = ar_cwd}, [=, this](proc_result ar_res) {
+        auto dur_ms = timer.elapsed_ms();
+        done([=, this] {
+            cancellation_point();
+            dds_log(info, "[{}] Archive: {} - {:L}ms", _qual_name, out_relpath, dur_ms.count());
+
+            // Check, log, and throw
+            if (!ar_res.okay()) {
+                dds_log(error,
+                        "Creating static library archive [{}] failed for '{}'",
+                        out_relpath,
+                        _qual_name);
+                dds_log(error,
+                        "Subcommand FAILED: .bold.yellow[{}]\n{}"_styled,
+                        quote_command(ar_cmd),
+                        ar_res.output);
+                throw_external_error<
+                    errc::archive_failure>("Creating static library archive [{}] failed for '{}'",
+                                           out_relpath,
+                                           _qual_name);
+            }
+
+            on_created(file_deps_info{
+                .output  = ar.out_path,
+                .inputs  = ar.input_files,
+                .command = {quote_command(ar_cmd), ar_res.output, dur_ms},
+            });
+        });
+    });
 }
@@ -2,7 +2,10 @@
 
 #include <dds/build/plan/compile_file.hpp>
 #include <dds/util/fs.hpp>
+#include <dds/util/job_graph.hpp>
 
+#include <functional>
+#include <optional>
 #include <string>
 #include <string_view>
 
@@ -24,6 +27,8 @@ class create_archive_plan {
     fs::path _subdir;
     /// The plans for compiling the constituent source files of this library
     std::vector<compile_file_plan> _compile_files;
+    /// The precompiled header that is used by the constituent source files, if any
+    std::optional<compile_file_plan> _pch;
 
 public:
     /**
@@ -33,15 +38,19 @@ public:
      *      will be placed
      * @param cfs The file compilation plans that will be collected together to
      *      form the static library.
+     * @param pch The precompilation of the header that is used by the file
+     *      compilations, if any. It must complete before any of them start.
      */
-    create_archive_plan(std::string_view               name,
-                        std::string_view               qual_name,
-                        path_ref                       subdir,
-                        std::vector<compile_file_plan> cfs)
+    create_archive_plan(std::string_view                 name,
+                        std::string_view                 qual_name,
+                        path_ref                         subdir,
+                        std::vector<compile_file_plan>   cfs,
+                        std::optional<compile_file_plan> pch = std::nullopt)
         : _name(name)
         , _qual_name(qual_name)
         , _subdir(subdir)
-        , _compile_files(std::move(cfs)) {}
+        , _compile_files(std::move(cfs))
+        , _pch(std::move(pch)) {}
 
     /**
      * Get the name of the archive library.
@@ -61,11 +70,26 @@ public:
     auto& file_compilations() const noexcept { return _compile_files; }
 
     /**
-     * Perform the actual archive generation. Expects all compilations to have
+     * Get the precompilation of the header used by this library, if any.
+     */
+    auto& pch_compilation() const noexcept { return _pch; }
+
+    /**
+     * Start the actual archive generation. Expects all compilations to have
      * completed.
      * @param env The build environment for the archival.
+     * @param history The dependency information from prior builds. If the
+     *      archive is up-to-date, the archiver will not be executed, and
+     *      `done` is invoked immediately.
+     * @param on_created Invoked from the finishing function with the
+     *      dependency information of the newly created archive.
+     * @param done Invoked once the archiver has exited, with a function that
+     *      checks the result and throws if archiving failed.
      */
-    void archive(build_env_ref env) const;
+    void archive(build_env_ref                       env,
+                 const compilation_history&          history,
+                 std::function<void(file_deps_info)> on_created,
+                 job_graph::async_done               done) const;
 };
 
 }  // namespace dds
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <dds/build/file_deps.hpp>
 #include <dds/db/database.hpp>
 #include <dds/toolchain/toolchain.hpp>
 #include <dds/usage_reqs.hpp>
@@ -7,14 +8,26 @@
 
 namespace dds {
 
+class object_cache;
+
 struct build_env {
     dds::toolchain toolchain;
     fs::path       output_root;
     database&      db;
+    deps_store&    deps;
 
     toolchain_knobs knobs;
 
     const usage_requirement_map& ureqs;
+
+    // If non-null, compiled objects are shared through this cache
+    object_cache* objects = nullptr;
+    // If non-null, the modification times of inputs are checked through this cache, which is kept
+    // between builds
+    stat_cache* stats = nullptr;
+    // If non-null, the `__has_include` tests of inputs are remembered in this cache, which is kept
+    // between builds
+    include_probe_cache* probes = nullptr;
 };
 
 using build_env_ref = const build_env&;
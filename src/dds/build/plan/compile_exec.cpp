@@ -1,8 +1,12 @@
 #include "./compile_exec.hpp"
 
 #include <dds/build/file_deps.hpp>
+#include <dds/build/object_cache.hpp>
+#include <dds/build/plan/module_scan.hpp>
 #include <dds/error/errors.hpp>
 #include <dds/proc.hpp>
+#include <dds/util/algo.hpp>
+#include <dds/util/job_graph.hpp>
 #include <dds/util/log.hpp>
 #include <dds/util/parallel.hpp>
 #include <dds/util/signal.hpp>
@@ -11,13 +15,17 @@
 
 #include <fansi/styled.hpp>
 #include <neo/assert.hpp>
+#include <range/v3/algorithm/any_of.hpp>
 #include <range/v3/algorithm/count_if.hpp>
 #include <range/v3/range/conversion.hpp>
+#include <range/v3/view/iota.hpp>
 #include <range/v3/view/transform.hpp>
 
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <cstdint>
+#include <mutex>
 #include <thread>
 
 using namespace dds;
@@ -37,69 +45,145 @@ struct compile_ticket {
     std::reference_wrapper<const compile_file_plan> plan;
     // If non-null, the information required to compile the file
     compile_command_info command;
-    fs::path             object_file_path;
-    bool                 needs_recompile;
+    // The file that is given to the compiler, which may be generated in place of the source file
+    fs::path compiled_path;
+    fs::path object_file_path;
+    bool     needs_recompile;
     // Information about the previous time a file was compiled, if any
     std::optional<completed_compilation> prior_command;
+    // The C++ module dependencies of the file
+    module_graph::unit modules;
 };
 
 /**
- * Actually performs a compilation and collects deps information from that compilation
+ * The name of the file of a compilation, as shown to the user. A unity batch is named by its first
+ * member and the number of other members.
+ */
+std::string display_name(const compile_file_plan& plan) {
+    auto name = fs::relative(plan.source_path(), plan.source().basis_path).string();
+    if (plan.is_unity()) {
+        return fmt::format("{} (+{} files)", name, plan.unity_members().size() - 1);
+    }
+    return name;
+}
+
+/**
+ * Display the compiler output of a compilation that was not actually executed, because it is
+ * up-to-date or because its result was taken from a cache.
  *
- * @param cf The compilation to execute
- * @param env The build environment
- * @param counter A thread-safe counter for display progress to the user
+ * @param compile The compilation that was skipped
+ * @param quoted_command The command that produced the output
+ * @param output The output of the compiler
  */
-std::optional<file_deps_info>
-handle_compilation(const compile_ticket& compile, build_env_ref env, compile_counter& counter) {
-    if (!compile.needs_recompile) {
-        // We don't actually compile this file. Just issue any prior warning messages that were from
-        // a prior compilation.
-        neo_assert(invariant,
-                   compile.prior_command.has_value(),
-                   "Expected a prior compilation command for file",
-                   compile.plan.get().source_path(),
-                   quote_command(compile.command.command));
-        auto& prior = *compile.prior_command;
-        if (dds::trim_view(prior.output).empty()) {
-            // Nothing to show
-            return {};
-        }
-        if (!compile.plan.get().rules().enable_warnings()) {
-            // This file shouldn't show warnings. The compiler *may* have produced prior output, but
-            // this block will be hit when the source file belongs to an external dependency. Rather
-            // than continually spam the user with warnings that belong to dependencies, don't
-            // repeatedly show them.
-            dds_log(trace,
-                    "Cached compiler output suppressed for file with disabled warnings ({})",
-                    compile.plan.get().source_path().string());
-            return {};
-        }
-        dds_log(
-            warn,
-            "While compiling file .bold.cyan[{}] [.bold.yellow[{}]] (.br.blue[cached compiler output]):\n{}"_styled,
-            compile.plan.get().source_path().string(),
-            prior.quoted_command,
-            prior.output);
-        return {};
+void show_cached_output(const compile_ticket& compile,
+                        std::string_view      quoted_command,
+                        std::string_view      output) {
+    if (dds::trim_view(output).empty()) {
+        // Nothing to show
+        return;
+    }
+    if (!compile.plan.get().rules().enable_warnings()) {
+        // This file shouldn't show warnings. The compiler *may* have produced prior output, but
+        // this block will be hit when the source file belongs to an external dependency. Rather
+        // than continually spam the user with warnings that belong to dependencies, don't
+        // repeatedly show them.
+        dds_log(trace,
+                "Cached compiler output suppressed for file with disabled warnings ({})",
+                compile.plan.get().source_path().string());
+        return;
     }
+    dds_log(
+        warn,
+        "While compiling file .bold.cyan[{}] [.bold.yellow[{}]] (.br.blue[cached compiler output]):\n{}"_styled,
+        compile.plan.get().source_path().string(),
+        quoted_command,
+        output);
+}
 
+/**
+ * Replay the output of a compilation that is up-to-date, and does not need to be executed.
+ *
+ * @param compile The compilation that was skipped
+ */
+void replay_compilation(const compile_ticket& compile) {
+    // We don't actually compile this file. Just issue any prior warning messages that were from
+    // a prior compilation.
+    neo_assert(invariant,
+               compile.prior_command.has_value(),
+               "Expected a prior compilation command for file",
+               compile.plan.get().source_path(),
+               quote_command(compile.command.command));
+    auto& prior = *compile.prior_command;
+    show_cached_output(compile, prior.quoted_command, prior.output);
+}
+
+/**
+ * Prepare to execute a compilation, and generate the message that is displayed to the user for the
+ * compilation.
+ *
+ * @param compile The compilation that will be executed
+ */
+std::string begin_compilation(const compile_ticket& compile) {
     // Create the parent directory
     fs::create_directories(compile.object_file_path.parent_path());
 
     // Generate a log message to display to the user
-    auto source_path = compile.plan.get().source_path();
+    auto msg = fmt::format("[{}] Compile: .br.cyan[{}]"_styled,
+                           compile.plan.get().qualifier(),
+                           display_name(compile.plan.get()));
+    dds_log(info, msg);
+    return msg;
+}
 
-    auto msg
-        = fmt::format("[{}] Compile: .br.cyan[{}]"_styled,
-                      compile.plan.get().qualifier(),
-                      fs::relative(source_path, compile.plan.get().source().basis_path).string());
+/**
+ * Find the headers that are tested with `__has_include` by any of the given files, and which would
+ * be found in the tweaks directory if they existed there, but do not. Creating one of these headers
+ * changes the result of the compilation that read the files.
+ */
+std::vector<fs::path> absent_tweak_headers(const std::vector<fs::path>& files,
+                                           path_ref                     tweaks_dir,
+                                           build_env_ref                env) {
+    // Without caches that are kept by the build session, use ones for only these files
+    stat_cache          own_stats;
+    include_probe_cache own_probes;
+    auto&               stats  = env.stats ? *env.stats : own_stats;
+    auto&               probes = env.probes ? *env.probes : own_probes;
 
-    // Do it!
-    dds_log(info, msg);
-    auto&& [dur_ms, proc_res]
-        = timed<std::chrono::milliseconds>([&] { return run_proc(compile.command.command); });
-    auto nth = counter.n.fetch_add(1);
+    std::vector<fs::path> ret;
+    for (auto& file : files) {
+        auto mtime = stats.last_write_time(file);
+        if (!mtime) {
+            continue;
+        }
+        for (auto& name : probes.probes_of(file, *mtime)) {
+            ret.push_back(tweaks_dir / name);
+        }
+    }
+    sort_unique_erase(ret);
+    std::erase_if(ret, [&](auto& p) { return stats.last_write_time(p).has_value(); });
+    return ret;
+}
+
+/**
+ * Check the result of a compilation that has executed and collect deps information from that
+ * compilation. Throws if the compilation failed.
+ *
+ * @param compile The compilation that was executed
+ * @param env The build environment
+ * @param counter A thread-safe counter for display progress to the user
+ * @param msg The message that was generated by `begin_compilation()`
+ * @param proc_res The result of the compiler subprocess
+ * @param dur_ms The time that the compiler took to execute
+ */
+std::optional<file_deps_info> finish_compilation(const compile_ticket&     compile,
+                                                 build_env_ref             env,
+                                                 compile_counter&          counter,
+                                                 std::string_view          msg,
+                                                 proc_result               proc_res,
+                                                 std::chrono::milliseconds dur_ms) {
+    cancellation_point();
+    auto source_path = compile.compiled_path;
+    auto nth         = counter.n.fetch_add(1);
     dds_log(info,
             "{:60} - {:>7L}ms [{:{}}/{}]",
             msg,
@@ -155,7 +239,7 @@ handle_compilation(const compile_ticket& compile, build_env_ref env, compile_cou
         // cause a miscompile
         if (!msvc_deps.deps_info.inputs.empty()) {
             // Add the main source file as an input, since it is not listed by /showIncludes
-            msvc_deps.deps_info.inputs.push_back(compile.plan.get().source_path());
+            msvc_deps.deps_info.inputs.push_back(compile.compiled_path);
             msvc_deps.deps_info.output                 = compile.object_file_path;
             msvc_deps.deps_info.command.quoted_command = quote_command(compile.command.command);
             msvc_deps.deps_info.command.output         = compiler_output;
@@ -168,6 +252,24 @@ handle_compilation(const compile_ticket& compile, build_env_ref env, compile_cou
          */
     }
 
+    // Compilers do not list the precompiled header that was used, but the file must be compiled
+    // again whenever it is rebuilt. If it did not exist, the compiler used the plain header.
+    if (ret_deps_info && compile.command.pch_input && fs::exists(*compile.command.pch_input)) {
+        ret_deps_info->inputs.push_back(*compile.command.pch_input);
+    }
+    // Likewise for the interfaces of imported modules
+    if (ret_deps_info) {
+        extend(ret_deps_info->inputs, compile.modules.imported_bmis);
+    }
+    // Tweak headers are tested for with `__has_include`. The compiler does not list the headers
+    // that were not found, but the file must be compiled again if one of them is created.
+    if (ret_deps_info && env.knobs.tweaks_dir) {
+        extend(ret_deps_info->inputs,
+               absent_tweak_headers(ret_deps_info->inputs,
+                                    fs::weakly_canonical(*env.knobs.tweaks_dir),
+                                    env));
+    }
+
     // MSVC prints the filename of the source file. Remove it from the output.
     if (compiler_output.find(source_path.filename().string()) == 0) {
         compiler_output.erase(0, source_path.filename().string().length());
@@ -207,18 +309,62 @@ handle_compilation(const compile_ticket& compile, build_env_ref env, compile_cou
     return ret_deps_info;
 }
 
+/**
+ * Complete a compilation whose object file was restored from the object cache, rather than
+ * executing the compiler, and build the deps information for the restored object.
+ *
+ * @param compile The compilation that was restored
+ * @param counter A thread-safe counter for display progress to the user
+ * @param restored The result of restoring the object
+ */
+file_deps_info finish_restored_compilation(const compile_ticket&         compile,
+                                           compile_counter&              counter,
+                                           const object_cache::restored& restored) {
+    cancellation_point();
+    auto msg = fmt::format("[{}] Restore: .br.cyan[{}]"_styled,
+                           compile.plan.get().qualifier(),
+                           display_name(compile.plan.get()));
+    auto nth = counter.n.fetch_add(1);
+    dds_log(info, "{:60} - {:>9} [{:{}}/{}]", msg, "cached", nth, counter.max_digits, counter.max);
+
+    auto quoted = quote_command(compile.command.command);
+    show_cached_output(compile, quoted, restored.compiler_output);
+
+    // Restoring takes practically no time. A zero duration is too short to affect the recorded
+    // average duration of the file's compilations.
+    return file_deps_info{
+        .output  = compile.object_file_path,
+        .inputs  = restored.inputs,
+        .command = {quoted, restored.compiler_output, std::chrono::milliseconds(0)},
+    };
+}
+
 /**
  * Determine if the given compile command should actually be executed based on
  * the dependency information we have recorded in the database.
  */
-compile_ticket mk_compile_ticket(const compile_file_plan& plan, build_env_ref env) {
+compile_ticket mk_compile_ticket(const compile_file_plan&   plan,
+                                 build_env_ref              env,
+                                 const compilation_history& history,
+                                 const module_graph&        modules,
+                                 std::size_t                n) {
+    auto&                   unit = modules.units[n];
+    std::optional<fs::path> mapper;
+    if (unit.uses_modules) {
+        mapper = modules.mapper_path;
+    }
     compile_ticket ret{.plan             = plan,
-                       .command          = plan.generate_compile_command(env),
+                       .command          = plan.generate_compile_command(env, mapper),
+                       .compiled_path    = plan.calc_compiled_path(env),
                        .object_file_path = plan.calc_object_file_path(env),
                        .needs_recompile  = false,
-                       .prior_command    = {}};
+                       .prior_command    = {},
+                       .modules          = unit};
 
-    auto rb_info = get_prior_compilation(env.db, ret.object_file_path);
+    // A generated source file must exist before it can be checked for changes or compiled
+    plan.write_generated_source(env);
+
+    auto rb_info = history.get(ret.object_file_path);
     if (!rb_info) {
         dds_log(trace, "Compile {}: No recorded compilation info", plan.source_path().string());
         ret.needs_recompile = true;
@@ -226,6 +372,9 @@ compile_ticket mk_compile_ticket(const compile_file_plan& plan, build_env_ref en
         dds_log(trace, "Compile {}: Output does not exist", plan.source_path().string());
         // The output file simply doesn't exist. We have to recompile, of course.
         ret.needs_recompile = true;
+    } else if (unit.bmi && !fs::exists(*unit.bmi)) {
+        dds_log(trace, "Compile {}: Module interface does not exist", plan.source_path().string());
+        ret.needs_recompile = true;
     } else if (!rb_info->newer_inputs.empty()) {
         // Inputs to this file have changed from a prior execution.
         dds_log(trace,
@@ -248,45 +397,246 @@ compile_ticket mk_compile_ticket(const compile_file_plan& plan, build_env_ref en
     return ret;
 }
 
+/**
+ * Estimate the duration of each of the given compilations. Files with a prior compilation use the
+ * average duration that was recorded in the database. Other files are estimated from the size of
+ * their source file, using the time-per-byte observed in the files that do have history, since the
+ * same project tends to have a similar density of expensive code.
+ */
+std::vector<std::chrono::milliseconds>
+estimate_compile_durations(const std::vector<compile_ticket>& tickets) {
+    using std::chrono::milliseconds;
+    // Used if no file in the batch has been compiled before.
+    constexpr double default_ms_per_byte = 0.1;
+    // Guess at the fixed overhead of starting any compiler process.
+    constexpr auto min_estimate = milliseconds(100);
+
+    std::vector<std::uintmax_t> sizes;
+    std::uintmax_t              total_known_size = 0;
+    milliseconds                total_known_duration{};
+    for (auto& ticket : tickets) {
+        // A unity batch is as large as all of its members together
+        std::uintmax_t size     = 0;
+        auto           add_size = [&](path_ref file) {
+            std::error_code ec;
+            auto            file_size = fs::file_size(file, ec);
+            size += ec ? 0 : file_size;
+        };
+        if (ticket.plan.get().is_unity()) {
+            for (auto& member : ticket.plan.get().unity_members()) {
+                add_size(member.path);
+            }
+        } else {
+            add_size(ticket.plan.get().source_path());
+        }
+        sizes.push_back(size);
+        if (ticket.prior_command && ticket.prior_command->duration.count() > 0) {
+            total_known_size += sizes.back();
+            total_known_duration += ticket.prior_command->duration;
+        }
+    }
+
+    const double ms_per_byte = total_known_size
+        ? static_cast<double>(total_known_duration.count()) / static_cast<double>(total_known_size)
+        : default_ms_per_byte;
+
+    std::vector<milliseconds> ret;
+    for (std::size_t n = 0; n < tickets.size(); ++n) {
+        auto& ticket = tickets[n];
+        if (!ticket.needs_recompile) {
+            // Replaying a prior compilation is practically free
+            ret.emplace_back(0);
+        } else if (ticket.prior_command && ticket.prior_command->duration.count() > 0) {
+            ret.push_back(ticket.prior_command->duration);
+        } else {
+            auto est = milliseconds(static_cast<milliseconds::rep>(sizes[n] * ms_per_byte));
+            ret.push_back(std::max(est, min_estimate));
+        }
+    }
+    return ret;
+}
+
 }  // namespace
 
-bool dds::detail::compile_all(const ref_vector<const compile_file_plan>& compiles,
-                              build_env_ref                              env,
-                              int                                        njobs) {
-    auto each_realized =  //
-        compiles
-        // Convert each _plan_ into a concrete object for compiler invocation.
-        | views::transform([&](auto&& plan) { return mk_compile_ticket(plan, env); })
-        // Convert to to a real vector so we can ask its size.
+struct compile_batch::impl {
+    build_env_ref                          env;
+    module_graph                           modules;
+    std::vector<compile_ticket>            tickets;
+    std::vector<std::chrono::milliseconds> estimates;
+    compile_counter                        counter;
+
+    // As we execute, accumulate new dependency information from successful compilations
+    std::mutex                  mut{};
+    std::vector<file_deps_info> all_new_deps{};
+};
+
+compile_batch::compile_batch(const ref_vector<const compile_file_plan>& compiles,
+                             build_env_ref                              env)
+    // Load all prior compilation information at once, rather than querying for every file
+    : compile_batch(compiles, env, compilation_history{env.deps, env.stats}) {}
+
+compile_batch::compile_batch(const ref_vector<const compile_file_plan>& compiles,
+                             build_env_ref                              env,
+                             const compilation_history&                 history) {
+    // Files that import modules can only be compiled once the modules have been compiled, so
+    // their module dependencies must be known ahead of time
+    auto modules = scan_module_deps(compiles, env, history);
+
+    dds::stopwatch timer;
+
+    // Convert each _plan_ into a concrete object for compiler invocation. Checking a file for
+    // changes requires a lot of filesystem access, so do it in parallel.
+    std::vector<std::optional<compile_ticket>> tickets(compiles.size());
+    parallel_run_or_throw(views::iota(std::size_t(0), compiles.size()), 0, [&](std::size_t n) {
+        tickets[n].emplace(mk_compile_ticket(compiles[n], env, history, modules, n));
+    });
+
+    auto each_realized = tickets
+        | views::transform([](auto& ticket) { return std::move(*ticket); })
         | ranges::to_vector;
 
+    // A module interface that is compiled again may change, so every file that imports it must be
+    // compiled again as well. The imports have no cycles, so this settles.
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto& ticket : each_realized) {
+            auto provider_recompiles = [&](std::size_t p) {
+                return each_realized[p].needs_recompile;
+            };
+            if (!ticket.needs_recompile
+                && ranges::any_of(ticket.modules.providers, provider_recompiles)) {
+                dds_log(trace,
+                        "Recompile {}: An imported module will be compiled",
+                        ticket.plan.get().source_path().string());
+                ticket.needs_recompile = true;
+                changed                = true;
+            }
+        }
+    }
+    dds_log(debug,
+            "Checked {} files for changes in {:L}ms",
+            each_realized.size(),
+            timer.elapsed_ms().count());
+
     auto n_to_compile = static_cast<std::size_t>(
         ranges::count_if(each_realized, &compile_ticket::needs_recompile));
 
     // Keep a counter to display progress to the user.
-    const auto      max_digits = fmt::format("{}", n_to_compile).size();
-    compile_counter counter{.max = n_to_compile, .max_digits = max_digits};
+    const auto max_digits = fmt::format("{}", n_to_compile).size();
+    auto       estimates  = estimate_compile_durations(each_realized);
+    _impl.reset(new impl{.env       = env,
+                         .modules   = std::move(modules),
+                         .tickets   = std::move(each_realized),
+                         .estimates = std::move(estimates),
+                         .counter   = {.max = n_to_compile, .max_digits = max_digits}});
+}
 
-    // Ass we execute, accumulate new dependency information from successful compilations
-    std::vector<file_deps_info> all_new_deps;
-    std::mutex                  mut;
-    // Do it!
-    auto okay = parallel_run(each_realized, njobs, [&](const compile_ticket& tkt) {
-        auto new_dep = handle_compilation(tkt, env, counter);
-        if (new_dep) {
-            std::unique_lock lk{mut};
-            all_new_deps.push_back(std::move(*new_dep));
+compile_batch::~compile_batch() = default;
+
+std::size_t compile_batch::size() const noexcept { return _impl->tickets.size(); }
+
+const std::vector<std::size_t>& compile_batch::module_providers(std::size_t n) const noexcept {
+    return _impl->modules.units[n].providers;
+}
+
+std::chrono::milliseconds compile_batch::estimated_duration(std::size_t n) const noexcept {
+    return _impl->estimates[n];
+}
+
+void compile_batch::compile(std::size_t n, job_graph::async_done done) {
+    auto& ticket = _impl->tickets[n];
+    if (!ticket.needs_recompile) {
+        replay_compilation(ticket);
+        done([] {});
+        return;
+    }
+
+    // Without dependency information, we cannot know what a cached object was compiled from. A
+    // precompiled header is not cached, since the compiler may write more than one output file.
+    // The same goes for a module unit, which may write a module interface file.
+    auto                       cache = _impl->env.objects;
+    std::optional<std::string> cache_key;
+    if (cache && _impl->env.toolchain.deps_mode() != file_deps_mode::none
+        && !ticket.plan.get().is_pch() && !ticket.modules.uses_modules) {
+        cache_key = cache->compilation_key(ticket.command.command, ticket.compiled_path);
+    }
+    if (cache_key) {
+        auto restored = cache->restore(*cache_key, ticket.object_file_path);
+        if (restored) {
+            done([this, &ticket, restored = std::move(*restored)] {
+                auto new_dep = finish_restored_compilation(ticket, _impl->counter, restored);
+                std::unique_lock lk{_impl->mut};
+                _impl->all_new_deps.push_back(std::move(new_dep));
+            });
+            return;
         }
-    });
+    }
+
+    auto      msg = begin_compilation(ticket);
+    stopwatch timer;
+    run_proc_async(proc_options{.command = ticket.command.command},
+                   [this, &ticket, msg, timer, done, cache_key](proc_result proc_res) {
+                       auto dur_ms = timer.elapsed_ms();
+                       done([this, &ticket, msg, proc_res, dur_ms, cache_key] {
+                           auto new_dep = finish_compilation(ticket,
+                                                             _impl->env,
+                                                             _impl->counter,
+                                                             msg,
+                                                             proc_res,
+                                                             dur_ms);
+                           if (new_dep && cache_key) {
+                               _impl->env.objects->store(*cache_key,
+                                                         ticket.object_file_path,
+                                                         new_dep->inputs,
+                                                         new_dep->command.output);
+                           }
+                           if (new_dep && ticket.modules.bmi) {
+                               // The module interface is built from the same inputs as the object
+                               auto bmi_dep   = *new_dep;
+                               bmi_dep.output = *ticket.modules.bmi;
+                               std::unique_lock lk{_impl->mut};
+                               _impl->all_new_deps.push_back(std::move(bmi_dep));
+                           }
+                           if (new_dep) {
+                               std::unique_lock lk{_impl->mut};
+                               _impl->all_new_deps.push_back(std::move(*new_dep));
+                           }
+                       });
+                   });
+}
 
+void compile_batch::commit_deps() {
     // Update compile dependency information
     dds::stopwatch update_timer;
-    auto           tr = env.db.transaction();
-    for (auto& info : all_new_deps) {
-        dds_log(trace, "Update dependency info on {}", info.output.string());
-        update_deps_info(neo::into(env.db), info);
-    }
+    _impl->env.deps.record(_impl->all_new_deps);
+    _impl->all_new_deps.clear();
     dds_log(debug, "Dependency update took {:L}ms", update_timer.elapsed_ms().count());
+}
+
+bool dds::detail::compile_all(const ref_vector<const compile_file_plan>& compiles,
+                              build_env_ref                              env,
+                              int                                        njobs) {
+    compile_batch batch{compiles, env};
+
+    // The compilations are independent of each other, except where one imports a module that is
+    // provided by another. Start the most expensive ones first so that we aren't left waiting on a
+    // single long compilation at the end.
+    job_graph                      graph;
+    std::vector<job_graph::job_id> jobs;
+    for (std::size_t n = 0; n < batch.size(); ++n) {
+        jobs.push_back(graph.add_async_job([&batch, n](auto done) { batch.compile(n, done); },
+                                           batch.estimated_duration(n)));
+    }
+    for (std::size_t n = 0; n < batch.size(); ++n) {
+        for (auto provider : batch.module_providers(n)) {
+            graph.add_dependency(jobs[n], jobs[provider]);
+        }
+    }
+
+    // Do it!
+    auto okay = graph.run(njobs);
+
+    batch.commit_deps();
 
     cancellation_point();
     // Return whether or not there were any failures.
@@ -3,12 +3,75 @@
 #include <dds/build/plan/base.hpp>
 #include <dds/build/plan/compile_file.hpp>
 #include <dds/util/algo.hpp>
+#include <dds/util/job_graph.hpp>
 
+#include <chrono>
 #include <functional>
+#include <memory>
 #include <vector>
 
 namespace dds {
 
+/**
+ * A set of file compilations that have been checked against the build database and are ready to be
+ * executed. The compilations may be executed in any order and from any thread, such as from the
+ * asynchronous jobs of a `job_graph`. Dependency information from each successful compilation is
+ * collected as they complete, and is written to the build database with `commit_deps()`.
+ */
+class compile_batch {
+    struct impl;
+    std::unique_ptr<impl> _impl;
+
+public:
+    /**
+     * Prepare the given compilations for execution. This will determine which of the files are
+     * out-of-date and actually require compilation. Files that use C++ modules are scanned for
+     * their module dependencies first.
+     */
+    compile_batch(const ref_vector<const compile_file_plan>& files, build_env_ref env);
+
+    /**
+     * Prepare the given compilations for execution, checking them against dependency information
+     * that has already been loaded from the build environment's `deps_store`.
+     */
+    compile_batch(const ref_vector<const compile_file_plan>& files,
+                  build_env_ref                              env,
+                  const compilation_history&                 history);
+    ~compile_batch();
+
+    /**
+     * The number of file compilations in this batch
+     */
+    std::size_t size() const noexcept;
+
+    /**
+     * The indices of the compilations in this batch that provide the C++ modules imported by the
+     * compilation at index `n`. Those compilations must finish before it is started.
+     */
+    const std::vector<std::size_t>& module_providers(std::size_t n) const noexcept;
+
+    /**
+     * The estimated time that it will take to execute the compilation at index `n` of the batch.
+     * This is based on the recorded duration of prior compilations of the same file. Files that
+     * have not been compiled before are estimated based on the size of their source file.
+     */
+    std::chrono::milliseconds estimated_duration(std::size_t n) const noexcept;
+
+    /**
+     * Start the compilation at index `n` of the batch. Once the compiler has exited, `done` is
+     * invoked with a function that checks the result and throws if the compilation failed. If the
+     * file is up-to-date, this will only display any output from the prior compilation, and `done`
+     * is invoked immediately. Likewise if the object file can be restored from the build
+     * environment's object cache.
+     */
+    void compile(std::size_t n, job_graph::async_done done);
+
+    /**
+     * Store the dependency information of all successful compilations in the build database.
+     */
+    void commit_deps();
+};
+
 namespace detail {
 
 bool compile_all(const ref_vector<const compile_file_plan>& files, build_env_ref env, int njobs);
@@ -2,41 +2,220 @@
 
 #include <dds/proc.hpp>
 #include <dds/util/algo.hpp>
+#include <dds/util/fs.hpp>
+#include <dds/util/log.hpp>
 #include <dds/util/signal.hpp>
 #include <dds/util/time.hpp>
 
 #include <range/v3/algorithm/sort.hpp>
 #include <range/v3/algorithm/unique.hpp>
 
+#include <fmt/core.h>
+
 #include <string>
 #include <vector>
 
 using namespace dds;
 
-compile_command_info compile_file_plan::generate_compile_command(build_env_ref env) const {
-    compile_file_spec spec{_source.path, calc_object_file_path(env)};
-    spec.enable_warnings = _rules.enable_warnings();
-    for (auto dirpath : _rules.include_dirs()) {
+namespace {
+
+compile_command_template make_command_template(const shared_compile_file_rules& rules,
+                                               const resolved_compile_rules&    resolved,
+                                               path_ref                         cwd,
+                                               build_env_ref                    env) {
+    compile_file_spec spec{"", ""};
+    spec.include_dirs          = resolved.include_dirs;
+    spec.external_include_dirs = resolved.external_include_dirs;
+    spec.definitions           = rules.defs();
+    spec.enable_warnings       = rules.enable_warnings();
+    return env.toolchain.create_compile_command_template(spec, cwd, env.knobs);
+}
+
+}  // namespace
+
+std::shared_ptr<const resolved_compile_rules>
+shared_compile_file_rules::resolve(build_env_ref env) const {
+    if (_impl->resolved && _impl->resolved->matches(env)) {
+        return _impl->resolved;
+    }
+    auto ret         = std::make_shared<resolved_compile_rules>();
+    ret->toolchain   = &env.toolchain;
+    ret->output_root = env.output_root;
+    ret->ureqs       = &env.ureqs;
+    for (auto dirpath : include_dirs()) {
         if (!dirpath.is_absolute()) {
             dirpath = env.output_root / dirpath;
         }
         dirpath = fs::weakly_canonical(dirpath);
-        spec.include_dirs.push_back(std::move(dirpath));
+        ret->include_dirs.push_back(std::move(dirpath));
     }
-    for (const auto& use : _rules.uses()) {
-        extend(spec.external_include_dirs, env.ureqs.include_paths(use));
+    for (const auto& use : uses()) {
+        extend(ret->external_include_dirs, env.ureqs.include_paths(use));
+    }
+    if (pch_header()) {
+        auto header = *pch_header();
+        if (!header.is_absolute()) {
+            header = env.output_root / header;
+        }
+        ret->pch_header = fs::weakly_canonical(header);
     }
-    extend(spec.definitions, _rules.defs());
     // Avoid huge command lines by shrinking down the list of #include dirs
-    sort_unique_erase(spec.external_include_dirs);
-    sort_unique_erase(spec.include_dirs);
-    return env.toolchain.create_compile_command(spec, dds::fs::current_path(), env.knobs);
+    sort_unique_erase(ret->external_include_dirs);
+    sort_unique_erase(ret->include_dirs);
+
+    ret->cwd              = fs::current_path();
+    ret->command_template = make_command_template(*this, *ret, ret->cwd, env);
+    return ret;
+}
+
+void shared_compile_file_rules::memoize(build_env_ref env) const {
+    if (!_impl->resolved || !_impl->resolved->matches(env)) {
+        _impl->resolved = resolve(env);
+    }
+}
+
+compile_file_spec compile_file_plan::_make_spec(build_env_ref                 env,
+                                                const resolved_compile_rules& rules) const {
+    // The include directories, definitions, and warnings are given by the command template
+    compile_file_spec spec{calc_compiled_path(env), calc_object_file_path(env)};
+    if (_is_pch) {
+        auto header     = calc_pch_header_path(env);
+        auto pch_path   = fs::path(header.string() + env.toolchain.pch_suffix());
+        spec.lang       = language::cxx;
+        spec.create_pch = pch_spec{header, pch_path};
+    } else if (rules.pch_header && env.toolchain.supports_pch()) {
+        auto& header = *rules.pch_header;
+        spec.use_pch = pch_spec{header, header.string() + env.toolchain.pch_suffix()};
+    }
+    return spec;
+}
+
+compile_command_info
+compile_file_plan::_create_command(build_env_ref                 env,
+                                   const compile_file_spec&      spec,
+                                   const resolved_compile_rules& rules) const {
+    auto cwd = dds::fs::current_path();
+    if (cwd != rules.cwd) {
+        auto tmpl = make_command_template(_rules, rules, cwd, env);
+        return env.toolchain.create_compile_command(spec, tmpl);
+    }
+    // Only the flags that are particular to this file need to be computed
+    return env.toolchain.create_compile_command(spec, rules.command_template);
+}
+
+compile_command_info
+compile_file_plan::generate_compile_command(build_env_ref                  env,
+                                            const std::optional<fs::path>& module_mapper) const {
+    auto rules         = _rules.resolve(env);
+    auto spec          = _make_spec(env, *rules);
+    spec.module_mapper = module_mapper;
+    return _create_command(env, spec, *rules);
+}
+
+fs::path compile_file_plan::calc_module_deps_path(build_env_ref env) const noexcept {
+    auto ret = calc_object_file_path(env);
+    ret += ".ddi";
+    return ret;
+}
+
+compile_command_info compile_file_plan::generate_scan_command(build_env_ref env) const {
+    auto rules        = _rules.resolve(env);
+    auto spec         = _make_spec(env, *rules);
+    auto ddi          = calc_module_deps_path(env);
+    spec.scan_modules = module_scan_spec{ddi, spec.out_path};
+    spec.out_path     = ddi.string() + ".i";
+    return _create_command(env, spec, *rules);
 }
 
 fs::path compile_file_plan::calc_object_file_path(const build_env& env) const noexcept {
+    auto& strings = string_table::global();
+    if (_memo_root != no_memo && strings.get(_memo_root) == env.output_root.native()) {
+        return _object_path;
+    }
+    if (_is_pch) {
+        auto ret = calc_pch_header_path(env);
+        ret += env.toolchain.pch_creates_object() ? env.toolchain.object_suffix()
+                                                  : env.toolchain.pch_suffix();
+        return ret;
+    }
+    if (is_unity()) {
+        auto ret = calc_compiled_path(env);
+        ret += env.toolchain.object_suffix();
+        return ret;
+    }
     auto relpath = _source.relative_path();
     // The full output directory is prefixed by `_subdir`
-    auto ret = env.output_root / _subdir / relpath;
+    auto ret = env.output_root / _subdir_path() / relpath;
     ret.replace_filename(relpath.filename().string() + env.toolchain.object_suffix());
     return fs::weakly_canonical(ret);
 }
+
+void compile_file_plan::memoize(build_env_ref env) const {
+    _rules.memoize(env);
+    _memo_root   = no_memo;
+    _object_path = calc_object_file_path(env);
+    _memo_root   = string_table::global().intern(env.output_root.native());
+}
+
+std::size_t compile_file_plan::memory_usage() const noexcept {
+    auto path_size = [](path_ref p) { return p.native().capacity(); };
+    auto file_size = [&](const source_file& sf) {
+        return path_size(sf.path) + path_size(sf.basis_path) + path_size(sf.relative_path());
+    };
+    auto ret = sizeof(*this) + file_size(_source) + path_size(_object_path);
+    ret += _unity_name.capacity();
+    for (auto& member : _unity_members) {
+        ret += sizeof(member) + file_size(member);
+    }
+    return ret;
+}
+
+fs::path compile_file_plan::calc_pch_header_path(build_env_ref env) const noexcept {
+    return fs::weakly_canonical(env.output_root / pch_header_path(_subdir_path(), _source));
+}
+
+fs::path compile_file_plan::calc_compiled_path(build_env_ref env) const noexcept {
+    if (_is_pch) {
+        return calc_pch_header_path(env);
+    } else if (is_unity()) {
+        // The members share a directory, so the batch is generated in the corresponding directory
+        auto reldir = _source.relative_path().parent_path();
+        return fs::weakly_canonical(env.output_root / _subdir_path() / reldir / _unity_name);
+    }
+    return _source.path;
+}
+
+std::vector<compile_file_plan> compile_file_plan::unity_member_plans() const {
+    std::vector<compile_file_plan> ret;
+    for (auto& member : _unity_members) {
+        ret.emplace_back(_rules, member, qualifier(), _subdir_path());
+    }
+    return ret;
+}
+
+void compile_file_plan::write_generated_source(build_env_ref env) const {
+    std::string content;
+    if (_is_pch) {
+        content = fmt::format("#ifndef DDS_PCH_STUB_INCLUDED\n"
+                              "#define DDS_PCH_STUB_INCLUDED\n"
+                              "#include \"{}\"\n"
+                              "#endif\n",
+                              fs::weakly_canonical(_source.path).generic_string());
+    } else if (is_unity()) {
+        for (auto& member : _unity_members) {
+            content += fmt::format("#include \"{}\"\n",
+                                   fs::weakly_canonical(member.path).generic_string());
+        }
+    } else {
+        return;
+    }
+
+    auto path = calc_compiled_path(env);
+    if (fs::exists(path) && slurp_file(path) == content) {
+        return;
+    }
+    dds_log(debug, "Write generated source file [{}]", path.string());
+    fs::create_directories(path.parent_path());
+    auto ofs = open(path, std::ios::binary | std::ios::out);
+    ofs << content;
+}
@@ -2,10 +2,15 @@
 
 #include <dds/build/plan/base.hpp>
 #include <dds/sdist/file.hpp>
+#include <dds/util/intern.hpp>
 
 #include <libman/library.hpp>
 
+#include <cstddef>
 #include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace dds {
 
@@ -16,6 +21,39 @@ struct compile_failure : std::runtime_error {
     using runtime_error::runtime_error;
 };
 
+/**
+ * The include directories and precompiled header of a set of compile rules, resolved to canonical
+ * paths for a particular build environment, and the compile command flags that follow from them.
+ * These are the same for every file that shares the rules, so they are resolved once rather than
+ * for each file.
+ */
+struct resolved_compile_rules {
+    /// The toolchain for which the command template was created
+    const dds::toolchain* toolchain = nullptr;
+    /// The output root against which relative paths were resolved
+    fs::path output_root;
+    /// The usage requirements that were used to find the external include directories
+    const usage_requirement_map* ureqs = nullptr;
+    /// The canonical include directories, sorted and deduplicated
+    std::vector<fs::path> include_dirs;
+    /// The include directories of the libraries that are used, sorted and deduplicated
+    std::vector<fs::path> external_include_dirs;
+    /// The canonical path to the precompiled header to use, if any
+    std::optional<fs::path> pch_header;
+    /// The working directory from which the paths in the command template are relative
+    fs::path cwd;
+    /// The flags that are shared by the compile commands of every file that uses the rules
+    compile_command_template command_template;
+
+    /**
+     * Whether these were resolved for the given environment
+     */
+    bool matches(build_env_ref env) const noexcept {
+        return toolchain == &env.toolchain && ureqs == &env.ureqs
+            && output_root == env.output_root;
+    }
+};
+
 /**
  * Because we may have many files in a library, we store base file compilation
  * parameters in a single object that implements shared semantics. Copying the
@@ -29,6 +67,9 @@ class shared_compile_file_rules {
         std::vector<std::string> defs;
         std::vector<lm::usage>   uses;
         bool                     enable_warnings = false;
+        std::optional<fs::path>  pch_header;
+
+        std::shared_ptr<const resolved_compile_rules> resolved;
     };
 
     /// The actual PIMPL.
@@ -41,6 +82,7 @@ public:
     auto clone() const noexcept {
         auto cp  = *this;
         cp._impl = std::make_shared<rules_impl>(*_impl);
+        cp._impl->resolved.reset();
         return cp;
     }
 
@@ -67,6 +109,27 @@ public:
      */
     auto& enable_warnings() noexcept { return _impl->enable_warnings; }
     auto& enable_warnings() const noexcept { return _impl->enable_warnings; }
+
+    /**
+     * The header whose precompiled form is included before each compiled source file, if the
+     * toolchain supports precompiled headers. The precompiled header is expected beside the header,
+     * as named by the toolchain's `pch_suffix()`. A relative path is relative to the output root.
+     */
+    auto& pch_header() noexcept { return _impl->pch_header; }
+    auto& pch_header() const noexcept { return _impl->pch_header; }
+
+    /**
+     * Get these rules resolved for the given environment. The result of a prior call to
+     * `memoize()` with the same environment is reused.
+     */
+    std::shared_ptr<const resolved_compile_rules> resolve(build_env_ref env) const;
+
+    /**
+     * Resolve these rules for the given environment, and remember the result for subsequent calls
+     * to `resolve()`. This is not thread-safe: It should be called while preparing the build, and
+     * the rules must not be modified afterwards.
+     */
+    void memoize(build_env_ref env) const;
 };
 
 /**
@@ -79,10 +142,27 @@ class compile_file_plan {
     shared_compile_file_rules _rules;
     /// The source file object that we are compiling
     source_file _source;
-    /// A "qualifier" to be shown in log messages (not otherwise significant)
-    std::string _qualifier;
-    /// The subdirectory in which the object file will be generated
-    fs::path _subdir;
+    /// A "qualifier" to be shown in log messages (not otherwise significant), interned in the
+    /// global `string_table`
+    string_table::id _qualifier;
+    /// The subdirectory in which the object file will be generated, interned in the global
+    /// `string_table`
+    string_table::id _subdir;
+    /// Whether the source file is a header that is precompiled
+    bool _is_pch = false;
+    /// If this compiles a unity batch, the source files in the batch
+    std::vector<source_file> _unity_members;
+    /// If this compiles a unity batch, the filename of the generated source file
+    std::string _unity_name;
+
+    static constexpr string_table::id no_memo = string_table::id(-1);
+    /// The output root for which `_object_path` was memoized, interned in the global
+    /// `string_table`, or `no_memo`
+    mutable string_table::id _memo_root = no_memo;
+    /// The memoized result of `calc_object_file_path()`
+    mutable fs::path _object_path;
+
+    fs::path _subdir_path() const noexcept { return string_table::global().get(_subdir); }
 
 public:
     /**
@@ -98,8 +178,57 @@ public:
                       path_ref                  subdir)
         : _rules(rules)
         , _source(std::move(sf))
-        , _qualifier(qual)
-        , _subdir(subdir) {}
+        , _qualifier(string_table::global().intern(qual))
+        , _subdir(string_table::global().intern(subdir.string())) {}
+
+    /**
+     * Create a plan that precompiles a header. The header is not compiled in place: A stub header
+     * that includes it is generated in the output directory, and the precompiled header is written
+     * beside the stub. Files that use the precompiled header should name the stub, as given by
+     * `pch_header_path()`, as the `pch_header()` of their rules.
+     * @param rules The base compile rules, which should match those of the files that will use the
+     * precompiled header
+     * @param header The header file that will be precompiled
+     * @param qual An arbitrary qualifier for the header, shown in log output
+     * @param subdir The subdirectory where the stub header and its outputs will be generated
+     */
+    static compile_file_plan precompile_header(shared_compile_file_rules rules,
+                                               source_file               header,
+                                               std::string_view          qual,
+                                               path_ref                  subdir) {
+        compile_file_plan ret{rules, std::move(header), qual, subdir};
+        ret._is_pch = true;
+        return ret;
+    }
+
+    /**
+     * Create a plan that compiles several source files as a single translation unit. A source file
+     * that includes each of them is generated beside the object file.
+     * @param rules The compile rules, which are shared by every source file in the batch
+     * @param members The source files to compile. They must have the same language and the same
+     * parent directory, since the generated source file is named relative to that directory.
+     * @param qual An arbitrary qualifier for the batch, shown in log output
+     * @param subdir The subdirectory where the object file will be generated
+     * @param name The filename of the generated source file
+     */
+    static compile_file_plan unity_batch(shared_compile_file_rules rules,
+                                         std::vector<source_file>  members,
+                                         std::string_view          qual,
+                                         path_ref                  subdir,
+                                         std::string_view          name) {
+        compile_file_plan ret{rules, members.front(), qual, subdir};
+        ret._unity_members = std::move(members);
+        ret._unity_name    = std::string(name);
+        return ret;
+    }
+
+    /**
+     * The path, relative to the output root, of the stub header that is generated to precompile
+     * the given header in the given subdirectory.
+     */
+    static fs::path pch_header_path(path_ref subdir, const source_file& header) noexcept {
+        return subdir / header.relative_path();
+    }
 
     /**
      * The `source_file` object for this plan.
@@ -116,17 +245,85 @@ public:
     /**
      * The arbitrary qualifier for this compilation
      */
-    auto& qualifier() const noexcept { return _qualifier; }
+    const std::string& qualifier() const noexcept { return string_table::global().get(_qualifier); }
+    /**
+     * Whether this compilation creates a precompiled header
+     */
+    bool is_pch() const noexcept { return _is_pch; }
+    /**
+     * Whether this compilation compiles a unity batch of several source files
+     */
+    bool is_unity() const noexcept { return !_unity_members.empty(); }
+    /**
+     * The source files in this unity batch. Empty if this is not a unity batch.
+     */
+    auto& unity_members() const noexcept { return _unity_members; }
+    /**
+     * Create the plans that would compile each member of this unity batch on its own. These are
+     * used where a single source file must be compiled, or must have its own compile command.
+     */
+    std::vector<compile_file_plan> unity_member_plans() const;
 
     /**
-     * Generate the path that will be the destination of this compile output
+     * Generate the path that will be the destination of this compile output. For a precompiled
+     * header, this is the precompiled header file, unless the toolchain also creates an object
+     * file along with it.
      */
     fs::path calc_object_file_path(build_env_ref env) const noexcept;
+    /**
+     * Compute the object file path and resolve the rules of this compilation for the given
+     * environment, and remember them so that later calls with the same environment need not touch
+     * the filesystem. This is not thread-safe: It should be called while preparing the build, and
+     * the plan may be used concurrently afterwards.
+     */
+    void memoize(build_env_ref env) const;
+    /**
+     * The approximate number of bytes of memory that are used by this plan, including the memory
+     * of its source files. This excludes the shared rules and the interned strings.
+     */
+    std::size_t memory_usage() const noexcept;
+    /**
+     * Generate the path of the file that is given to the compiler. This is the source file itself,
+     * unless it is a header to precompile or a unity batch, in which case a file is generated.
+     */
+    fs::path calc_compiled_path(build_env_ref env) const noexcept;
+    /**
+     * For a precompiled header, generate the path to the stub header that is compiled in its place
+     */
+    fs::path calc_pch_header_path(build_env_ref env) const noexcept;
+    /**
+     * Write the file that is compiled in place of the source file, if one is generated: The stub
+     * header for a precompiled header, or the source file of a unity batch. The file is only
+     * written if its content would change, so as not to invalidate prior compilations.
+     */
+    void write_generated_source(build_env_ref env) const;
     /**
      * Generate a concrete compile command object for this source file for the given build
      * environment.
+     * @param module_mapper If the file provides or imports C++ modules, the module mapper file
+     * that names the interface file of each module
+     */
+    compile_command_info
+    generate_compile_command(build_env_ref                  env,
+                             const std::optional<fs::path>& module_mapper = std::nullopt) const;
+    /**
+     * Generate the path to which the C++ module dependencies of this file are written by a scan
      */
-    compile_command_info generate_compile_command(build_env_ref) const;
+    fs::path calc_module_deps_path(build_env_ref env) const noexcept;
+    /**
+     * Generate the command that scans this file for its C++ module dependencies. The scan
+     * preprocesses the file, and its output is the preprocessed file, whose path is that of the
+     * module dependencies followed by `.i`.
+     */
+    compile_command_info generate_scan_command(build_env_ref env) const;
+
+private:
+    /// Create the toolchain-independent specification of this file's compilation
+    compile_file_spec _make_spec(build_env_ref env, const resolved_compile_rules& rules) const;
+    /// Create the command for the given specification of this file's compilation
+    compile_command_info _create_command(build_env_ref                 env,
+                                         const compile_file_spec&      spec,
+                                         const resolved_compile_rules& rules) const;
 };
 
 }  // namespace dds
\ No newline at end of file
@@ -5,69 +5,123 @@
 #include <dds/proc.hpp>
 #include <dds/util/algo.hpp>
 #include <dds/util/log.hpp>
+#include <dds/util/signal.hpp>
 #include <dds/util/time.hpp>
 
-#include <fansi/styled.hpp>
-
 #include <algorithm>
 #include <chrono>
 
 using namespace dds;
-using namespace fansi::literals;
 
 fs::path link_executable_plan::calc_executable_path(build_env_ref env) const noexcept {
     return env.output_root / _out_subdir / (_name + env.toolchain.executable_suffix());
 }
 
-void link_executable_plan::link(build_env_ref env, const library_plan& lib) const {
-    // Build up the link command
-    link_exe_spec spec;
-    spec.output = calc_executable_path(env);
-
-    dds_log(debug, "Performing link for {}", spec.output.string());
+std::vector<fs::path> link_executable_plan::calc_link_inputs(build_env_ref       env,
+                                                             const library_plan& lib) const {
+    std::vector<fs::path> inputs;
 
     // The main object should be a linker input, of course.
     auto main_obj = _main_compile.calc_object_file_path(env);
     dds_log(trace, "Add entry point object file: {}", main_obj.string());
-    spec.inputs.push_back(std::move(main_obj));
+    inputs.push_back(std::move(main_obj));
 
     if (lib.archive_plan()) {
         // The associated library has compiled components. Add the static library a as a linker
         // input
         dds_log(trace, "Adding the library's archive as a linker input");
-        spec.inputs.push_back(env.output_root
-                              / lib.archive_plan()->calc_archive_file_path(env.toolchain));
+        inputs.push_back(env.output_root
+                         / lib.archive_plan()->calc_archive_file_path(env.toolchain));
     } else {
         dds_log(trace, "Executable has no corresponding archive library input");
     }
 
     for (const lm::usage& links : _links) {
         dds_log(trace, "  - Link with: {}/{}", links.name, links.namespace_);
-        extend(spec.inputs, env.ureqs.link_paths(links));
     }
+    // Libraries that are required by several of the links are only given once
+    extend(inputs, env.ureqs.combined_link_paths(_links));
+    return inputs;
+}
+
+namespace {
+
+/**
+ * Determine whether the executable must be linked, based on the dependency information that was
+ * recorded when it was last linked.
+ */
+bool needs_link(const link_exe_spec&            spec,
+                const std::vector<std::string>& link_command,
+                const compilation_history&      history) {
+    auto prior = history.get(spec.output);
+    if (!prior) {
+        dds_log(trace, "Link {}: No recorded link info", spec.output.string());
+        return true;
+    } else if (!fs::exists(spec.output)) {
+        dds_log(trace, "Link {}: Output does not exist", spec.output.string());
+        return true;
+    } else if (!prior->newer_inputs.empty()) {
+        dds_log(trace, "Relink {}: Link inputs have changed", spec.output.string());
+        return true;
+    } else if (quote_command(link_command) != prior->previous_command.quoted_command) {
+        dds_log(trace, "Relink {}: Link command has changed", spec.output.string());
+        return true;
+    }
+    dds_log(debug, "Skip link of {} (Result is up-to-date)", spec.output.string());
+    return false;
+}
+
+}  // namespace
+
+void link_executable_plan::link(build_env_ref                       env,
+                                const library_plan&                 lib,
+                                const compilation_history&          history,
+                                std::function<void(file_deps_info)> on_linked,
+                                job_graph::async_done               done) const {
+    // Build up the link command
+    link_exe_spec spec;
+    spec.output = calc_executable_path(env);
+
+    dds_log(debug, "Performing link for {}", spec.output.string());
+    spec.inputs = calc_link_inputs(env, lib);
 
     // Do it!
     const auto link_command
         = env.toolchain.create_link_executable_command(spec, dds::fs::current_path(), env.knobs);
+    if (!needs_link(spec, link_command, history)) {
+        done([] {});
+        return;
+    }
     fs::create_directories(spec.output.parent_path());
     auto msg = fmt::format("[{}] Link: {:30}",
                            lib.qualified_name(),
                            fs::relative(spec.output, env.output_root).string());
     dds_log(info, msg);
-    auto [dur_ms, proc_res]
-        = timed<std::chrono::milliseconds>([&] { return run_proc(link_command); });
-    dds_log(info, "{} - {:>6L}ms", msg, dur_ms.count());
-
-    // Check and throw if errant
-    if (!proc_res.okay()) {
-        throw_external_error<errc::link_failure>(
-            "Failed to link executable [{}]. Link command was [{}] [Exited {}], produced "
-            "output:\n{}",
-            spec.output.string(),
-            quote_command(link_command),
-            proc_res.retc,
-            proc_res.output);
-    }
+    stopwatch timer;
+    run_proc_async(proc_options{.command = link_command}, [=](proc_result proc_res) {
+        auto dur_ms = timer.elapsed_ms();
+        done([=] {
+            cancellation_point();
+            dds_log(info, "{} - {:>6L}ms", msg, dur_ms.count());
+
+            // Check and throw if errant
+            if (!proc_res.okay()) {
+                throw_external_error<errc::link_failure>(
+                    "Failed to link executable [{}]. Link command was [{}] [Exited {}], produced "
+                    "output:\n{}",
+                    spec.output.string(),
+                    quote_command(link_command),
+                    proc_res.retc,
+                    proc_res.output);
+            }
+
+            on_linked(file_deps_info{
+                .output  = spec.output,
+                .inputs  = spec.inputs,
+                .command = {quote_command(link_command), proc_res.output, dur_ms},
+            });
+        });
+    });
 }
 
 bool link_executable_plan::is_app() const noexcept {
@@ -78,29 +132,8 @@ bool link_executable_plan::is_test() const noexcept {
     return _main_compile.source().kind == source_kind::test;
 }
 
-std::optional<test_failure> link_executable_plan::run_test(build_env_ref env) const {
-    auto exe_path = calc_executable_path(env);
-    auto msg      = fmt::format("Run test: .br.cyan[{:30}]"_styled,
-                           fs::relative(exe_path, env.output_root).string());
-    dds_log(info, msg);
-    using namespace std::chrono_literals;
-    auto&& [dur, res] = timed<std::chrono::microseconds>(
-        [&] { return run_proc({.command = {exe_path.string()}, .timeout = 10s}); });
-
-    if (res.okay()) {
-        dds_log(info, "{} - .br.green[PASS] - {:>9L}μs"_styled, msg, dur.count());
-        return std::nullopt;
-    } else {
-        auto exit_msg = fmt::format(res.signal ? "signalled {}" : "exited {}",
-                                    res.signal ? res.signal : res.retc);
-        auto fail_str = res.timed_out ? ".br.yellow[TIME]"_styled : ".br.red[FAIL]"_styled;
-        dds_log(error, "{} - {} - {:>9L}μs [{}]", msg, fail_str, dur.count(), exit_msg);
-        test_failure f;
-        f.executable_path = exe_path;
-        f.output          = res.output;
-        f.retc            = res.retc;
-        f.signal          = res.signal;
-        f.timed_out       = res.timed_out;
-        return f;
-    }
+bool link_executable_plan::uses_catch2_main() const noexcept {
+    return is_test() && std::any_of(_links.begin(), _links.end(), [](const lm::usage& use) {
+               return use.namespace_ == ".dds" && use.name == "Catch-Main";
+           });
 }
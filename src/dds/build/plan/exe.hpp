@@ -2,9 +2,12 @@
 
 #include <dds/build/plan/compile_file.hpp>
 #include <dds/util/fs.hpp>
+#include <dds/util/job_graph.hpp>
 
 #include <libman/library.hpp>
 
+#include <functional>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -65,20 +68,39 @@ public:
     fs::path calc_executable_path(const build_env& env) const noexcept;
 
     /**
-     * Perform the link of the executable
+     * Collect the linker inputs of the executable: The object file of the entry point, the archive
+     * of the owning library (if it has one), and the linkable paths of every library that the
+     * executable links with.
      * @param env The build environment to use.
-     * @param lib The library that owns this executable. If it defines an archive library, it will
-     * be added as a linker input.
+     * @param lib The library that owns this executable.
      */
-    void link(const build_env& env, const library_plan& lib) const;
+    std::vector<fs::path> calc_link_inputs(const build_env& env, const library_plan& lib) const;
+
     /**
-     * Run the executable as a test. If the test fails, then that failure information will be
-     * returned.
+     * Start the link of the executable
+     * @param env The build environment to use.
+     * @param lib The library that owns this executable. If it defines an archive library, it will
+     * be added as a linker input.
+     * @param history The dependency information from prior builds. If the executable is
+     * up-to-date, the linker will not be executed, and `done` is invoked immediately.
+     * @param on_linked Invoked from the finishing function with the dependency information of the
+     * newly linked executable.
+     * @param done Invoked once the linker has exited, with a function that checks the result and
+     * throws if the link failed.
      */
-    std::optional<test_failure> run_test(build_env_ref) const;
+    void link(const build_env&                    env,
+              const library_plan&                 lib,
+              const compilation_history&          history,
+              std::function<void(file_deps_info)> on_linked,
+              job_graph::async_done               done) const;
 
     bool is_test() const noexcept;
     bool is_app() const noexcept;
+
+    /**
+     * Whether the executable is a test that uses the Catch2 `main()` function that dds provides
+     */
+    bool uses_catch2_main() const noexcept;
 };
 
 }  // namespace dds
\ No newline at end of file
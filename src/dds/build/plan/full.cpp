@@ -3,8 +3,10 @@
 #include <dds/build/iter_compilations.hpp>
 #include <dds/build/plan/compile_exec.hpp>
 #include <dds/error/errors.hpp>
+#include <dds/util/job_graph.hpp>
 #include <dds/util/log.hpp>
 #include <dds/util/parallel.hpp>
+#include <dds/util/signal.hpp>
 
 #include <range/v3/algorithm/any_of.hpp>
 #include <range/v3/range/conversion.hpp>
@@ -15,19 +17,111 @@
 #include <range/v3/view/transform.hpp>
 #include <range/v3/view/zip.hpp>
 
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <thread>
+#include <unordered_set>
 
 using namespace dds;
 
 namespace {
 
+// We do not (yet) record the durations of these steps, so use rough guesses. These only affect the
+// order in which ready jobs are started: Links and tests sit at the ends of the longest chains of
+// jobs, so the compilations that lead to them should not be left until last.
+constexpr auto est_archive_duration = std::chrono::milliseconds(200);
+constexpr auto est_link_duration    = std::chrono::milliseconds(1000);
+constexpr auto est_test_duration    = std::chrono::milliseconds(1000);
+
+// Catch2 tests are only split into shards that are expected to take at least this long
+constexpr auto min_test_shard_duration = std::chrono::seconds(1);
+
 template <typename T, typename Range>
 decltype(auto) pair_up(T& left, Range& right) {
     auto rep = ranges::views::repeat(left);
     return ranges::views::zip(rep, right);
 }
 
+std::string canonical_key(path_ref p) { return fs::weakly_canonical(p).generic_string(); }
+
+/// Whether the entry point of the given executable uses the header that is shared by all tests
+bool uses_test_pch(const link_executable_plan& exe) {
+    return exe.is_test() && exe.main_compile_file().rules().pch_header().has_value();
+}
+
+/**
+ * Handle a failure to precompile the header that is shared by all tests. This is not an error: The
+ * tests include the plain header instead, once the unusable output is removed.
+ */
+void discard_test_pch(const compile_file_plan& pch, build_env_ref env) {
+    dds_log(warn, "Failed to precompile the header for tests. Tests will be compiled without it.");
+    std::error_code ec;
+    fs::remove(pch.calc_object_file_path(env), ec);
+}
+
+/**
+ * Find the outputs of the given libraries that may be affected by changes to the given files. These
+ * are the outputs that depend upon the files according to the dependency information of prior
+ * builds, the outputs that have never been built (which may depend upon anything), and every output
+ * that is built from an affected output.
+ */
+template <typename Libraries>
+std::unordered_set<std::string> find_affected(build_env_ref                env,
+                                              const compilation_history&   history,
+                                              Libraries&&                  libraries,
+                                              const std::vector<fs::path>& changed) {
+    auto affected = history.outputs_affected_by(changed);
+
+    // The recorded information does not know about sources that were added since the last build,
+    // so also follow the outputs through the current plan
+    std::unordered_set<std::string> changed_keys;
+    for (auto& file : changed) {
+        changed_keys.insert(file.generic_string());
+    }
+    auto check_output = [&](path_ref output, bool any_input_affected) {
+        auto key = canonical_key(output);
+        if (any_input_affected || !history.contains(output)) {
+            affected.insert(key);
+        }
+        return affected.contains(key);
+    };
+    auto check_compile = [&](const compile_file_plan& cf, bool pch_affected = false) {
+        bool any_changed = pch_affected || changed_keys.contains(canonical_key(cf.source_path()));
+        for (auto& member : cf.unity_members()) {
+            any_changed = any_changed || changed_keys.contains(canonical_key(member.path));
+        }
+        return check_output(cf.calc_object_file_path(env), any_changed);
+    };
+
+    // Executables may link the archives of any library, so visit every archive first
+    for (const library_plan& lib : libraries) {
+        if (auto& arc = lib.archive_plan()) {
+            bool pch_affected = arc->pch_compilation() && check_compile(*arc->pch_compilation());
+            bool any_obj      = pch_affected;
+            for (auto& cf : arc->file_compilations()) {
+                any_obj = check_compile(cf, pch_affected) || any_obj;
+            }
+            check_output(env.output_root / arc->calc_archive_file_path(env.toolchain), any_obj);
+        }
+    }
+    for (const library_plan& lib : libraries) {
+        for (auto& exe : lib.executables()) {
+            bool any_input = check_compile(exe.main_compile_file());
+            for (auto& input : exe.calc_link_inputs(env, lib)) {
+                any_input = any_input || affected.contains(canonical_key(input));
+            }
+            check_output(exe.calc_executable_path(env), any_input);
+        }
+    }
+    return affected;
+}
+
 }  // namespace
 
 void build_plan::render_all(build_env_ref env) const {
@@ -42,11 +136,43 @@ void build_plan::render_all(build_env_ref env) const {
     }
 }
 
-void build_plan::compile_all(const build_env& env, int njobs) const {
-    auto okay = dds::compile_all(iter_compilations(*this), env, njobs);
-    if (!okay) {
-        throw_user_error<errc::compile_failure>();
+namespace {
+
+/// Every file compilation in the plan, including those that create precompiled headers
+std::vector<const compile_file_plan*> all_compilations(const build_plan& plan) {
+    std::vector<const compile_file_plan*> ret;
+    for (auto& cf : iter_compilations(plan)) {
+        ret.push_back(&cf);
+    }
+    for (auto& lib : iter_libraries(plan)) {
+        if (lib.archive_plan() && lib.archive_plan()->pch_compilation()) {
+            ret.push_back(&*lib.archive_plan()->pch_compilation());
+        }
     }
+    if (plan.test_pch_compilation()) {
+        ret.push_back(&*plan.test_pch_compilation());
+    }
+    return ret;
+}
+
+}  // namespace
+
+void build_plan::memoize(const build_env& env) const {
+    auto compiles = all_compilations(*this);
+    // Many files share the same rules, so resolve those first, and only once each
+    for (auto cf : compiles) {
+        cf->rules().memoize(env);
+    }
+    // Resolving the object paths touches the filesystem, but only reads the shared rules
+    parallel_run(compiles, 0, [&](const compile_file_plan* cf) { cf->memoize(env); });
+}
+
+std::size_t build_plan::memory_usage() const {
+    std::size_t ret = 0;
+    for (auto cf : all_compilations(*this)) {
+        ret += cf->memory_usage();
+    }
+    return ret;
 }
 
 void build_plan::compile_files(const build_env&             env,
@@ -74,8 +200,22 @@ void build_plan::compile_files(const build_env&             env,
         });
     };
 
-    auto comps
-        = iter_compilations(*this) | ranges::views::filter(check_compilation) | ranges::to_vector;
+    // The members of a unity batch are compiled on their own, so that each requested file is
+    // checked by itself
+    std::vector<compile_file_plan> comps;
+    for (const compile_file_plan& comp : iter_compilations(*this)) {
+        if (!comp.is_unity()) {
+            if (check_compilation(comp)) {
+                comps.push_back(comp);
+            }
+            continue;
+        }
+        for (auto& member : comp.unity_member_plans()) {
+            if (check_compilation(member)) {
+                comps.push_back(member);
+            }
+        }
+    }
 
     bool any_unmarked = false;
     auto unmarked     = ranges::views::filter(as_pending, ranges::not_fn(&pending_file::marked));
@@ -89,62 +229,340 @@ void build_plan::compile_files(const build_env&             env,
             "One or more requested files is not part of this project (See above)");
     }
 
-    auto okay = dds::compile_all(comps, env, njobs);
+    // The precompiled headers used by the requested files must be compiled first
+    auto is_requested = [&](const source_file& sf) {
+        return ranges::any_of(as_pending, [&](const pending_file& f) {
+            return f.filepath == fs::weakly_canonical(sf.path);
+        });
+    };
+    auto any_requested = [&](const compile_file_plan& cf) {
+        return is_requested(cf.source()) || ranges::any_of(cf.unity_members(), is_requested);
+    };
+    ref_vector<const compile_file_plan> pchs;
+    bool                                test_pch_requested = false;
+    for (const library_plan& lib : iter_libraries(*this)) {
+        for (auto& exe : lib.executables()) {
+            test_pch_requested = test_pch_requested
+                || (_test_pch && uses_test_pch(exe) && any_requested(exe.main_compile_file()));
+        }
+        auto& arc = lib.archive_plan();
+        if (!arc || !arc->pch_compilation()) {
+            continue;
+        }
+        if (ranges::any_of(arc->file_compilations(), any_requested)) {
+            pchs.push_back(*arc->pch_compilation());
+        }
+    }
+    if (test_pch_requested
+        && !dds::compile_all(ref_vector<const compile_file_plan>{*_test_pch}, env, njobs)) {
+        discard_test_pch(*_test_pch, env);
+    }
+
+    auto okay = (pchs.empty() || dds::compile_all(pchs, env, njobs))
+        && dds::compile_all(comps, env, njobs);
     if (!okay) {
         throw_user_error<errc::compile_failure>();
     }
 }
 
-void build_plan::archive_all(const build_env& env, int njobs) const {
-    auto okay = parallel_run(iter_libraries(*this), njobs, [&](const library_plan& lib) {
+std::vector<test_failure>
+build_plan::build_all(build_env_ref env, int njobs, const test_options& tests) const {
+    // Collect every file compilation in the plan. The order here is significant: The header that
+    // is shared by tests comes first, if any test uses it. Then each library's precompiled header
+    // and own compilations are followed by the compilations of the entry points of its
+    // executables, and the loop below that creates the jobs for archives and executables relies on
+    // this order.
+    // Packages that were restored from the prebuilt dependency cache need no work
+    auto built_libraries = _packages                                             //
+        | ranges::views::filter([](auto& pkg) { return !pkg.is_prebuilt(); })  //
+        | ranges::views::transform(&package_plan::libraries)                   //
+        | ranges::views::join;
+
+    ref_vector<const compile_file_plan> compiles;
+    bool                                build_test_pch = false;
+    for (const library_plan& lib : built_libraries) {
+        build_test_pch = build_test_pch
+            || (_test_pch && ranges::any_of(lib.executables(), uses_test_pch));
+    }
+    if (build_test_pch) {
+        compiles.push_back(*_test_pch);
+    }
+    for (const library_plan& lib : built_libraries) {
         if (lib.archive_plan()) {
-            lib.archive_plan()->archive(env);
+            if (auto& pch = lib.archive_plan()->pch_compilation()) {
+                compiles.push_back(*pch);
+            }
+            for (auto& cf : lib.archive_plan()->file_compilations()) {
+                compiles.push_back(cf);
+            }
+        }
+        for (auto& exe : lib.executables()) {
+            compiles.push_back(exe.main_compile_file());
+        }
+    }
+
+    // Record the kind of step that fails, so that we can report the appropriate error
+    std::atomic_bool compile_failed{false};
+    std::atomic_bool archive_failed{false};
+    std::atomic_bool link_failed{false};
+    auto             flag_failure = [](std::atomic_bool& flag, auto start) {
+        auto flag_if_throws = [&flag](std::function<void()> fn) {
+            return [&flag, fn] {
+                try {
+                    fn();
+                } catch (...) {
+                    flag = true;
+                    throw;
+                }
+            };
+        };
+        // The step may fail either while starting, or while finishing
+        return [flag_if_throws, start](job_graph::async_done done) {
+            flag_if_throws([&] {
+                start([flag_if_throws, done](std::function<void()> finish) {
+                    done(flag_if_throws(std::move(finish)));
+                });
+            })();
+        };
+    };
+
+    // Load all prior dependency information at once, for compilations, archives, and links alike
+    compilation_history history{env.deps, env.stats};
+    job_graph           graph;
+    compile_batch       batch{compiles, env, history};
+
+    // Collect the dependency information of the archives and executables that are created
+    std::mutex                  deps_mut;
+    std::vector<file_deps_info> new_deps;
+    auto                        record_deps = [&](file_deps_info info) {
+        std::scoped_lock lk{deps_mut};
+        new_deps.push_back(std::move(info));
+    };
+
+    // Failing to precompile the header that is shared by tests does not fail the build
+    auto tolerate_test_pch_failure = [&](auto start) {
+        return [&, start](job_graph::async_done done) {
+            start([&, done](std::function<void()> finish) {
+                done([&, finish] {
+                    try {
+                        finish();
+                    } catch (const user_error<errc::compile_failure>&) {
+                        discard_test_pch(*_test_pch, env);
+                    }
+                });
+            });
+        };
+    };
+
+    std::vector<job_graph::job_id> compile_jobs;
+    for (std::size_t n = 0; n < batch.size(); ++n) {
+        std::function<void(job_graph::async_done)> compile
+            = [&batch, n](auto done) { batch.compile(n, done); };
+        if (n == 0 && build_test_pch) {
+            compile = tolerate_test_pch_failure(compile);
+        } else {
+            compile = flag_failure(compile_failed, compile);
+        }
+        compile_jobs.push_back(graph.add_async_job(compile, batch.estimated_duration(n)));
+    }
+    // A file that imports a C++ module cannot be compiled before the module's interface
+    for (std::size_t n = 0; n < batch.size(); ++n) {
+        for (auto provider : batch.module_providers(n)) {
+            graph.add_dependency(compile_jobs[n], compile_jobs[provider]);
         }
-    });
-    if (!okay) {
-        throw_external_error<errc::archive_failure>();
     }
-}
 
-void build_plan::link_all(const build_env& env, int njobs) const {
-    // Generate a pairing between executables and the libraries that own them
-    std::vector<std::pair<std::reference_wrapper<const library_plan>,
-                          std::reference_wrapper<const link_executable_plan>>>
-        executables;
-    for (auto&& lib : iter_libraries(*this)) {
-        for (auto&& exe : lib.executables()) {
-            executables.emplace_back(lib, exe);
+    // Map the path of each archive that we generate to the job that generates it, so that links
+    // can depend on exactly the archives that they use.
+    std::map<fs::path, job_graph::job_id> archive_jobs;
+
+    struct pending_exe {
+        const library_plan&         lib;
+        const link_executable_plan& exe;
+        job_graph::job_id           main_compile;
+    };
+    std::vector<pending_exe> exes;
+
+    auto compile_job_iter = compile_jobs.cbegin() + (build_test_pch ? 1 : 0);
+    for (const library_plan& lib : built_libraries) {
+        if (auto& arc = lib.archive_plan()) {
+            auto ar_job = graph.add_async_job(
+                flag_failure(archive_failed,
+                             [&](auto done) { arc->archive(env, history, record_deps, done); }),
+                est_archive_duration);
+            // The library's files cannot be compiled until its precompiled header is ready
+            std::optional<job_graph::job_id> pch_job;
+            if (arc->pch_compilation()) {
+                pch_job = *compile_job_iter++;
+                graph.add_dependency(ar_job, *pch_job);
+            }
+            for (auto n = arc->file_compilations().size(); n; --n) {
+                if (pch_job) {
+                    graph.add_dependency(*compile_job_iter, *pch_job);
+                }
+                graph.add_dependency(ar_job, *compile_job_iter++);
+            }
+            archive_jobs.emplace(env.output_root / arc->calc_archive_file_path(env.toolchain),
+                                 ar_job);
+        }
+        for (auto& exe : lib.executables()) {
+            // Tests that use the shared header cannot be compiled until it is ready
+            if (build_test_pch && uses_test_pch(exe)) {
+                graph.add_dependency(*compile_job_iter, compile_jobs.front());
+            }
+            exes.push_back({lib, exe, *compile_job_iter++});
         }
     }
+    assert(compile_job_iter == compile_jobs.cend());
+
+    std::mutex                             mut;
+    std::vector<test_failure>              test_failures;
+    std::vector<std::unique_ptr<test_run>> test_runs;
+
+    // Tests that passed in a prior build are not run again unless their executable changes
+    std::map<std::string, recorded_test_pass> prior_passes;
+    if (!tests.rerun) {
+        for (auto& pass : env.db.all_test_passes()) {
+            auto key = pass.exe_path.generic_string();
+            prior_passes.emplace(std::move(key), std::move(pass));
+        }
+    }
+    auto find_prior_pass = [&](path_ref exe) -> std::optional<recorded_test_pass> {
+        auto found = prior_passes.find(canonical_key(exe));
+        if (found == prior_passes.end()) {
+            return std::nullopt;
+        }
+        return found->second;
+    };
+
+    // Split Catch2 tests into at most as many shards as can run at once
+    auto max_shards   = static_cast<std::size_t>(calc_n_jobs(njobs));
+    auto sharding_for = [&](const link_executable_plan& exe, path_ref exe_path) {
+        if (!exe.uses_catch2_main()) {
+            return test_sharding{};
+        }
+        return test_sharding{env.db.test_case_durations_of(exe_path),
+                             max_shards,
+                             min_test_shard_duration};
+    };
+
+    // If only the tests that are affected by some changes are wanted, select them using the
+    // dependency information of the prior build
+    std::optional<std::unordered_set<std::string>> affected;
+    if (tests.changed_files) {
+        affected = find_affected(env, history, built_libraries, *tests.changed_files);
+    }
+    int n_tests    = 0;
+    int n_selected = 0;
+
+    for (const pending_exe& pending : exes) {
+        auto link_job = graph.add_async_job(
+            flag_failure(link_failed,
+                         [&](auto done) {
+                             pending.exe.link(env, pending.lib, history, record_deps, done);
+                         }),
+            est_link_duration);
+        graph.add_dependency(link_job, pending.main_compile);
+        for (auto& input : pending.exe.calc_link_inputs(env, pending.lib)) {
+            auto found = archive_jobs.find(input);
+            if (found != archive_jobs.end()) {
+                graph.add_dependency(link_job, found->second);
+            }
+        }
+
+        if (pending.exe.is_test()) {
+            ++n_tests;
+            auto exe_path = pending.exe.calc_executable_path(env);
+            if (affected && !affected->contains(canonical_key(exe_path))) {
+                dds_log(debug,
+                        "Skip test {}: Not affected by the changed files",
+                        exe_path.string());
+                continue;
+            }
+            ++n_selected;
+            auto sharding     = sharding_for(pending.exe, exe_path);
+            auto est_duration = sharding.estimated_duration().count()
+                ? std::chrono::duration_cast<job_graph::duration>(sharding.estimated_duration())
+                : est_test_duration;
+            // The library may give the test a timeout of its own
+            auto  test_opts = tests;
+            auto& timeouts  = pending.lib.library_().manifest().test_timeouts;
+            auto  timeout   = timeouts.find(
+                pending.exe.main_compile_file().source().relative_path().generic_string());
+            if (timeout != timeouts.end()) {
+                test_opts.timeout = timeout->second;
+            }
+            auto& run = *test_runs.emplace_back(
+                std::make_unique<test_run>(env,
+                                           exe_path,
+                                           test_opts,
+                                           find_prior_pass(exe_path),
+                                           pending.exe.uses_catch2_main(),
+                                           std::move(sharding)));
+            // Check for a prior pass and list the test cases once, before any shard starts
+            auto prepare_job
+                = graph.add_async_job([&run](job_graph::async_done done) { run.prepare(done); });
+            graph.add_dependency(prepare_job, link_job);
+            for (std::size_t shard = 0; shard < run.n_shards(); ++shard) {
+                auto run_shard = [&, shard](job_graph::async_done done) {
+                    run.run_shard(shard, [&, done](auto get_result) {
+                        done([&, get_result] {
+                            auto fail_info = get_result();
+                            if (fail_info) {
+                                std::scoped_lock lk{mut};
+                                test_failures.emplace_back(std::move(*fail_info));
+                            }
+                        });
+                    });
+                };
+                auto test_job = graph.add_async_job(run_shard, est_duration);
+                graph.add_dependency(test_job, prepare_job);
+            }
+        }
+    }
+
+    if (affected) {
+        dds_log(info,
+                "Running {} of {} tests that may be affected by the changes",
+                n_selected,
+                n_tests);
+    }
+    dds_log(debug,
+            "Executing build graph of {} jobs ({} compilations, {} archives, {} executables)",
+            graph.size(),
+            compile_jobs.size(),
+            archive_jobs.size(),
+            exes.size());
+    auto okay = graph.run(njobs);
+
+    // Store dependency information for the compilations that succeeded, even if others failed
+    batch.commit_deps();
+    env.deps.record(new_deps);
+    {
+        auto tr = env.db.transaction();
+        for (auto& run : test_runs) {
+            if (auto pass = run->new_pass()) {
+                env.db.record_test_pass(*pass);
+            }
+            auto durations = run->case_durations();
+            if (!durations.empty()) {
+                env.db.record_test_case_durations(run->exe_path(), durations);
+            }
+        }
+        for (auto& fail : test_failures) {
+            env.db.forget_test_result(fail.executable_path);
+        }
+    }
+    cancellation_point();
 
-    auto okay = parallel_run(executables, njobs, [&](const auto& pair) {
-        auto&& [lib, exe] = pair;
-        exe.get().link(env, lib);
-    });
     if (!okay) {
+        if (compile_failed) {
+            throw_user_error<errc::compile_failure>();
+        }
+        if (archive_failed) {
+            throw_external_error<errc::archive_failure>();
+        }
         throw_user_error<errc::link_failure>();
     }
-}
-
-std::vector<test_failure> build_plan::run_all_tests(build_env_ref env, int njobs) const {
-    using namespace ranges::views;
-    // Collect executables that are tests
-    auto test_executables =                       //
-        iter_libraries(*this)                     //
-        | transform(&library_plan::executables)   //
-        | join                                    //
-        | filter(&link_executable_plan::is_test)  //
-        ;
-
-    std::mutex                mut;
-    std::vector<test_failure> fails;
-
-    parallel_run(test_executables, njobs, [&](const auto& exe) {
-        auto fail_info = exe.run_test(env);
-        if (fail_info) {
-            std::scoped_lock lk{mut};
-            fails.emplace_back(std::move(*fail_info));
-        }
-    });
-    return fails;
+    return test_failures;
 }
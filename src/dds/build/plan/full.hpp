@@ -2,6 +2,10 @@
 
 #include <dds/build/plan/exe.hpp>
 #include <dds/build/plan/package.hpp>
+#include <dds/build/plan/test_run.hpp>
+
+#include <cstddef>
+#include <optional>
 
 namespace dds {
 
@@ -14,6 +18,8 @@ namespace dds {
 class build_plan {
     /// The packages that are part of this plan.
     std::vector<package_plan> _packages;
+    /// The precompilation of the header that is shared by the tests of every library, if any
+    std::optional<compile_file_plan> _test_pch;
 
 public:
     /**
@@ -28,32 +34,57 @@ public:
      * All of the packages in this plan
      */
     auto& packages() const noexcept { return _packages; }
+
     /**
-     * Render all config templates in the plan.
+     * Set the precompilation of a header that is used by the tests of every library, such as the
+     * header of a test framework. The test executables whose entry points name the header as their
+     * `pch_header()` are compiled after it. If the header fails to precompile, a warning is
+     * issued, and those tests include the plain header instead.
      */
-    void render_all(const build_env& env) const;
+    void set_test_pch_compilation(compile_file_plan pch) noexcept { _test_pch = std::move(pch); }
     /**
-     * Compile all files in the plan.
+     * Get the precompilation of the header that is used by the tests of every library, if any
      */
-    void compile_all(const build_env& env, int njobs) const;
+    auto& test_pch_compilation() const noexcept { return _test_pch; }
     /**
-     * Generate all static library archive in the plan
+     * Render all config templates in the plan.
      */
-    void archive_all(const build_env& env, int njobs) const;
+    void render_all(const build_env& env) const;
     /**
-     * Link all runtime binaries (executables) in the plan
+     * Compile all files, generate all static library archives, link all runtime binaries, and
+     * execute all tests in the plan.
+     *
+     * Rather than executing each of these as a separate phase, the plan is executed as a single
+     * dependency graph: An archive is created as soon as its own object files have been compiled,
+     * an executable is linked as soon as its object file and linker inputs are available, and a
+     * test is executed as soon as it has been linked.
+     *
+     * A test that passed in a prior build is not executed again if its executable is unchanged,
+     * unless `tests.rerun` is `true`. If `tests.changed_files` is set, the dependency information
+     * of prior builds is used to find the tests that may be affected by those files, and only
+     * those are executed. Tests that use the Catch2 driver of dds may be split into several shards
+     * that run in parallel, based on the durations of their test cases in the prior run.
+     *
+     * Returns information for every failed test.
      */
-    void link_all(const build_env& env, int njobs) const;
-
+    std::vector<test_failure>
+    build_all(const build_env& env, int njobs, const test_options& tests) const;
     /**
      * Compile the files given in the vector of file paths.
      */
     void compile_files(const build_env& env, int njobs, const std::vector<fs::path>& paths) const;
-
     /**
-     * Execute all tests defined in the plan. Returns information for every failed test.
+     * Resolve the object file paths and the compile rules of every file compilation in the plan
+     * for the given environment, so that they are not computed again each time they are used.
+     * This must be called before the plan is used from multiple threads, and the plan must not be
+     * modified afterwards.
+     */
+    void memoize(const build_env& env) const;
+    /**
+     * The approximate number of bytes of memory that are used by the file compilations in this
+     * plan
      */
-    std::vector<test_failure> run_all_tests(build_env_ref env, int njobs) const;
+    std::size_t memory_usage() const;
 };
 
 }  // namespace dds
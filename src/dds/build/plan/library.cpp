@@ -1,5 +1,7 @@
 #include "./library.hpp"
 
+#include <dds/build/module_deps.hpp>
+#include <dds/error/errors.hpp>
 #include <dds/util/algo.hpp>
 #include <dds/util/log.hpp>
 
@@ -8,8 +10,13 @@
 #include <range/v3/view/filter.hpp>
 #include <range/v3/view/transform.hpp>
 
+#include <fmt/core.h>
+
+#include <algorithm>
 #include <cassert>
+#include <map>
 #include <string>
+#include <utility>
 
 using namespace dds;
 
@@ -18,6 +25,49 @@ namespace {
 const std::string gen_dir_qual = "__dds/gen";
 
 fs::path rebase_gen_incdir(path_ref subdir) { return gen_dir_qual / subdir; }
+
+/**
+ * Create the plans that compile the given source files in unity batches of up to `batch_size`
+ * files. Each batch holds the files of a single language from a single directory, in path order,
+ * so adding or removing a file only changes the batches of its own directory. A file that would
+ * be alone in its batch is compiled on its own, as is a file that appears to be a C++ module unit.
+ */
+std::vector<compile_file_plan> unity_batches(const shared_compile_file_rules& rules,
+                                             const std::vector<source_file>&  sources,
+                                             std::string_view                 qual_name,
+                                             path_ref                         subdir,
+                                             std::size_t                      batch_size) {
+    // Group by parent directory, and by whether the file is C rather than C++
+    std::map<std::pair<fs::path, bool>, std::vector<source_file>> groups;
+    std::vector<compile_file_plan>                                ret;
+    for (const auto& sf : sources) {
+        // A module unit must be a translation unit of its own
+        if (file_may_use_modules(sf.path)) {
+            ret.emplace_back(rules, sf, qual_name, subdir);
+            continue;
+        }
+        auto ext = sf.path.extension();
+        groups[{sf.relative_path().parent_path(), ext == ".c" || ext == ".C"}].push_back(sf);
+    }
+
+    for (auto& [key, members] : groups) {
+        const bool is_c = key.second;
+        std::sort(members.begin(), members.end(), [](auto& a, auto& b) { return a.path < b.path; });
+        for (std::size_t first = 0; first < members.size(); first += batch_size) {
+            auto last = std::min(first + batch_size, members.size());
+            if (last - first == 1) {
+                ret.emplace_back(rules, members[first], qual_name, subdir);
+                continue;
+            }
+            std::vector<source_file> batch(members.begin() + first, members.begin() + last);
+            auto name = fmt::format("dds-unity-{}{}", first / batch_size, is_c ? ".c" : ".cpp");
+            ret.push_back(
+                compile_file_plan::unity_batch(rules, std::move(batch), qual_name, subdir, name));
+        }
+    }
+    return ret;
+}
+
 }  // namespace
 
 std::optional<fs::path> library_plan::generated_include_dir() const noexcept {
@@ -27,6 +77,10 @@ std::optional<fs::path> library_plan::generated_include_dir() const noexcept {
     return rebase_gen_incdir(output_subdirectory());
 }
 
+fs::path library_plan::generated_include_root(path_ref out_subdir) noexcept {
+    return rebase_gen_incdir(out_subdir);
+}
+
 library_plan library_plan::create(const library_root&             lib,
                                   const library_build_params&     params,
                                   std::optional<std::string_view> qual_name_) {
@@ -39,24 +93,24 @@ library_plan library_plan::create(const library_root&             lib,
     auto qual_name = std::string(qual_name_.value_or(lib.manifest().name.str));
 
     // Collect the source for this library. This will look for any compilable sources in the
-    // `src/` subdirectory of the library.
+    // `src/` subdirectory of the library, which were found when the library was loaded.
     auto src_dir = lib.src_source_root();
-    if (src_dir.exists()) {
-        // Sort each source file between the three source arrays, depending on
-        // the kind of source that we are looking at.
-        auto all_sources = src_dir.collect_sources();
-        for (const auto& sfile : all_sources) {
-            if (sfile.kind == source_kind::test) {
-                test_sources.push_back(sfile);
-            } else if (sfile.kind == source_kind::app) {
-                app_sources.push_back(sfile);
-            } else if (sfile.kind == source_kind::source) {
-                lib_sources.push_back(sfile);
-            } else if (sfile.kind == source_kind::header_template) {
-                template_sources.push_back(sfile);
-            } else {
-                assert(sfile.kind == source_kind::header);
-            }
+    // Sort each source file between the three source arrays, depending on
+    // the kind of source that we are looking at.
+    for (const auto& sfile : lib.all_sources()) {
+        if (sfile.basis_path != src_dir.path) {
+            continue;
+        }
+        if (sfile.kind == source_kind::test) {
+            test_sources.push_back(sfile);
+        } else if (sfile.kind == source_kind::app) {
+            app_sources.push_back(sfile);
+        } else if (sfile.kind == source_kind::source) {
+            lib_sources.push_back(sfile);
+        } else if (sfile.kind == source_kind::header_template) {
+            template_sources.push_back(sfile);
+        } else {
+            assert(sfile.kind == source_kind::header);
         }
     }
 
@@ -71,13 +125,42 @@ library_plan library_plan::create(const library_root&             lib,
         compile_rules.include_dirs().push_back(codegen_subdir);
     }
 
+    // The library's own source files may use a precompiled header. Apps and tests do not use it,
+    // since they may be compiled with different rules.
+    auto                             lib_rules = compile_rules;
+    std::optional<compile_file_plan> pch_compile;
+    if (lib.manifest().pch && !lib_sources.empty()) {
+        auto header = source_file::from_path(lib.path() / *lib.manifest().pch, lib.path());
+        if (!header || header->kind != source_kind::header || !fs::is_regular_file(header->path)) {
+            throw_user_error<errc::invalid_lib_manifest>(
+                "The 'pch' of library '{}' must name a header file in the library directory "
+                "(Given '{}')",
+                qual_name,
+                lib.manifest().pch->string());
+        }
+        const auto pch_subdir  = params.out_subdir / "pch";
+        lib_rules              = compile_rules.clone();
+        lib_rules.pch_header() = compile_file_plan::pch_header_path(pch_subdir, *header);
+        pch_compile
+            = compile_file_plan::precompile_header(lib_rules, *header, qual_name, pch_subdir);
+    }
+
     // Convert the library sources into their respective file compilation plans.
-    auto lib_compile_files =  //
-        lib_sources           //
-        | ranges::views::transform([&](const source_file& sf) {
-              return compile_file_plan(compile_rules, sf, qual_name, params.out_subdir / "obj");
-          })
-        | ranges::to_vector;
+    std::vector<compile_file_plan> lib_compile_files;
+    if (params.unity_batch_size > 1) {
+        lib_compile_files = unity_batches(lib_rules,
+                                          lib_sources,
+                                          qual_name,
+                                          params.out_subdir / "obj",
+                                          std::size_t(params.unity_batch_size));
+    } else {
+        lib_compile_files =  //
+            lib_sources      //
+            | ranges::views::transform([&](const source_file& sf) {
+                  return compile_file_plan(lib_rules, sf, qual_name, params.out_subdir / "obj");
+              })
+            | ranges::to_vector;
+    }
 
     // If we have any compiled library files, generate a static library archive
     // for this library
@@ -87,7 +170,8 @@ library_plan library_plan::create(const library_root&             lib,
         archive_plan.emplace(lib.manifest().name.str,
                              qual_name,
                              params.out_subdir,
-                             std::move(lib_compile_files));
+                             std::move(lib_compile_files),
+                             std::move(pch_compile));
     } else {
         dds_log(debug,
                 "Library {} has no compiled inputs, so no archive will be generated",
@@ -104,6 +188,7 @@ library_plan library_plan::create(const library_root&             lib,
     auto test_rules = compile_rules.clone();
     auto test_links = links;
     extend(test_rules.uses(), params.test_uses);
+    test_rules.pch_header() = params.test_pch_header;
     extend(test_links, params.test_uses);
 
     // Generate the plans to link any executables for this library
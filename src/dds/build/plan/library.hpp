@@ -33,6 +33,13 @@ struct library_build_params {
 
     /// Libraries that are used by tests
     std::vector<lm::usage> test_uses;
+
+    /// A header whose precompiled form is included by every test, relative to the build root
+    std::optional<fs::path> test_pch_header;
+
+    /// If greater than one, the library's source files are compiled together in unity batches of
+    /// up to this many files
+    int unity_batch_size = 0;
 };
 
 /**
@@ -132,6 +139,12 @@ public:
      */
     std::optional<fs::path> generated_include_dir() const noexcept;
 
+    /**
+     * The directory, relative to the build root, in which the headers are generated for libraries
+     * that are built in the given output subdirectory.
+     */
+    static fs::path generated_include_root(path_ref out_subdir) noexcept;
+
     /**
      * Named constructor: Create a new `library_plan` automatically from some build-time parameters.
      *
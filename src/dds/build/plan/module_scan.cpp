@@ -0,0 +1,216 @@
+#include "./module_scan.hpp"
+
+#include <dds/build/module_deps.hpp>
+#include <dds/error/errors.hpp>
+#include <dds/proc.hpp>
+#include <dds/util/log.hpp>
+#include <dds/util/parallel.hpp>
+#include <dds/util/string.hpp>
+#include <dds/util/time.hpp>
+
+#include <fansi/styled.hpp>
+#include <range/v3/view/iota.hpp>
+
+#include <algorithm>
+#include <exception>
+#include <map>
+#include <mutex>
+
+using namespace dds;
+using namespace fansi::literals;
+
+namespace {
+
+/**
+ * Obtain the module dependencies of a single compilation. A prior scan is reused if none of its
+ * inputs have changed. Otherwise, the file is scanned if it appears to use modules.
+ *
+ * @param plan The compilation to scan
+ * @param env The build environment
+ * @param history The dependency information of prior builds
+ * @param record_deps Called with the dependency information of a scan that is executed
+ * @returns The module dependencies, or `nullopt` if the file does not use modules
+ */
+template <typename RecordFn>
+std::optional<module_deps_info> scan_one(const compile_file_plan&   plan,
+                                         build_env_ref              env,
+                                         const compilation_history& history,
+                                         RecordFn&&                 record_deps) {
+    auto cmd      = plan.generate_scan_command(env);
+    auto ddi      = plan.calc_module_deps_path(env);
+    auto scan_out = fs::path(ddi.string() + ".i");
+    auto quoted   = quote_command(cmd.command);
+
+    auto prior = history.get(scan_out);
+    if (prior && prior->newer_inputs.empty() && prior->previous_command.quoted_command == quoted
+        && fs::exists(ddi)) {
+        dds_log(trace, "Module scan of {} is up-to-date", plan.source_path().string());
+        return parse_p1689_file(ddi);
+    }
+
+    if (!file_may_use_modules(plan.source_path())) {
+        return std::nullopt;
+    }
+
+    dds_log(debug, "Scan module dependencies of {}", plan.source_path().string());
+    fs::create_directories(ddi.parent_path());
+    stopwatch timer;
+    auto      res = run_proc(proc_options{.command = cmd.command});
+    if (!res.okay()) {
+        dds_log(error, "Module scan failed: .bold.cyan[{}]"_styled, plan.source_path().string());
+        dds_log(error,
+                "Subcommand .bold.red[FAILED] [Exited {}]: .bold.yellow[{}]\n{}"_styled,
+                res.retc,
+                quoted,
+                res.output);
+        throw_user_error<errc::compile_failure>("Scanning for module dependencies failed [{}]",
+                                                plan.source_path().string());
+    }
+
+    if (cmd.gnu_depfile_path && fs::is_regular_file(*cmd.gnu_depfile_path)) {
+        auto dep_info    = parse_mkfile_deps_file(*cmd.gnu_depfile_path);
+        dep_info.output  = scan_out;
+        dep_info.command = {quoted, res.output, timer.elapsed_ms()};
+        record_deps(std::move(dep_info));
+    }
+    return parse_p1689_file(ddi);
+}
+
+/**
+ * Throw if the modules of the graph import each other in a cycle, since no order of compilation
+ * could satisfy them.
+ */
+void check_cycles(const ref_vector<const compile_file_plan>& compiles, const module_graph& graph) {
+    enum class mark { none, visiting, done };
+    std::vector<mark> marks(graph.units.size(), mark::none);
+
+    auto visit = [&](auto& self, std::size_t n) -> void {
+        if (marks[n] == mark::done) {
+            return;
+        }
+        if (marks[n] == mark::visiting) {
+            throw_user_error<errc::compile_failure>(
+                "C++ modules import each other in a cycle, which includes [{}]",
+                compiles[n].get().source_path().string());
+        }
+        marks[n] = mark::visiting;
+        for (auto p : graph.units[n].providers) {
+            self(self, p);
+        }
+        marks[n] = mark::done;
+    };
+    for (std::size_t n = 0; n < graph.units.size(); ++n) {
+        visit(visit, n);
+    }
+}
+
+}  // namespace
+
+fs::path dds::calc_module_bmi_path(build_env_ref env, std::string_view module_name) {
+    // Partitions are named `module:partition`, but a colon is not valid in every filename
+    auto filename = std::string(module_name);
+    std::replace(filename.begin(), filename.end(), ':', '-');
+    filename += env.toolchain.bmi_suffix();
+    return fs::weakly_canonical(env.output_root / "_modules" / filename);
+}
+
+module_graph dds::scan_module_deps(const ref_vector<const compile_file_plan>& compiles,
+                                   build_env_ref                              env,
+                                   const compilation_history&                 history) {
+    module_graph ret;
+    ret.units.resize(compiles.size());
+    if (!env.toolchain.supports_modules()) {
+        return ret;
+    }
+    ret.mapper_path = fs::weakly_canonical(env.output_root / "_modules" / "module.map");
+
+    // Scanning executes the preprocessor, so scan in parallel
+    dds::stopwatch                               timer;
+    std::vector<std::optional<module_deps_info>> infos(compiles.size());
+    std::vector<file_deps_info>                  new_deps;
+    std::mutex                                   mut;
+    auto                                         scan_file = [&](std::size_t n) {
+        auto& plan = compiles[n].get();
+        // A header to precompile cannot be a module unit, and module units are never batched
+        if (plan.is_pch() || plan.is_unity()) {
+            return;
+        }
+        infos[n] = scan_one(plan, env, history, [&](file_deps_info info) {
+            std::scoped_lock lk{mut};
+            new_deps.push_back(std::move(info));
+        });
+    };
+    // Record the scans that succeeded, even if another one failed
+    try {
+        parallel_run_or_throw(ranges::views::iota(std::size_t(0), compiles.size()), 0, scan_file);
+    } catch (...) {
+        env.deps.record(new_deps);
+        throw;
+    }
+    env.deps.record(new_deps);
+
+    // Map each module to the compilation that provides it
+    std::map<std::string, std::size_t> providers;
+    for (std::size_t n = 0; n < infos.size(); ++n) {
+        if (!infos[n] || !infos[n]->provides) {
+            continue;
+        }
+        auto [it, inserted] = providers.emplace(*infos[n]->provides, n);
+        if (!inserted) {
+            throw_user_error<errc::compile_failure>(
+                "C++ module '{}' is provided by both [{}] and [{}]",
+                it->first,
+                compiles[it->second].get().source_path().string(),
+                compiles[n].get().source_path().string());
+        }
+    }
+
+    std::map<std::string, fs::path> bmis;
+    for (std::size_t n = 0; n < infos.size(); ++n) {
+        if (!infos[n]) {
+            continue;
+        }
+        auto& info = *infos[n];
+        auto& unit = ret.units[n];
+        if (info.provides) {
+            unit.bmi = calc_module_bmi_path(env, *info.provides);
+            bmis.emplace(*info.provides, *unit.bmi);
+        }
+        for (auto& name : info.imports) {
+            auto bmi = calc_module_bmi_path(env, name);
+            bmis.emplace(name, bmi);
+            if (auto found = providers.find(name); found != providers.end()) {
+                unit.providers.push_back(found->second);
+            } else if (!fs::exists(bmi)) {
+                // The interface may have been built by a prior build, such as when compiling
+                // individual files. Otherwise, it cannot be built at all.
+                throw_user_error<errc::compile_failure>(
+                    "C++ module '{}' is imported by [{}], but no source file provides it",
+                    name,
+                    compiles[n].get().source_path().string());
+            }
+            unit.imported_bmis.push_back(std::move(bmi));
+        }
+        unit.uses_modules = info.provides || !info.imports.empty();
+    }
+    check_cycles(compiles, ret);
+    dds_log(debug,
+            "Found {} C++ modules in {:L}ms",
+            providers.size(),
+            timer.elapsed_ms().count());
+
+    if (bmis.empty()) {
+        return ret;
+    }
+    // Leave the mapper file untouched if the modules have not changed
+    std::string content;
+    for (auto& [name, bmi] : bmis) {
+        content += fmt::format("{} {}\n", name, bmi.string());
+    }
+    if (!fs::exists(ret.mapper_path) || slurp_file(ret.mapper_path) != content) {
+        fs::create_directories(ret.mapper_path.parent_path());
+        auto ofs = open(ret.mapper_path, std::ios::binary | std::ios::out);
+        ofs << content;
+    }
+    return ret;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <dds/build/file_deps.hpp>
+#include <dds/build/plan/compile_file.hpp>
+#include <dds/util/algo.hpp>
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace dds {
+
+/**
+ * The C++ module dependencies between a set of file compilations, as found by scanning them.
+ */
+struct module_graph {
+    /// The module dependencies of a single compilation
+    struct unit {
+        /// Whether the compilation provides or imports any module
+        bool uses_modules = false;
+        /// The interface file that is written by the compilation, if it provides a module
+        std::optional<fs::path> bmi;
+        /// The interface files of the modules that are imported by the compilation
+        std::vector<fs::path> imported_bmis;
+        /// The indices of the compilations that provide the imported modules. These must finish
+        /// before the compilation can start.
+        std::vector<std::size_t> providers;
+    };
+
+    /// The module mapper file, which names the interface file of every module in the graph
+    fs::path mapper_path;
+    /// The module dependencies of each compilation, in the order that the compilations were given
+    std::vector<unit> units;
+};
+
+/**
+ * Generate the path of the interface file of the named module, which is shared by every
+ * compilation in the build.
+ */
+fs::path calc_module_bmi_path(build_env_ref env, std::string_view module_name);
+
+/**
+ * Scan the given compilations for their C++ module dependencies, and write the module mapper file
+ * that is used to compile them. Only files that appear to use modules are scanned, and a scan is
+ * only executed again when its inputs have changed.
+ *
+ * If the toolchain does not support modules, every unit of the graph is empty.
+ *
+ * @throws user_error<errc::compile_failure> If a scan fails, if an imported module is provided by
+ * no compilation, if a module is provided by more than one compilation, or if the modules import
+ * each other in a cycle.
+ */
+module_graph scan_module_deps(const ref_vector<const compile_file_plan>& compiles,
+                              build_env_ref                              env,
+                              const compilation_history&                 history);
+
+}  // namespace dds
@@ -19,6 +19,8 @@ class package_plan {
     std::string _namespace;
     /// The libraries in this package
     std::vector<library_plan> _libraries;
+    /// Whether the outputs of this package were restored from the prebuilt dependency cache
+    bool _prebuilt = false;
 
 public:
     /**
@@ -37,6 +39,12 @@ public:
      */
     void add_library(library_plan lp) { _libraries.emplace_back(std::move(lp)); }
 
+    /**
+     * Mark the libraries of this package as already built. Their outputs will be used, but they
+     * will not be compiled or archived.
+     */
+    void mark_prebuilt() noexcept { _prebuilt = true; }
+
     /**
      * Get the package name
      */
@@ -49,6 +57,10 @@ public:
      * The libraries in the package
      */
     auto& libraries() const noexcept { return _libraries; }
+    /**
+     * Whether the outputs of this package are already built
+     */
+    bool is_prebuilt() const noexcept { return _prebuilt; }
 };
 
 }  // namespace dds
\ No newline at end of file
@@ -0,0 +1,313 @@
+#include "./test_run.hpp"
+
+#include <dds/proc.hpp>
+#include <dds/util/algo.hpp>
+#include <dds/util/hash.hpp>
+#include <dds/util/log.hpp>
+#include <dds/util/signal.hpp>
+#include <dds/util/string.hpp>
+
+#include <fansi/styled.hpp>
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <unordered_set>
+
+using namespace dds;
+using namespace fansi::literals;
+
+test_sharding::test_sharding(const std::vector<test_case_duration>& history,
+                             std::size_t                            max_shards,
+                             std::chrono::microseconds              min_shard_duration) {
+    std::chrono::microseconds total{0};
+    for (auto& tc : history) {
+        total += tc.duration;
+    }
+    std::size_t n_shards = history.size();
+    if (min_shard_duration.count() > 0) {
+        n_shards = std::min(n_shards, static_cast<std::size_t>(total / min_shard_duration));
+    }
+    _n_shards = std::clamp(n_shards, std::size_t(1), std::max(max_shards, std::size_t(1)));
+    _estimated_duration = total / _n_shards;
+    if (_n_shards == 1) {
+        return;
+    }
+
+    auto sorted = history;
+    std::sort(sorted.begin(), sorted.end(), [](auto& lhs, auto& rhs) {
+        return lhs.duration > rhs.duration;
+    });
+    std::vector<std::chrono::microseconds> loads(_n_shards);
+    for (auto& tc : sorted) {
+        auto least = std::min_element(loads.begin(), loads.end()) - loads.begin();
+        loads[least] += tc.duration;
+        _shard_of.emplace(tc.name, least);
+    }
+}
+
+std::size_t test_sharding::shard_of(const std::string& name) const noexcept {
+    auto found = _shard_of.find(name);
+    if (found != _shard_of.end()) {
+        return found->second;
+    }
+    return std::hash<std::string>{}(name) % _n_shards;
+}
+
+std::vector<std::string> dds::parse_catch2_test_names(std::string_view output) {
+    std::vector<std::string> ret;
+    for (auto line : split_view(output, "\n")) {
+        line = trim_view(line);
+        // Catch2 quotes the names that begin with '#'
+        if (line.size() >= 2 && line.front() == '"' && line.back() == '"') {
+            line = line.substr(1, line.size() - 2);
+        }
+        if (!line.empty()) {
+            ret.emplace_back(line);
+        }
+    }
+    return ret;
+}
+
+std::vector<test_case_duration> dds::parse_catch2_durations(std::string_view                output,
+                                                            const std::vector<std::string>& names) {
+    // Each duration is printed on a line of the form "1.234 s: <name>"
+    std::unordered_map<std::string_view, std::chrono::microseconds> found;
+    for (auto line : split_view(output, "\n")) {
+        line     = trim_view(line);
+        auto sep = line.find(" s: ");
+        if (sep == line.npos) {
+            continue;
+        }
+        std::string seconds_str{line.substr(0, sep)};
+        char*       end     = nullptr;
+        auto        seconds = std::strtod(seconds_str.c_str(), &end);
+        if (seconds_str.empty() || end != seconds_str.c_str() + seconds_str.size()) {
+            continue;
+        }
+        // A test case ends after all of its sections, so its own duration is printed last
+        found[line.substr(sep + 4)] = std::chrono::microseconds(
+            static_cast<std::chrono::microseconds::rep>(seconds * 1'000'000));
+    }
+
+    std::vector<test_case_duration> ret;
+    for (auto& name : names) {
+        auto dur = found.find(name);
+        if (dur != found.end()) {
+            ret.push_back(test_case_duration{name, dur->second});
+        }
+    }
+    return ret;
+}
+
+bool dds::is_plain_catch2_test_name(std::string_view name) noexcept {
+    // Catch2 trims the lines of the input file, ignores those that begin with '#', and treats
+    // these characters specially within test specifications
+    return !name.empty() && trim_view(name) == name && name.front() != '#'
+        && !starts_with(name, "exclude:") && name.find_first_of(",[]*\"\\~") == name.npos;
+}
+
+test_run::test_run(build_env_ref                     env,
+                   path_ref                          exe,
+                   const test_options&               opts,
+                   std::optional<recorded_test_pass> prior_pass,
+                   bool                              is_catch2,
+                   test_sharding                     sharding)
+    : _exe_path(exe)
+    , _message(fmt::format("Run test: .br.cyan[{:30}]"_styled,
+                           fs::relative(exe, env.output_root).string()))
+    , _opts(opts)
+    , _prior_pass(std::move(prior_pass))
+    , _is_catch2(is_catch2)
+    , _sharding(is_catch2 ? std::move(sharding) : test_sharding{}) {}
+
+std::optional<std::chrono::milliseconds> test_run::_proc_timeout() const noexcept {
+    if (_opts.timeout.count() == 0) {
+        return std::nullopt;
+    }
+    return _opts.timeout;
+}
+
+void test_run::prepare(job_graph::async_done done) {
+    auto start_time = std::chrono::steady_clock::now();
+
+    // A test that passed before will pass again if its executable has not changed
+    auto digest = sha256_file(_exe_path);
+    bool cached = _prior_pass && _prior_pass->exe_digest == digest;
+    {
+        std::scoped_lock lk{_mut};
+        _start_time = start_time;
+        _digest     = std::move(digest);
+        _cached     = cached;
+    }
+
+    if (!cached) {
+        if (n_shards() > 1) {
+            dds_log(info, "{} ({} shards)", _message, n_shards());
+        } else {
+            dds_log(info, _message);
+        }
+    }
+    if (cached || !_is_catch2) {
+        done([] {});
+        return;
+    }
+
+    run_proc_async(
+        {
+            .command = {_exe_path.string(), "--list-test-names-only"},
+            .timeout = _proc_timeout(),
+        },
+        [this, done](proc_result res) { done([this, res] { _set_names(res); }); });
+}
+
+void test_run::_set_names(const proc_result& list_res) {
+    cancellation_point();
+    // Catch2 exits with the number of test cases that it listed, so only check that it completed
+    if (list_res.signal || list_res.timed_out) {
+        dds_log(warn, "Failed to list the test cases of [{}]", _exe_path.string());
+        return;
+    }
+    auto names = parse_catch2_test_names(list_res.output);
+    if (!std::all_of(names.begin(), names.end(), is_plain_catch2_test_name)) {
+        dds_log(debug,
+                "Test cases of [{}] cannot all be selected by name. They will run in one shard.",
+                _exe_path.string());
+        return;
+    }
+    std::scoped_lock lk{_mut};
+    _names = std::move(names);
+}
+
+std::optional<std::vector<std::string>> test_run::_shard_names(std::size_t shard) const {
+    if (!_names) {
+        // The test cases are not known, so the first shard runs all of them
+        if (shard == 0) {
+            return std::nullopt;
+        }
+        return std::vector<std::string>{};
+    }
+    if (n_shards() == 1) {
+        return std::nullopt;
+    }
+    std::vector<std::string> ret;
+    for (auto& name : *_names) {
+        if (_sharding.shard_of(name) == shard) {
+            ret.push_back(name);
+        }
+    }
+    return ret;
+}
+
+void test_run::run_shard(std::size_t shard, std::function<void(test_result_fn)> done) {
+    std::unique_lock lk{_mut};
+    auto names = _cached ? std::vector<std::string>{} : _shard_names(shard);
+    lk.unlock();
+
+    if (names && names->empty()) {
+        done([this] { return _finish_shard(std::nullopt, {}); });
+        return;
+    }
+
+    std::vector<std::string> command = {_exe_path.string()};
+    if (_is_catch2) {
+        command.insert(command.end(), {"--durations", "yes"});
+    }
+    fs::path names_file;
+    if (names) {
+        names_file = _exe_path;
+        names_file += fmt::format(".shard-{}.txt", shard);
+        auto strm = open(names_file, std::ios::out | std::ios::binary);
+        for (auto& name : *names) {
+            strm << name << '\n';
+        }
+        strm.close();
+        command.insert(command.end(), {"--input-file", names_file.string()});
+    }
+
+    run_proc_async({.command = command, .timeout = _proc_timeout()}, [=, this](proc_result res) {
+        done([=, this]() -> std::optional<test_failure> {
+            if (!names_file.empty()) {
+                std::error_code ec;
+                fs::remove(names_file, ec);
+            }
+            cancellation_point();
+            std::optional<test_failure> failure;
+            if (!res.okay()) {
+                failure = test_failure{
+                    .executable_path = _exe_path,
+                    .output          = n_shards() > 1
+                        ? fmt::format("[Shard {} of {}]\n{}", shard + 1, n_shards(), res.output)
+                        : res.output,
+                    .retc      = res.retc,
+                    .signal    = res.signal,
+                    .timed_out = res.timed_out,
+                };
+            }
+            std::vector<test_case_duration> durations;
+            if (_names) {
+                durations = parse_catch2_durations(res.output, *_names);
+            }
+            return _finish_shard(std::move(failure), std::move(durations));
+        });
+    });
+}
+
+std::optional<test_failure> test_run::_finish_shard(std::optional<test_failure>     failure,
+                                                    std::vector<test_case_duration> durations) {
+    std::scoped_lock lk{_mut};
+    ++_n_finished;
+    if (failure) {
+        _failures.push_back(std::move(*failure));
+    }
+    extend(_durations, durations);
+    if (_n_finished < n_shards()) {
+        // The last shard reports the outcome of the whole test
+        return std::nullopt;
+    }
+
+    if (_cached) {
+        dds_log(info,
+                "{} - .br.green[PASS] - {:>9L}μs [cached]"_styled,
+                _message,
+                _prior_pass->duration.count());
+        return std::nullopt;
+    }
+
+    auto dur = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - _start_time);
+    if (_failures.empty()) {
+        dds_log(info, "{} - .br.green[PASS] - {:>9L}μs"_styled, _message, dur.count());
+        _pass = recorded_test_pass{
+            .exe_path   = _exe_path,
+            .exe_digest = _digest,
+            .duration   = dur,
+        };
+        return std::nullopt;
+    }
+
+    // Merge the failures of every shard
+    auto ret = _failures.front();
+    for (auto it = std::next(_failures.begin()); it != _failures.end(); ++it) {
+        ret.output += "\n" + it->output;
+        ret.timed_out = ret.timed_out || it->timed_out;
+    }
+    auto exit_msg = fmt::format(ret.signal ? "signalled {}" : "exited {}",
+                                ret.signal ? ret.signal : ret.retc);
+    auto fail_str = ret.timed_out ? ".br.yellow[TIME]"_styled : ".br.red[FAIL]"_styled;
+    dds_log(error, "{} - {} - {:>9L}μs [{}]", _message, fail_str, dur.count(), exit_msg);
+    return ret;
+}
+
+std::optional<recorded_test_pass> test_run::new_pass() const {
+    std::scoped_lock lk{_mut};
+    return _pass;
+}
+
+std::vector<test_case_duration> test_run::case_durations() const {
+    std::scoped_lock lk{_mut};
+    if (_n_finished < n_shards()) {
+        return {};
+    }
+    return _durations;
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <dds/build/plan/base.hpp>
+#include <dds/build/plan/exe.hpp>
+#include <dds/db/database.hpp>
+#include <dds/proc.hpp>
+#include <dds/util/fs.hpp>
+#include <dds/util/job_graph.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace dds {
+
+/**
+ * Splits the test cases of a Catch2 test executable into shards that can be run in parallel.
+ *
+ * The durations of the test cases from a prior run are used to balance the shards: Starting from
+ * the longest, each test case is assigned to the shard that has the least total duration so far.
+ * Test cases without a recorded duration, such as those that were added since the prior run, are
+ * assigned by a hash of their name.
+ */
+class test_sharding {
+    std::size_t                                  _n_shards = 1;
+    std::chrono::microseconds                    _estimated_duration{0};
+    std::unordered_map<std::string, std::size_t> _shard_of;
+
+public:
+    /**
+     * Create a sharding that puts every test case in a single shard
+     */
+    test_sharding() = default;
+
+    /**
+     * Split the given test cases into shards.
+     * @param history The durations of the test cases from a prior run
+     * @param max_shards The maximum number of shards to create
+     * @param min_shard_duration Shards are not made shorter than this. Splitting a short test into
+     * several processes would only add overhead.
+     */
+    test_sharding(const std::vector<test_case_duration>& history,
+                  std::size_t                            max_shards,
+                  std::chrono::microseconds              min_shard_duration);
+
+    /**
+     * The number of shards
+     */
+    std::size_t size() const noexcept { return _n_shards; }
+
+    /**
+     * The expected run time of each shard, or zero if it is not known
+     */
+    auto estimated_duration() const noexcept { return _estimated_duration; }
+
+    /**
+     * Get the index of the shard that contains the named test case
+     */
+    std::size_t shard_of(const std::string& name) const noexcept;
+};
+
+/**
+ * Parse the test case names that are printed by a Catch2 test executable that is run with
+ * `--list-test-names-only`.
+ */
+std::vector<std::string> parse_catch2_test_names(std::string_view output);
+
+/**
+ * Parse the durations that are printed by a Catch2 test executable that is run with
+ * `--durations yes`. Catch2 also prints the durations of the sections within test cases, so only
+ * the durations of the given test case names are returned.
+ */
+std::vector<test_case_duration> parse_catch2_durations(std::string_view                output,
+                                                       const std::vector<std::string>& names);
+
+/**
+ * Determine whether the given test case name can be given to Catch2 to select exactly that test
+ * case. Names that contain the special characters of Catch2's test specifications cannot.
+ */
+bool is_plain_catch2_test_name(std::string_view name) noexcept;
+
+/**
+ * Options that control the execution of tests
+ */
+struct test_options {
+    /// Run tests that passed in a prior build, even if their executables are unchanged
+    bool rerun = false;
+    /**
+     * If set, only the tests that are affected by changes to these files are run. The paths must be
+     * canonical.
+     */
+    std::optional<std::vector<fs::path>> changed_files = std::nullopt;
+    /// The time that each test process may run before it is killed. Zero to wait forever.
+    std::chrono::milliseconds timeout = std::chrono::seconds(10);
+};
+
+/**
+ * A function that reports the outcome of a test. If the test failed, then that failure
+ * information will be returned.
+ */
+using test_result_fn = std::function<std::optional<test_failure>()>;
+
+/**
+ * A single execution of a test executable, which may be split into several shards that are run as
+ * separate processes. The test is first prepared with `prepare()`, after which each shard is
+ * started separately, and the outcome of the test is reported once every shard has finished.
+ *
+ * Tests that use the Catch2 driver of dds are split according to a `test_sharding`. The test case
+ * names are listed by the executable, and each shard runs the test cases that are assigned to it.
+ * The durations of the test cases are collected from every run, for sharding the next run. Other
+ * tests are always run as a single process.
+ *
+ * All member functions may be called concurrently from any number of threads.
+ */
+class test_run {
+    fs::path                          _exe_path;
+    std::string                       _message;
+    test_options                      _opts;
+    std::optional<recorded_test_pass> _prior_pass;
+    bool                              _is_catch2;
+    test_sharding                     _sharding;
+
+    mutable std::mutex _mut;
+    // Set up by prepare()
+    bool                                    _cached = false;
+    std::string                             _digest;
+    std::optional<std::vector<std::string>> _names;
+    std::chrono::steady_clock::time_point   _start_time;
+    // Collected as the shards finish
+    std::size_t                       _n_finished = 0;
+    std::vector<test_failure>         _failures;
+    std::vector<test_case_duration>   _durations;
+    std::optional<recorded_test_pass> _pass;
+
+    std::optional<std::chrono::milliseconds> _proc_timeout() const noexcept;
+    std::optional<std::vector<std::string>>  _shard_names(std::size_t shard) const;
+    void                                     _set_names(const proc_result& list_res);
+
+    std::optional<test_failure>
+    _finish_shard(std::optional<test_failure> failure, std::vector<test_case_duration> durations);
+
+public:
+    /**
+     * Prepare to run a test executable.
+     * @param env The build environment to use.
+     * @param exe The test executable
+     * @param opts Options for running the test
+     * @param prior_pass The last recorded pass of this test, if any. If the executable has the same
+     * content as when it passed, the pass is reported again without running the test.
+     * @param is_catch2 Whether the test uses the Catch2 driver of dds
+     * @param sharding How to split the test cases of a Catch2 test between shards
+     */
+    test_run(build_env_ref                     env,
+             path_ref                          exe,
+             const test_options&               opts,
+             std::optional<recorded_test_pass> prior_pass,
+             bool                              is_catch2,
+             test_sharding                     sharding);
+
+    /**
+     * The path to the test executable
+     */
+    path_ref exe_path() const noexcept { return _exe_path; }
+
+    /**
+     * The number of shards that must be started
+     */
+    std::size_t n_shards() const noexcept { return _sharding.size(); }
+
+    /**
+     * Start preparing to run the test: Check whether the executable has changed since the test
+     * last passed, and start listing the test cases of a Catch2 test. This must complete before
+     * any shard is started.
+     * @param done Invoked once the preparation has completed, with a function that collects the
+     * listed test cases
+     */
+    void prepare(job_graph::async_done done);
+
+    /**
+     * Start running a shard of the test. The test must have been prepared.
+     * @param shard The index of the shard, less than `n_shards()`.
+     * @param done Invoked once the shard has exited, with a function that reports the outcome of
+     * the test. The outcome is only reported by the last shard to finish.
+     */
+    void run_shard(std::size_t shard, std::function<void(test_result_fn)> done);
+
+    /**
+     * If every shard has finished, the test was executed, and it passed, returns the information
+     * that should be recorded about the pass.
+     */
+    std::optional<recorded_test_pass> new_pass() const;
+
+    /**
+     * The durations of the test cases that were collected from the shards, once every shard has
+     * finished
+     */
+    std::vector<test_case_duration> case_durations() const;
+};
+
+}  // namespace dds
@@ -0,0 +1,78 @@
+#include <dds/build/plan/test_run.hpp>
+
+#include <catch2/catch.hpp>
+
+using namespace std::literals;
+
+namespace {
+
+dds::test_case_duration tc(std::string name, std::chrono::microseconds dur) {
+    return dds::test_case_duration{std::move(name), dur};
+}
+
+}  // namespace
+
+TEST_CASE("Balance test cases between shards") {
+    std::vector<dds::test_case_duration> history = {
+        tc("short 1", 1s),
+        tc("long", 6s),
+        tc("medium", 3s),
+        tc("short 2", 1s),
+        tc("short 3", 1s),
+    };
+
+    dds::test_sharding sharding{history, 2, 1s};
+    REQUIRE(sharding.size() == 2);
+    CHECK(sharding.estimated_duration() == 6s);
+    // The longest test case gets a shard of its own
+    auto long_shard = sharding.shard_of("long");
+    for (auto name : {"short 1", "medium", "short 2", "short 3"}) {
+        CHECK(sharding.shard_of(name) != long_shard);
+    }
+    // Unknown test cases are still assigned to some shard
+    CHECK(sharding.shard_of("new test") < 2);
+}
+
+TEST_CASE("Short tests are not sharded") {
+    std::vector<dds::test_case_duration> history = {
+        tc("first", 300ms),
+        tc("second", 300ms),
+        tc("third", 300ms),
+    };
+    CHECK(dds::test_sharding(history, 8, 1s).size() == 1);
+    CHECK(dds::test_sharding(history, 8, 500ms).size() == 1);
+    CHECK(dds::test_sharding(history, 8, 100ms).size() == 3);
+    CHECK(dds::test_sharding(history, 2, 100ms).size() == 2);
+    CHECK(dds::test_sharding({}, 8, 1s).size() == 1);
+}
+
+TEST_CASE("Parse Catch2 test names") {
+    auto names = dds::parse_catch2_test_names("First test\r\n\"#2 test\"\n\nThird test\n");
+    CHECK(names == std::vector<std::string>{"First test", "#2 test", "Third test"});
+}
+
+TEST_CASE("Parse Catch2 test case durations") {
+    auto output = R"(
+0.250 s: A section
+1.500 s: First test
+0.002 s: Not a test case
+Some other output: 1.0 s: here
+2.000 s: Second test
+)";
+    auto durations = dds::parse_catch2_durations(output, {"First test", "Second test", "Third"});
+    REQUIRE(durations.size() == 2);
+    CHECK(durations[0].name == "First test");
+    CHECK(durations[0].duration == 1500ms);
+    CHECK(durations[1].name == "Second test");
+    CHECK(durations[1].duration == 2s);
+}
+
+TEST_CASE("Only plain test names are selected by name") {
+    CHECK(dds::is_plain_catch2_test_name("Parse a manifest file"));
+    CHECK_FALSE(dds::is_plain_catch2_test_name(""));
+    CHECK_FALSE(dds::is_plain_catch2_test_name("#1"));
+    CHECK_FALSE(dds::is_plain_catch2_test_name("Tagged [tag]"));
+    CHECK_FALSE(dds::is_plain_catch2_test_name("a, b"));
+    CHECK_FALSE(dds::is_plain_catch2_test_name("Wild*"));
+    CHECK_FALSE(dds::is_plain_catch2_test_name(" padded "));
+}
@@ -0,0 +1,150 @@
+#include "./prebuilt_cache.hpp"
+
+#include <dds/proc.hpp>
+#include <dds/util/hash.hpp>
+#include <dds/util/log.hpp>
+#include <dds/util/paths.hpp>
+
+#include <fmt/core.h>
+
+#include <random>
+#include <set>
+
+using namespace dds;
+
+namespace {
+
+/// Bump this to invalidate every existing entry if the layout of the entries changes
+constexpr std::string_view entry_version = "dds-prebuilt 1";
+
+/// The file that records the key of the outputs that were restored into a directory
+fs::path stamp_path(const std::vector<fs::path>& dirs) { return dirs.front() / ".dds-prebuilt"; }
+
+}  // namespace
+
+fs::path prebuilt_cache::default_path() noexcept { return dds_data_dir() / "prebuilt"; }
+
+prebuilt_cache::prebuilt_cache(path_ref root)
+    : _root(root) {
+    fs::create_directories(_root);
+}
+
+fs::path prebuilt_cache::_entry_dir(std::string_view key) const {
+    return _root / key.substr(0, 2) / key;
+}
+
+bool prebuilt_cache::restore(std::string_view key, const std::vector<fs::path>& dirs) const {
+    auto entry = _entry_dir(key);
+    if (!fs::is_directory(entry)) {
+        return false;
+    }
+    if (!dirs.empty()) {
+        std::error_code ec;
+        if (slurp_file(stamp_path(dirs), ec) == key && !ec) {
+            return true;
+        }
+    }
+    try {
+        forget_restored(dirs);
+        for (std::size_t idx = 0; idx < dirs.size(); ++idx) {
+            fs::create_directories(dirs[idx]);
+            fs::copy(entry / std::to_string(idx),
+                     dirs[idx],
+                     fs::copy_options::recursive | fs::copy_options::overwrite_existing);
+        }
+        if (!dirs.empty()) {
+            auto strm = open(stamp_path(dirs), std::ios::out | std::ios::binary);
+            strm << key;
+        }
+    } catch (const std::exception& e) {
+        dds_log(warn, "Failed to restore prebuilt outputs [{}]: {}", entry.string(), e.what());
+        return false;
+    }
+    return true;
+}
+
+void prebuilt_cache::forget_restored(const std::vector<fs::path>& dirs) {
+    if (!dirs.empty()) {
+        std::error_code ec;
+        fs::remove(stamp_path(dirs), ec);
+    }
+}
+
+void prebuilt_cache::store(std::string_view key, const std::vector<fs::path>& dirs) const {
+    auto entry = _entry_dir(key);
+    if (fs::exists(entry)) {
+        return;
+    }
+
+    // Fill a temporary directory, then rename it into place, so that no build will ever see a
+    // partially written entry
+    thread_local std::mt19937_64 rng{std::random_device{}()};
+    auto                         tmp = entry;
+    tmp += fmt::format(".tmp-{:x}", rng());
+    try {
+        for (std::size_t idx = 0; idx < dirs.size(); ++idx) {
+            auto dest = tmp / std::to_string(idx);
+            fs::create_directories(dest);
+            if (fs::is_directory(dirs[idx])) {
+                fs::copy(dirs[idx], dest, fs::copy_options::recursive);
+            }
+        }
+        std::error_code ec;
+        fs::rename(tmp, entry, ec);
+        if (ec && !fs::exists(entry)) {
+            throw std::system_error(ec, "Failed to rename " + tmp.string());
+        }
+    } catch (const std::exception& e) {
+        dds_log(warn, "Failed to store prebuilt outputs [{}]: {}", entry.string(), e.what());
+    }
+    // If another build published the same entry first, our copy is left over
+    std::error_code ec;
+    fs::remove_all(tmp, ec);
+}
+
+std::string dds::toolchain_fingerprint(const toolchain& tc) {
+    sha256 hash;
+    hash.update(entry_version);
+
+    std::vector<std::vector<std::string>> commands;
+    for (auto lang : {language::c, language::cxx}) {
+        compile_file_spec spec{
+            .source_path = "[in]",
+            .out_path    = "[out]",
+            .lang        = lang,
+        };
+        commands.push_back(tc.create_compile_command(spec, "", toolchain_knobs{}).command);
+    }
+    commands.push_back(
+        tc.create_archive_command(archive_spec{.out_path = "[out]"}, "", toolchain_knobs{}));
+
+    std::set<std::string> programs;
+    for (auto& cmd : commands) {
+        for (auto& arg : cmd) {
+            hash.update(std::string_view(arg.c_str(), arg.size() + 1));
+        }
+        hash.update("\n");
+        if (!cmd.empty()) {
+            programs.insert(cmd.front());
+        }
+    }
+
+    // Identify the programs by location, size, and modification time, which is enough to notice
+    // when a compiler is upgraded
+    for (auto& program : programs) {
+        auto exe = find_program(program);
+        if (!exe) {
+            continue;
+        }
+        std::error_code ec;
+        auto            canon = fs::weakly_canonical(*exe, ec);
+        auto            size  = fs::file_size(canon, ec);
+        auto            mtime = fs::last_write_time(canon, ec);
+        if (ec) {
+            continue;
+        }
+        hash.update(
+            fmt::format("{} {} {}\n", canon.string(), size, mtime.time_since_epoch().count()));
+    }
+    return hash.hex_digest();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <dds/toolchain/toolchain.hpp>
+#include <dds/util/fs.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace dds {
+
+/**
+ * A cache of the build outputs of dependency packages, shared between all projects of the user.
+ *
+ * Packages from the package cache never change, so the outputs of building one are determined by
+ * the package ID, the toolchain, the tweaks that are applied, and the exact versions of the
+ * packages that it depends on. The builder combines these into a key for each dependency. If an
+ * entry exists for the key, its outputs are copied into the build directory in place of compiling
+ * the package.
+ *
+ * An entry holds a copy of some directories, such as those of a package's objects and archives
+ * and of its generated headers. They may be restored to different locations than they were stored
+ * from. Entries are published atomically and never modified, so any number of builds may use the
+ * cache at once.
+ */
+class prebuilt_cache {
+    fs::path _root;
+
+    fs::path _entry_dir(std::string_view key) const;
+
+public:
+    /**
+     * The default location of the prebuilt dependency cache, within the user's dds data directory
+     */
+    static fs::path default_path() noexcept;
+
+    /**
+     * Open the cache in the given directory. It will be created if it does not exist.
+     */
+    explicit prebuilt_cache(path_ref root);
+
+    /**
+     * Copy the directories that are stored for `key` into the given directories, in the same order
+     * as they were given to `store()`, replacing any existing files. Returns `false` if there is no
+     * entry for the key.
+     *
+     * A stamp in the first directory records the key that was restored. If the directories already
+     * hold the outputs for `key`, nothing is copied, so that the restored files keep their
+     * modification times and do not cause the files that are built from them to be rebuilt.
+     */
+    bool restore(std::string_view key, const std::vector<fs::path>& dirs) const;
+
+    /**
+     * Discard the stamp of the outputs that were restored into the given directories, because
+     * they are about to be built in place
+     */
+    static void forget_restored(const std::vector<fs::path>& dirs);
+
+    /**
+     * Store a copy of the given directories as the outputs for `key`. Directories that do not
+     * exist are stored as empty. If an entry already exists for the key, it is kept.
+     */
+    void store(std::string_view key, const std::vector<fs::path>& dirs) const;
+};
+
+/**
+ * Compute a digest that identifies the commands of the given toolchain and the compilers that they
+ * run. Builds with equal fingerprints produce interchangeable outputs.
+ */
+std::string toolchain_fingerprint(const toolchain& tc);
+
+}  // namespace dds
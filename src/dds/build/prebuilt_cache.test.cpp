@@ -0,0 +1,86 @@
+#include <dds/build/prebuilt_cache.hpp>
+
+#include <dds/temp.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+void write(const dds::fs::path& p, std::string_view content) {
+    dds::fs::create_directories(p.parent_path());
+    std::ofstream{p, std::ios::binary} << content;
+}
+
+std::string read(const dds::fs::path& p) {
+    std::ifstream      in{p, std::ios::binary};
+    std::ostringstream strm;
+    strm << in.rdbuf();
+    return strm.str();
+}
+
+}  // namespace
+
+TEST_CASE("Store and restore prebuilt outputs") {
+    auto tempdir = dds::temporary_dir::create();
+    auto root    = tempdir.path() / "cache";
+    auto proj_a  = tempdir.path() / "a/_build";
+    auto proj_b  = tempdir.path() / "b/_deps";
+
+    dds::prebuilt_cache cache{root};
+    CHECK_FALSE(cache.restore("abcdef", {proj_b / "foo@1.2.3"}));
+
+    write(proj_a / "_deps/foo@1.2.3/libfoo.a", "archive");
+    write(proj_a / "_deps/foo@1.2.3/obj/foo.cpp.o", "object");
+    write(proj_a / "__dds/gen/_deps/foo@1.2.3/foo/config.hpp", "#define FOO 1");
+    cache.store("abcdef",
+                {proj_a / "_deps/foo@1.2.3",
+                 proj_a / "__dds/gen/_deps/foo@1.2.3",
+                 proj_a / "nonesuch"});
+
+    // The outputs may be restored into a different layout
+    REQUIRE(cache.restore("abcdef",
+                          {proj_b / "foo@1.2.3", proj_b / "__dds/gen/foo@1.2.3", proj_b / "other"}));
+    CHECK(read(proj_b / "foo@1.2.3/libfoo.a") == "archive");
+    CHECK(read(proj_b / "foo@1.2.3/obj/foo.cpp.o") == "object");
+    CHECK(read(proj_b / "__dds/gen/foo@1.2.3/foo/config.hpp") == "#define FOO 1");
+    CHECK(dds::fs::is_directory(proj_b / "other"));
+
+    // An existing entry is never modified
+    write(proj_a / "_deps/foo@1.2.3/libfoo.a", "changed");
+    cache.store("abcdef", {proj_a / "_deps/foo@1.2.3"});
+    REQUIRE(cache.restore("abcdef", {proj_b / "foo@1.2.3"}));
+    CHECK(read(proj_b / "foo@1.2.3/libfoo.a") == "archive");
+}
+
+TEST_CASE("Restoring the same outputs again copies nothing") {
+    auto tempdir = dds::temporary_dir::create();
+    auto proj_a  = tempdir.path() / "a";
+    auto proj_b  = tempdir.path() / "b";
+
+    dds::prebuilt_cache cache{tempdir.path() / "cache"};
+    write(proj_a / "libfoo.a", "archive");
+    cache.store("abcdef", {proj_a});
+    REQUIRE(cache.restore("abcdef", {proj_b}));
+    auto mtime = dds::fs::last_write_time(proj_b / "libfoo.a");
+
+    // The outputs are already in place, so they are left as they are
+    write(proj_b / "libfoo.a", "local");
+    dds::fs::last_write_time(proj_b / "libfoo.a", mtime);
+    REQUIRE(cache.restore("abcdef", {proj_b}));
+    CHECK(read(proj_b / "libfoo.a") == "local");
+    CHECK(dds::fs::last_write_time(proj_b / "libfoo.a") == mtime);
+
+    // Once the outputs are to be built in place, they are copied again when restored
+    dds::prebuilt_cache::forget_restored({proj_b});
+    REQUIRE(cache.restore("abcdef", {proj_b}));
+    CHECK(read(proj_b / "libfoo.a") == "archive");
+
+    // Likewise for outputs of a different key
+    write(proj_a / "libfoo.a", "other archive");
+    cache.store("012345", {proj_a});
+    REQUIRE(cache.restore("012345", {proj_b}));
+    CHECK(read(proj_b / "libfoo.a") == "other archive");
+}
@@ -6,13 +6,65 @@
 #include <dds/error/errors.hpp>
 #include <dds/pkg/db.hpp>
 #include <dds/pkg/remote.hpp>
+#include <dds/proc.hpp>
 #include <dds/toolchain/from_json.hpp>
+#include <dds/util/fs.hpp>
+#include <dds/util/log.hpp>
+#include <dds/util/string.hpp>
 
 using namespace dds;
 
 namespace dds::cli::cmd {
 
+/**
+ * Run a Git command in the project directory, and return its output
+ */
+static std::string run_git(const options& opts, std::vector<std::string> args) {
+    args.insert(args.begin(), "git");
+    auto res = run_proc({.command = args, .cwd = opts.project_dir});
+    if (!res.okay()) {
+        throw_external_error<errc::git_diff_failure>("Git command failed [{}] [Exited {}]:\n{}",
+                                                     quote_command(args),
+                                                     res.retc,
+                                                     res.output);
+    }
+    return res.output;
+}
+
+/**
+ * Find the files named by `--affected-since`. The argument is either a file that lists one path per
+ * line, relative to the project directory, or a Git revision to compare the working tree against.
+ */
+static std::vector<fs::path> changed_files(const options& opts, const std::string& since) {
+    fs::path    base;
+    std::string listing;
+    if (fs::is_regular_file(since)) {
+        base    = opts.project_dir;
+        listing = slurp_file(since);
+    } else {
+        base    = trim_view(run_git(opts, {"rev-parse", "--show-toplevel"}));
+        listing = run_git(opts, {"diff", "--name-only", "--no-renames", since, "--"});
+    }
+
+    std::vector<fs::path> ret;
+    for (auto line : split_view(listing, "\n")) {
+        line = trim_view(line);
+        if (!line.empty()) {
+            ret.push_back(fs::weakly_canonical(base / line));
+        }
+    }
+    dds_log(debug, "{} files have changed since '{}'", ret.size(), since);
+    return ret;
+}
+
 static int _build(const options& opts) {
+    // A daemon cannot update repositories for us, nor can it compare against Git
+    if (opts.build.add_repos.empty() && !opts.build.update_repos && !opts.build.affected_since) {
+        if (auto rc = forward_to_daemon(opts, subcommand::build)) {
+            return *rc;
+        }
+    }
+
     if (!opts.build.add_repos.empty()) {
         auto cat = opts.open_pkg_db();
         for (auto& str : opts.build.add_repos) {
@@ -25,15 +77,15 @@ static int _build(const options& opts) {
         update_all_remotes(opts.open_pkg_db().database());
     }
 
-    auto builder = create_project_builder(opts);
-    builder.build({
-        .out_root          = opts.out_path.value_or(fs::current_path() / "_build"),
-        .existing_lm_index = opts.build.lm_index,
-        .emit_lmi          = {},
-        .tweaks_dir        = opts.build.tweaks_dir,
-        .toolchain         = opts.load_toolchain(),
-        .parallel_jobs     = opts.jobs,
-    });
+    // Find the changed files before the build begins writing any files
+    std::optional<std::vector<fs::path>> changed;
+    if (opts.build.affected_since) {
+        changed = changed_files(opts, *opts.build.affected_since);
+    }
+
+    auto params          = make_build_params(opts);
+    params.changed_files = changed;
+    create_project_builder(opts).build(params);
 
     return 0;
 }
@@ -4,18 +4,24 @@
 #include <dds/pkg/cache.hpp>
 #include <dds/pkg/db.hpp>
 #include <dds/pkg/get/get.hpp>
+#include <dds/util/hash.hpp>
+#include <dds/util/local_socket.hpp>
+#include <dds/util/log.hpp>
+#include <dds/util/paths.hpp>
 
 #include <boost/leaf/handle_exception.hpp>
+#include <nlohmann/json.hpp>
 
 using namespace dds;
 
 builder dds::cli::create_project_builder(const dds::cli::options& opts) {
     sdist_build_params main_params = {
-        .subdir          = "",
-        .build_tests     = opts.build.want_tests,
-        .run_tests       = opts.build.want_tests,
-        .build_apps      = opts.build.want_apps,
-        .enable_warnings = !opts.disable_warnings,
+        .subdir           = "",
+        .build_tests      = opts.build.want_tests,
+        .run_tests        = opts.build.want_tests,
+        .build_apps       = opts.build.want_apps,
+        .enable_warnings  = !opts.disable_warnings,
+        .unity_batch_size = opts.build.unity_batch_size,
     };
 
     auto man
@@ -38,7 +44,8 @@ builder dds::cli::create_project_builder(const dds::cli::options& opts) {
                     auto sdist_ptr = repo.find(pk);
                     assert(sdist_ptr);
                     sdist_build_params deps_params;
-                    deps_params.subdir = fs::path("_deps") / sdist_ptr->manifest.id.to_string();
+                    deps_params.subdir    = fs::path("_deps") / sdist_ptr->manifest.id.to_string();
+                    deps_params.cacheable = true;
                     builder.add(*sdist_ptr, deps_params);
                 }
             });
@@ -47,6 +54,24 @@ builder dds::cli::create_project_builder(const dds::cli::options& opts) {
     return builder;
 }
 
+build_params dds::cli::make_build_params(const options& opts) {
+    return {
+        .out_root           = opts.out_path.value_or(fs::current_path() / "_build"),
+        .existing_lm_index  = opts.build.lm_index,
+        .emit_lmi           = {},
+        .tweaks_dir         = opts.build.tweaks_dir,
+        .toolchain          = opts.load_toolchain(),
+        .parallel_jobs      = opts.jobs,
+        .use_deps_log       = opts.deps_log,
+        .use_object_cache   = opts.object_cache,
+        .object_cache_size  = std::uintmax_t(opts.object_cache_mib) << 20,
+        .map_path_prefixes  = opts.map_path_prefixes,
+        .use_prebuilt_cache = opts.prebuilt_cache,
+        .rerun_tests        = opts.build.rerun_tests,
+        .test_timeout       = opts.build.test_timeout,
+    };
+}
+
 int dds::cli::handle_build_error(std::function<int()> fn) {
     return boost::leaf::try_catch(  //
         [&] {
@@ -64,3 +89,98 @@ int dds::cli::handle_build_error(std::function<int()> fn) {
             return 1;
         });
 }
+
+namespace {
+
+std::string canonical_string(dds::path_ref p) { return fs::weakly_canonical(p).string(); }
+
+}  // namespace
+
+fs::path dds::cli::daemon_socket_path(const options& opts) {
+    auto out_root = canonical_string(opts.out_path.value_or(fs::current_path() / "_build"));
+    // The length of a socket path is limited, so name the socket by a digest of the build directory
+    return user_cache_dir() / "dds-daemon" / (sha256_hex(out_root).substr(0, 16) + ".sock");
+}
+
+std::string dds::cli::daemon_options_key(const options& opts, subcommand cmd) {
+    auto opt_path = [](const std::optional<fs::path>& p) -> nlohmann::json {
+        if (!p) {
+            return nullptr;
+        }
+        return canonical_string(*p);
+    };
+    auto toolchain = opts.toolchain.value_or("");
+    if (!toolchain.empty() && !toolchain.starts_with(":")) {
+        toolchain = canonical_string(toolchain);
+    }
+
+    nlohmann::json key = {
+        {"project", canonical_string(opts.project_dir)},
+        {"out", canonical_string(opts.out_path.value_or(fs::current_path() / "_build"))},
+        {"toolchain", toolchain},
+        {"tweaks-dir", opt_path(opts.build.tweaks_dir)},
+        {"lm-index", opt_path(opts.build.lm_index)},
+        {"deps-log", opts.deps_log},
+        {"object-cache", opts.object_cache},
+        {"object-cache-mib", opts.object_cache_mib},
+        {"map-path-prefixes", opts.map_path_prefixes},
+        {"prebuilt-cache", opts.prebuilt_cache},
+        {"no-warnings", opts.disable_warnings},
+        {"tests", opts.build.want_tests},
+        {"apps", opts.build.want_apps},
+        {"unity", opts.build.unity_batch_size},
+    };
+    // Only a build runs tests, so only a build depends on how they are run
+    if (cmd == subcommand::build) {
+        key["rerun-tests"]  = opts.build.rerun_tests;
+        key["test-timeout"] = opts.build.test_timeout;
+    }
+    return key.dump();
+}
+
+std::optional<int> dds::cli::forward_to_daemon(const options& opts, subcommand cmd) {
+    auto sock_path = daemon_socket_path(opts);
+    if (!fs::exists(sock_path)) {
+        return std::nullopt;
+    }
+    auto conn = local_connection::connect(sock_path);
+    if (!conn) {
+        dds_log(debug, "No daemon is listening on [{}]", sock_path.string());
+        return std::nullopt;
+    }
+
+    nlohmann::json request = {
+        {"options", daemon_options_key(opts, cmd)},
+        {"command", cmd == subcommand::build ? "build" : "compile-file"},
+        {"log-level", int(log::current_log_level)},
+        {"files", nlohmann::json::array()},
+    };
+    for (auto& file : opts.compile_file.files) {
+        request["files"].push_back(canonical_string(file));
+    }
+    if (!conn->write_line(request.dump())) {
+        return std::nullopt;
+    }
+
+    dds_log(debug, "Handing the build to the daemon listening on [{}]", sock_path.string());
+    while (auto line = conn->read_line()) {
+        auto reply = nlohmann::json::parse(*line, nullptr, false);
+        if (reply.is_discarded() || !reply.is_object()) {
+            break;
+        }
+        if (reply.contains("log")) {
+            // The daemon sends the levels of its logger, which are in the same order as ours
+            log::log_print(log::level(reply.value("level", int(log::level::info))),
+                           reply["log"].get<std::string>());
+        } else if (reply.contains("exit")) {
+            return reply["exit"].get<int>();
+        } else if (reply.contains("refused")) {
+            dds_log(info,
+                    "The running daemon did not accept the build ({}), so it will run here instead",
+                    reply["refused"].get<std::string>());
+            return std::nullopt;
+        }
+    }
+    dds_log(warn, "The daemon went away before the build completed, so it will run here instead");
+    return std::nullopt;
+}
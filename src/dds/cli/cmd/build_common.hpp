@@ -3,11 +3,39 @@
 #include <dds/build/builder.hpp>
 
 #include <functional>
+#include <optional>
+#include <string>
 
 namespace dds::cli {
 
 dds::builder create_project_builder(const options& opts);
 
+/**
+ * Create the build parameters that are given by the command-line options
+ */
+build_params make_build_params(const options& opts);
+
 int handle_build_error(std::function<int()>);
 
+/**
+ * The path of the socket on which a `dds daemon` for the build directory of the given options
+ * listens
+ */
+fs::path daemon_socket_path(const options& opts);
+
+/**
+ * Summarize the options that determine the result of the given subcommand. A daemon only serves a
+ * request whose summary matches the summary of the daemon's own options.
+ */
+std::string daemon_options_key(const options& opts, subcommand cmd);
+
+/**
+ * Hand the given subcommand to a `dds daemon` that is serving the project, if one is running, and
+ * print the output of the daemon as it is received.
+ *
+ * @returns The exit code of the subcommand, or `nullopt` if no daemon ran it, in which case the
+ * subcommand should be run in this process.
+ */
+std::optional<int> forward_to_daemon(const options& opts, subcommand cmd);
+
 }  // namespace dds::cli
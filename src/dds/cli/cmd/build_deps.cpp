@@ -16,13 +16,18 @@ namespace dds::cli::cmd {
 
 static int _build_deps(const options& opts) {
     dds::build_params params{
-        .out_root          = opts.out_path.value_or(fs::current_path() / "_deps"),
-        .existing_lm_index = {},
-        .emit_lmi          = opts.build.lm_index.value_or("INDEX.lmi"),
-        .emit_cmake        = opts.build_deps.cmake_file,
-        .tweaks_dir        = opts.build.tweaks_dir,
-        .toolchain         = opts.load_toolchain(),
-        .parallel_jobs     = opts.jobs,
+        .out_root           = opts.out_path.value_or(fs::current_path() / "_deps"),
+        .existing_lm_index  = {},
+        .emit_lmi           = opts.build.lm_index.value_or("INDEX.lmi"),
+        .emit_cmake         = opts.build_deps.cmake_file,
+        .tweaks_dir         = opts.build.tweaks_dir,
+        .toolchain          = opts.load_toolchain(),
+        .parallel_jobs      = opts.jobs,
+        .use_deps_log       = opts.deps_log,
+        .use_object_cache   = opts.object_cache,
+        .object_cache_size  = std::uintmax_t(opts.object_cache_mib) << 20,
+        .map_path_prefixes  = opts.map_path_prefixes,
+        .use_prebuilt_cache = opts.prebuilt_cache,
     };
 
     dds::builder            bd;
@@ -54,7 +59,8 @@ static int _build_deps(const options& opts) {
                 auto sdist_ptr = repo.find(pk);
                 assert(sdist_ptr);
                 dds::sdist_build_params deps_params;
-                deps_params.subdir = sdist_ptr->manifest.id.to_string();
+                deps_params.subdir    = sdist_ptr->manifest.id.to_string();
+                deps_params.cacheable = true;
                 dds_log(info, "Dependency: {}", sdist_ptr->manifest.id.to_string());
                 bd.add(*sdist_ptr, deps_params);
             }
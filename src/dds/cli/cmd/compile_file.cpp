@@ -5,16 +5,11 @@
 namespace dds::cli::cmd {
 
 int compile_file(const options& opts) {
+    if (auto rc = forward_to_daemon(opts, subcommand::compile_file)) {
+        return *rc;
+    }
     auto builder = create_project_builder(opts);
-    builder.compile_files(opts.compile_file.files,
-                          {
-                              .out_root = opts.out_path.value_or(fs::current_path() / "_build"),
-                              .existing_lm_index = opts.build.lm_index,
-                              .emit_lmi          = {},
-                              .tweaks_dir        = opts.build.tweaks_dir,
-                              .toolchain         = opts.load_toolchain(),
-                              .parallel_jobs     = opts.jobs,
-                          });
+    builder.compile_files(opts.compile_file.files, make_build_params(opts));
     return 0;
 }
 
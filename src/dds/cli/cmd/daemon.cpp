@@ -0,0 +1,187 @@
+#include "../options.hpp"
+
+#include "../error_handler.hpp"
+#include "./build_common.hpp"
+
+#include <dds/error/errors.hpp>
+#include <dds/util/fs_watch.hpp>
+#include <dds/util/local_socket.hpp>
+#include <dds/util/log.hpp>
+#include <dds/util/signal.hpp>
+
+#include <nlohmann/json.hpp>
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+using namespace dds;
+using namespace std::literals;
+
+namespace dds::cli::cmd {
+
+namespace {
+
+/**
+ * A log sink that sends each message to the client of the daemon, which prints it
+ */
+class client_log_sink : public spdlog::sinks::base_sink<std::mutex> {
+    local_connection& _conn;
+
+public:
+    explicit client_log_sink(local_connection& conn)
+        : _conn(conn) {}
+
+protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override {
+        nlohmann::json line = {
+            {"level", int(msg.level)},
+            {"log", std::string(msg.payload.data(), msg.payload.size())},
+        };
+        // If the client has gone away, the build continues anyway, for the benefit of the next one
+        _conn.write_line(line.dump());
+    }
+    void flush_() override {}
+};
+
+struct daemon_state {
+    const options&               opts;
+    fs::path                     project_dir = fs::weakly_canonical(opts.project_dir);
+    std::optional<build_session> session;
+
+    /**
+     * Tell the build session about the files that have changed. Changes to the files at the root of
+     * the project, such as the package manifest, start a new session.
+     */
+    void apply(const fs_changes& changes) {
+        if (changes.empty() || !session) {
+            return;
+        }
+        auto at_root = [&](path_ref p) { return p.parent_path() == project_dir; };
+        if (changes.overflowed || std::ranges::any_of(changes.modified, at_root)
+            || std::ranges::any_of(changes.created_or_removed, at_root)) {
+            dds_log(info, "The project has changed, so its build will be planned again");
+            session.reset();
+            return;
+        }
+        dds_log(debug,
+                "{} files were modified, and {} were created or removed",
+                changes.modified.size(),
+                changes.created_or_removed.size());
+        for (auto& file : changes.modified) {
+            session->file_changed(file);
+        }
+        for (auto& file : changes.created_or_removed) {
+            session->file_changed(file);
+        }
+        if (!changes.created_or_removed.empty()) {
+            session->files_added_or_removed();
+        }
+    }
+
+    /**
+     * Run the build that is requested by the client, and send it the result
+     */
+    void serve(local_connection& conn) {
+        auto line = conn.read_line();
+        if (!line) {
+            return;
+        }
+        auto request = nlohmann::json::parse(*line, nullptr, false);
+        if (request.is_discarded() || !request.is_object()) {
+            conn.write_line(R"({"refused": "The request is not valid"})");
+            return;
+        }
+        auto command = request.value("command", ""s);
+        if (command != "build" && command != "compile-file") {
+            conn.write_line(nlohmann::json{{"refused", "Unknown command: " + command}}.dump());
+            return;
+        }
+        auto cmd = command == "build" ? subcommand::build : subcommand::compile_file;
+        if (request.value("options", ""s) != daemon_options_key(opts, cmd)) {
+            conn.write_line(R"({"refused": "The daemon was started with different options"})");
+            return;
+        }
+        std::vector<fs::path> files;
+        for (auto& file : request.value("files", nlohmann::json::array())) {
+            files.push_back(file.get<std::string>());
+        }
+
+        dds_log(info, "Serving a request to {}", command);
+        auto  prev_level = log::current_log_level;
+        auto  sink       = std::make_shared<client_log_sink>(conn);
+        auto& sinks      = spdlog::default_logger()->sinks();
+        log::current_log_level = log::level(request.value("log-level", int(prev_level)));
+        sinks.push_back(sink);
+
+        auto rc = handle_cli_errors([&] {
+            if (!session) {
+                session.emplace(create_project_builder(opts).sdists(), make_build_params(opts));
+            }
+            if (cmd == subcommand::build) {
+                return handle_build_error([&] {
+                    session->build();
+                    return 0;
+                });
+            }
+            session->compile_files(files);
+            return 0;
+        });
+
+        std::erase(sinks, sink);
+        log::current_log_level = prev_level;
+        conn.write_line(nlohmann::json{{"exit", rc}}.dump());
+        dds_log(info, "Finished the request to {} [Exited {}]", command, rc);
+    }
+};
+
+}  // namespace
+
+int daemon(const options& opts) {
+    auto sock_path = daemon_socket_path(opts);
+    auto out_root  = opts.out_path.value_or(fs::current_path() / "_build");
+
+    std::vector<fs::path> roots = {opts.project_dir};
+    if (opts.build.tweaks_dir) {
+        roots.push_back(*opts.build.tweaks_dir);
+    }
+
+    auto [listener, watcher] = [&] {
+        try {
+            fs::create_directories(sock_path.parent_path());
+            auto listener = local_listener::listen(sock_path);
+            // The build output changes with every build, and is of no interest
+            auto watcher = std::make_unique<fs_watcher>(roots,
+                                                        std::vector<fs::path>{
+                                                            out_root,
+                                                            opts.project_dir / ".git",
+                                                        });
+            return std::pair{std::move(listener), std::move(watcher)};
+        } catch (const std::system_error& e) {
+            throw_user_error<errc::daemon_failure>("Failed to start the build daemon: {}",
+                                                   e.what());
+        }
+    }();
+
+    dds_log(info,
+            "Serving builds of [{}] on [{}]. Press Ctrl+C to stop.",
+            fs::weakly_canonical(opts.project_dir).string(),
+            sock_path.string());
+
+    daemon_state state{opts};
+    while (!is_cancelled()) {
+        auto conn = listener.accept(500ms);
+        state.apply(watcher->collect());
+        if (conn) {
+            state.serve(*conn);
+        }
+    }
+    dds_log(info, "Stopping the build daemon");
+    return 0;
+}
+
+}  // namespace dds::cli::cmd
@@ -16,6 +16,7 @@ using command = int(const options&);
 command build_deps;
 command build;
 command compile_file;
+command daemon;
 command install_yourself;
 command pkg_create;
 command pkg_get;
@@ -91,6 +92,8 @@ int dispatch_main(const options& opts) noexcept {
         }
         case subcommand::compile_file:
             return cmd::compile_file(opts);
+        case subcommand::daemon:
+            return cmd::daemon(opts);
         case subcommand::build_deps:
             return cmd::build_deps(opts);
         case subcommand::install_yourself:
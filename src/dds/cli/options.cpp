@@ -83,6 +83,45 @@ struct setup {
         .action          = put_into(opts.jobs),
     };
 
+    argument deps_log_arg{
+        .long_spellings = {"deps-log"},
+        .help           = "Record file dependencies in an append-only log file instead of the "
+                          "build database",
+        .nargs          = 0,
+        .action         = store_true(opts.deps_log),
+    };
+
+    argument object_cache_arg{
+        .long_spellings = {"object-cache"},
+        .help           = "Reuse compiled object files from a cache that is shared between builds",
+        .nargs          = 0,
+        .action         = store_true(opts.object_cache),
+    };
+
+    argument object_cache_max_size_arg{
+        .long_spellings = {"object-cache-max-size"},
+        .help           = "The size that the object cache will be trimmed to, in MiB",
+        .valname        = "<mib>",
+        .action         = put_into(opts.object_cache_mib),
+    };
+
+    argument map_path_prefixes_arg{
+        .long_spellings = {"map-path-prefixes"},
+        .help           = "Replace the directories of the project, its dependencies, and the build "
+                          "output with fixed names in compile commands and compiler outputs, so "
+                          "that cached objects can be shared between different directories",
+        .nargs          = 0,
+        .action         = store_true(opts.map_path_prefixes),
+    };
+
+    argument prebuilt_cache_arg{
+        .long_spellings = {"prebuilt-cache"},
+        .help           = "Reuse the outputs of building dependencies from a cache that is shared "
+                          "between projects",
+        .nargs          = 0,
+        .action         = store_true(opts.prebuilt_cache),
+    };
+
     argument repoman_repo_dir_arg{
         .help     = "The directory of the repository to manage",
         .valname  = "<repo-dir>",
@@ -149,6 +188,10 @@ struct setup {
             .name = "compile-file",
             .help = "Compile individual files in the project",
         }));
+        setup_daemon_cmd(group.add_parser({
+            .name = "daemon",
+            .help = "Watch a project for changes, and serve its builds to other dds commands",
+        }));
         setup_build_deps_cmd(group.add_parser({
             .name = "build-deps",
             .help = "Build a set of dependencies and generate a libman index",
@@ -168,23 +211,15 @@ struct setup {
     }
 
     void setup_build_cmd(argument_parser& build_cmd) {
-        build_cmd.add_argument(toolchain_arg.dup());
-        build_cmd.add_argument(project_arg.dup());
+        setup_build_args(build_cmd);
         build_cmd.add_argument({
-            .long_spellings = {"no-tests"},
-            .help           = "Do not build and run project tests",
-            .nargs          = 0,
-            .action         = debate::store_false(opts.build.want_tests),
+            .long_spellings = {"affected-since"},
+            .help           = ""
+                    "Only run the tests that may be affected by the files that have changed since\n"
+                    "the given Git revision, or by the files that are listed in the given file",
+            .valname = "<git-rev|file-list>",
+            .action  = put_into(opts.build.affected_since),
         });
-        build_cmd.add_argument({
-            .long_spellings = {"no-apps"},
-            .help           = "Do not build project applications",
-            .nargs          = 0,
-            .action         = debate::store_false(opts.build.want_apps),
-        });
-        build_cmd.add_argument(no_warn_arg.dup());
-        build_cmd.add_argument(out_arg.dup()).help = "Directory where dds will write build results";
-
         build_cmd.add_argument({
             .long_spellings = {"add-repo"},
             .help           = ""
@@ -201,10 +236,57 @@ struct setup {
             .nargs           = 0,
             .action          = debate::store_true(opts.build.update_repos),
         });
+    }
+
+    void setup_daemon_cmd(argument_parser& daemon_cmd) { setup_build_args(daemon_cmd); }
+
+    /// The arguments that are shared by 'dds build' and 'dds daemon'
+    void setup_build_args(argument_parser& build_cmd) {
+        build_cmd.add_argument(toolchain_arg.dup());
+        build_cmd.add_argument(project_arg.dup());
+        build_cmd.add_argument({
+            .long_spellings = {"no-tests"},
+            .help           = "Do not build and run project tests",
+            .nargs          = 0,
+            .action         = debate::store_false(opts.build.want_tests),
+        });
+        build_cmd.add_argument({
+            .long_spellings = {"rerun-tests"},
+            .help           = "Run all tests, even those that passed before and have not changed",
+            .nargs          = 0,
+            .action         = debate::store_true(opts.build.rerun_tests),
+        });
+        build_cmd.add_argument({
+            .long_spellings = {"test-timeout"},
+            .help           = "The number of seconds that each test process may run before it is "
+                              "killed, or zero to wait forever. The default is 10.",
+            .valname        = "<seconds>",
+            .action         = put_into(opts.build.test_timeout),
+        });
+        build_cmd.add_argument({
+            .long_spellings = {"unity"},
+            .help           = "Compile the source files of each project library together in "
+                              "unity batches of up to the given number of files",
+            .valname        = "<batch-size>",
+            .action         = put_into(opts.build.unity_batch_size),
+        });
+        build_cmd.add_argument({
+            .long_spellings = {"no-apps"},
+            .help           = "Do not build project applications",
+            .nargs          = 0,
+            .action         = debate::store_false(opts.build.want_apps),
+        });
+        build_cmd.add_argument(no_warn_arg.dup());
+        build_cmd.add_argument(out_arg.dup()).help = "Directory where dds will write build results";
         build_cmd.add_argument(lm_index_arg.dup()).help
             = "Path to a libman index file to use for loading project dependencies";
         build_cmd.add_argument(jobs_arg.dup());
         build_cmd.add_argument(tweaks_dir_arg.dup());
+        build_cmd.add_argument(deps_log_arg.dup());
+        build_cmd.add_argument(object_cache_arg.dup());
+        build_cmd.add_argument(object_cache_max_size_arg.dup());
+        build_cmd.add_argument(map_path_prefixes_arg.dup());
+        build_cmd.add_argument(prebuilt_cache_arg.dup());
     }
 
     void setup_compile_file_cmd(argument_parser& compile_file_cmd) noexcept {
@@ -216,6 +298,11 @@ struct setup {
         compile_file_cmd.add_argument(lm_index_arg.dup());
         compile_file_cmd.add_argument(out_arg.dup());
         compile_file_cmd.add_argument(tweaks_dir_arg.dup());
+        compile_file_cmd.add_argument(deps_log_arg.dup());
+        compile_file_cmd.add_argument(object_cache_arg.dup());
+        compile_file_cmd.add_argument(object_cache_max_size_arg.dup());
+        compile_file_cmd.add_argument(map_path_prefixes_arg.dup());
+        compile_file_cmd.add_argument(prebuilt_cache_arg.dup());
         compile_file_cmd.add_argument({
             .help       = "One or more source files to compile",
             .valname    = "<source-files>",
@@ -227,6 +314,11 @@ struct setup {
     void setup_build_deps_cmd(argument_parser& build_deps_cmd) noexcept {
         build_deps_cmd.add_argument(toolchain_arg.dup()).required;
         build_deps_cmd.add_argument(jobs_arg.dup());
+        build_deps_cmd.add_argument(deps_log_arg.dup());
+        build_deps_cmd.add_argument(object_cache_arg.dup());
+        build_deps_cmd.add_argument(object_cache_max_size_arg.dup());
+        build_deps_cmd.add_argument(map_path_prefixes_arg.dup());
+        build_deps_cmd.add_argument(prebuilt_cache_arg.dup());
         build_deps_cmd.add_argument(out_arg.dup());
         build_deps_cmd.add_argument(lm_index_arg.dup()).help
             = "Destination path for the generated libman index file";
@@ -23,6 +23,7 @@ enum class subcommand {
     _none_,
     build,
     compile_file,
+    daemon,
     build_deps,
     pkg,
     repoman,
@@ -110,6 +111,15 @@ struct options {
     bool disable_warnings = false;
     // Compile and build commands' `--jobs` parameter
     int jobs = 0;
+    // Compile and build commands' `--deps-log` flag
+    bool deps_log = false;
+    // Compile and build commands' `--object-cache` flag and `--object-cache-max-size` (in MiB)
+    bool object_cache     = false;
+    int  object_cache_mib = 0;
+    // Compile and build commands' `--map-path-prefixes` flag
+    bool map_path_prefixes = false;
+    // Compile and build commands' `--prebuilt-cache` flag
+    bool prebuilt_cache = false;
     // Compile and build commands' `--toolchain` option:
     opt_string toolchain;
     opt_path   out_path;
@@ -134,8 +144,12 @@ struct options {
      * @brief Parameters specific to 'dds build'
      */
     struct {
-        bool                want_tests = true;
-        bool                want_apps  = true;
+        bool                want_tests  = true;
+        bool                want_apps   = true;
+        bool                rerun_tests = false;
+        opt_string          affected_since;
+        int                 test_timeout     = 10;
+        int                 unity_batch_size = 0;
         opt_path            lm_index;
         std::vector<string> add_repos;
         bool                update_repos = false;
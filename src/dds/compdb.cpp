@@ -11,7 +11,7 @@ using namespace dds;
 void dds::generate_compdb(const build_plan& plan, build_env_ref env) {
     auto compdb = nlohmann::json::array();
 
-    for (const compile_file_plan& cf : iter_compilations(plan)) {
+    auto add_entry = [&](const compile_file_plan& cf) {
         auto cmd_info = cf.generate_compile_command(env);
         auto entry    = nlohmann::json::object({
             {"directory", env.output_root.string()},
@@ -19,6 +19,17 @@ void dds::generate_compdb(const build_plan& plan, build_env_ref env) {
             {"file", cf.source_path().string()},
         });
         compdb.push_back(std::move(entry));
+    };
+
+    for (const compile_file_plan& cf : iter_compilations(plan)) {
+        if (!cf.is_unity()) {
+            add_entry(cf);
+            continue;
+        }
+        // Tools expect an entry for each source file, rather than for the generated batch
+        for (auto& member : cf.unity_member_plans()) {
+            add_entry(member);
+        }
     }
 
     fs::create_directories(env.output_root);
@@ -13,6 +13,8 @@
 #include <range/v3/range/conversion.hpp>
 #include <range/v3/view/transform.hpp>
 
+#include <unordered_map>
+
 using namespace dds;
 
 namespace nsql = neo::sqlite3;
@@ -29,6 +31,8 @@ void migrate_1(nsql::database& db) {
         DROP TABLE IF EXISTS dds_files;
         DROP TABLE IF EXISTS dds_compile_deps;
         DROP TABLE IF EXISTS dds_compilations;
+        DROP TABLE IF EXISTS dds_test_passes;
+        DROP TABLE IF EXISTS dds_test_case_durations;
         DROP TABLE IF EXISTS dds_source_files;
         CREATE TABLE dds_source_files (
             file_id INTEGER PRIMARY KEY,
@@ -54,6 +58,21 @@ void migrate_1(nsql::database& db) {
             input_mtime INTEGER NOT NULL,
             UNIQUE(input_file_id, output_file_id)
         );
+        CREATE TABLE dds_test_passes (
+            file_id
+                INTEGER PRIMARY KEY
+                REFERENCES dds_source_files(file_id),
+            exe_digest TEXT NOT NULL,
+            duration INTEGER NOT NULL
+        );
+        CREATE TABLE dds_test_case_durations (
+            file_id
+                INTEGER NOT NULL
+                REFERENCES dds_source_files(file_id),
+            name TEXT NOT NULL,
+            duration INTEGER NOT NULL,
+            UNIQUE(file_id, name)
+        );
     )");
 }
 
@@ -70,7 +89,7 @@ void ensure_migrated(nsql::database& db) {
     auto version_st    = db.prepare("SELECT version FROM dds_meta_1");
     auto [version_str] = nsql::unpack_single<std::string>(version_st);
 
-    const auto cur_version = "alpha-5"sv;
+    const auto cur_version = "alpha-7"sv;
     if (cur_version != version_str) {
         if (!version_str.empty()) {
             dds_log(info, "NOTE: A prior version of the project build database was found.");
@@ -229,3 +248,125 @@ std::optional<completed_compilation> database::command_of(path_ref file_) const
     auto& [cmd, out, dur] = *opt_res;
     return completed_compilation{cmd, out, std::chrono::milliseconds(dur)};
 }
+
+std::vector<recorded_compilation> database::all_compilations() const {
+    std::vector<recorded_compilation>             ret;
+    std::unordered_map<std::int64_t, std::size_t> index_of_file;
+
+    auto& cmd_st = _stmt_cache(R"(
+        SELECT file_id, path, command, output, avg_duration
+          FROM dds_compilations
+          JOIN dds_source_files USING (file_id)
+    )"_sql);
+    cmd_st.reset();
+    for (auto [file_id, path, cmd, out, dur] :
+         nsql::iter_tuples<std::int64_t, std::string, std::string, std::string, std::int64_t>(
+             cmd_st)) {
+        index_of_file.emplace(file_id, ret.size());
+        ret.push_back(recorded_compilation{
+            .output_path = path,
+            .command     = completed_compilation{cmd, out, std::chrono::milliseconds(dur)},
+            .inputs      = {},
+        });
+    }
+
+    auto& deps_st = _stmt_cache(R"(
+        SELECT output_file_id, path, input_mtime
+          FROM dds_compile_deps
+          JOIN dds_source_files ON input_file_id = file_id
+    )"_sql);
+    deps_st.reset();
+    for (auto [output_id, path, mtime] :
+         nsql::iter_tuples<std::int64_t, std::string, std::int64_t>(deps_st)) {
+        auto found = index_of_file.find(output_id);
+        if (found == index_of_file.end()) {
+            // Inputs of a file that has no recorded command. Not useful.
+            continue;
+        }
+        ret[found->second].inputs.push_back(
+            input_file_info{path, fs::file_time_type(fs::file_time_type::duration(mtime))});
+    }
+    return ret;
+}
+
+void database::record_test_pass(const recorded_test_pass& pass) {
+    auto  file_id = _record_file(pass.exe_path);
+    auto& st      = _stmt_cache(R"(
+        INSERT OR REPLACE INTO dds_test_passes (file_id, exe_digest, duration)
+        VALUES (?, ?, ?)
+    )"_sql);
+    nsql::exec(st,
+               std::forward_as_tuple(file_id,
+                                     std::string_view(pass.exe_digest),
+                                     pass.duration.count()));
+}
+
+void database::forget_test_result(path_ref exe) {
+    auto& st = _stmt_cache(R"(
+        WITH id_to_delete AS (
+            SELECT file_id
+            FROM dds_source_files
+            WHERE path = ?
+        )
+        DELETE FROM dds_test_passes
+         WHERE file_id IN id_to_delete
+    )"_sql);
+    nsql::exec(st, std::forward_as_tuple(fs::weakly_canonical(exe).generic_string()));
+}
+
+std::vector<recorded_test_pass> database::all_test_passes() const {
+    auto& st = _stmt_cache(R"(
+        SELECT path, exe_digest, duration
+          FROM dds_test_passes
+          JOIN dds_source_files USING (file_id)
+    )"_sql);
+    st.reset();
+    std::vector<recorded_test_pass> ret;
+    for (auto [path, digest, dur] :
+         nsql::iter_tuples<std::string, std::string, std::int64_t>(st)) {
+        ret.push_back(recorded_test_pass{
+            .exe_path   = path,
+            .exe_digest = digest,
+            .duration   = std::chrono::microseconds(dur),
+        });
+    }
+    return ret;
+}
+
+void database::record_test_case_durations(path_ref                               exe,
+                                          const std::vector<test_case_duration>& cases) {
+    auto file_id = _record_file(exe);
+    nsql::exec(_stmt_cache(R"(
+                    DELETE FROM dds_test_case_durations
+                     WHERE file_id = ?
+                  )"_sql),
+               std::forward_as_tuple(file_id));
+    auto& st = _stmt_cache(R"(
+        INSERT OR REPLACE INTO dds_test_case_durations (file_id, name, duration)
+        VALUES (?, ?, ?)
+    )"_sql);
+    for (auto& tc : cases) {
+        nsql::exec(st,
+                   std::forward_as_tuple(file_id, std::string_view(tc.name), tc.duration.count()));
+    }
+}
+
+std::vector<test_case_duration> database::test_case_durations_of(path_ref exe) const {
+    auto& st = _stmt_cache(R"(
+        WITH file AS (
+            SELECT file_id
+              FROM dds_source_files
+             WHERE path = ?
+        )
+        SELECT name, duration
+          FROM dds_test_case_durations
+         WHERE file_id IN file
+    )"_sql);
+    st.reset();
+    st.bindings()[1] = fs::weakly_canonical(exe).generic_string();
+    std::vector<test_case_duration> ret;
+    for (auto [name, dur] : nsql::iter_tuples<std::string, std::int64_t>(st)) {
+        ret.push_back(test_case_duration{name, std::chrono::microseconds(dur)});
+    }
+    return ret;
+}
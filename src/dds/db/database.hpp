@@ -12,6 +12,7 @@
 #include <optional>
 #include <shared_mutex>
 #include <string_view>
+#include <vector>
 
 namespace dds {
 
@@ -27,6 +28,36 @@ struct input_file_info {
     fs::file_time_type last_mtime;
 };
 
+/**
+ * A compilation that has been recorded in the database, along with its recorded inputs.
+ */
+struct recorded_compilation {
+    /// The canonical path of the output file, as stored in the database
+    std::string                  output_path;
+    completed_compilation        command;
+    std::vector<input_file_info> inputs;
+};
+
+/**
+ * A passing run of a test executable that has been recorded in the database.
+ */
+struct recorded_test_pass {
+    /// The path of the test executable
+    fs::path exe_path;
+    /// The SHA-256 digest of the content of the executable that passed
+    std::string exe_digest;
+    // The amount of time that the test took to run
+    std::chrono::microseconds duration;
+};
+
+/**
+ * The amount of time that a single test case of a test executable took to run
+ */
+struct test_case_duration {
+    std::string               name;
+    std::chrono::microseconds duration;
+};
+
 class database {
     neo::sqlite3::database                _db;
     mutable neo::sqlite3::statement_cache _stmt_cache{_db};
@@ -50,6 +81,26 @@ public:
 
     std::optional<std::vector<input_file_info>> inputs_of(path_ref file) const;
     std::optional<completed_compilation>        command_of(path_ref file) const;
+
+    /**
+     * Load every recorded compilation and its inputs at once. This is much faster than querying
+     * each output individually with `command_of()` and `inputs_of()` when checking many files.
+     */
+    std::vector<recorded_compilation> all_compilations() const;
+
+    void record_test_pass(const recorded_test_pass& pass);
+    void forget_test_result(path_ref exe);
+
+    /**
+     * Load every recorded passing test run
+     */
+    std::vector<recorded_test_pass> all_test_passes() const;
+
+    /**
+     * Replace the recorded test case durations of the given test executable
+     */
+    void record_test_case_durations(path_ref exe, const std::vector<test_case_duration>& cases);
+    std::vector<test_case_duration> test_case_durations_of(path_ref exe) const;
 };
 
 }  // namespace dds
\ No newline at end of file
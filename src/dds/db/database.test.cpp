@@ -5,3 +5,32 @@
 using namespace std::literals;
 
 TEST_CASE("Create a database") { auto db = dds::database::open(":memory:"s); }
+
+TEST_CASE("Record passing tests") {
+    auto db = dds::database::open(":memory:"s);
+    CHECK(db.all_test_passes().empty());
+
+    db.record_test_pass({"/tmp/foo.test", "abc", std::chrono::microseconds(12)});
+    db.record_test_pass({"/tmp/foo.test", "def", std::chrono::microseconds(34)});
+    auto passes = db.all_test_passes();
+    REQUIRE(passes.size() == 1);
+    CHECK(passes[0].exe_digest == "def");
+    CHECK(passes[0].duration == std::chrono::microseconds(34));
+
+    db.forget_test_result("/tmp/foo.test");
+    CHECK(db.all_test_passes().empty());
+}
+
+TEST_CASE("Record test case durations") {
+    auto db = dds::database::open(":memory:"s);
+    CHECK(db.test_case_durations_of("/tmp/foo.test").empty());
+
+    db.record_test_case_durations("/tmp/foo.test",
+                                  {{"first", std::chrono::microseconds(12)},
+                                   {"second", std::chrono::microseconds(34)}});
+    db.record_test_case_durations("/tmp/foo.test", {{"second", std::chrono::microseconds(56)}});
+    auto cases = db.test_case_durations_of("/tmp/foo.test");
+    REQUIRE(cases.size() == 1);
+    CHECK(cases[0].name == "second");
+    CHECK(cases[0].duration == std::chrono::microseconds(56));
+}
@@ -37,6 +37,8 @@ std::string error_url_suffix(dds::errc ec) noexcept {
         return "no-pkg-remote.html";
     case errc::git_clone_failure:
         return "git-clone-failure.html";
+    case errc::git_diff_failure:
+        return "git-diff-failure.html";
     case errc::invalid_remote_url:
         return "invalid-remote-url.html";
     case errc::http_download_failure:
@@ -71,8 +73,12 @@ std::string error_url_suffix(dds::errc ec) noexcept {
         return "dup-lib-name.html";
     case errc::unknown_usage_name:
         return "unknown-usage.html";
+    case errc::usage_cycle:
+        return "usage-cycle.html";
     case errc::template_error:
         return "template-error.html";
+    case errc::daemon_failure:
+        return "daemon-failure.html";
     case errc::none:
         break;
     }
@@ -174,6 +180,12 @@ There is no package remote with the given name
 dds tried to clone a repository using Git, but the clone operation failed.
 There are a variety of possible causes. It is best to check the output from
 Git in diagnosing this failure.
+)";
+    case errc::git_diff_failure:
+        return R"(
+dds tried to ask Git for the files that have changed since a revision, but the
+Git command failed. Check that the project is within a Git repository and that
+the given revision exists. Refer to the output from Git for more details.
 )";
     case errc::invalid_remote_url:
         return R"(The given package/remote URL is invalid)";
@@ -254,9 +266,22 @@ A `uses` or `links` field for a library specifies a library of an unknown name.
 Check your spelling, and check that the package containing the library is
 available, either from the `package.json5` or from the `INDEX.lmi` that was used
 for the build.
+)";
+    case errc::usage_cycle:
+        return R"(
+The `uses` and `links` fields of libraries form a cycle, in which a library
+depends, directly or indirectly, upon itself. The order in which such libraries
+are linked cannot be determined. The error message names the libraries in the
+cycle. Remove one of the requirements to break it.
 )";
     case errc::template_error:
         return R"(dds encountered a problem while rendering a file template and cannot continue.)";
+    case errc::daemon_failure:
+        return R"(
+The build daemon could not watch the project for changes, or could not listen
+for build requests. The daemon is only supported on Linux. Only one daemon may
+serve each build output directory at a time.
+)";
     case errc::none:
         break;
     }
@@ -294,6 +319,8 @@ std::string_view dds::default_error_string(dds::errc ec) noexcept {
         return "Tne named remote does not exist." BUG_STRING_SUFFIX;
     case errc::git_clone_failure:
         return "A git-clone operation failed.";
+    case errc::git_diff_failure:
+        return "Failed to find the files that have changed since a Git revision.";
     case errc::invalid_remote_url:
         return "The given package/remote URL is not valid";
     case errc::http_download_failure:
@@ -330,8 +357,12 @@ std::string_view dds::default_error_string(dds::errc ec) noexcept {
         return "More than one library has claimed the same name.";
     case errc::unknown_usage_name:
         return "A `uses` or `links` field names a library that isn't recognized.";
+    case errc::usage_cycle:
+        return "Libraries use or link each other in a cycle.";
     case errc::template_error:
         return "There was an error while rendering a template file." BUG_STRING_SUFFIX;
+    case errc::daemon_failure:
+        return "The build daemon failed to start." BUG_STRING_SUFFIX;
     case errc::none:
         break;
     }
@@ -24,6 +24,7 @@ enum class errc {
     no_catalog_remote_info,
 
     git_clone_failure,
+    git_diff_failure,
     invalid_remote_url,
     http_download_failure,
     invalid_repo_transform,
@@ -42,11 +43,14 @@ enum class errc {
     dependency_resolve_failure,
     dup_lib_name,
     unknown_usage_name,
+    usage_cycle,
 
     invalid_lib_filesystem,
     invalid_pkg_filesystem,
 
     template_error,
+
+    daemon_failure,
 };
 
 std::string      error_reference_of(errc) noexcept;
@@ -1,5 +1,7 @@
 #include "./proc.hpp"
 
+#include <dds/util/env.hpp>
+#include <dds/util/fs.hpp>
 #include <dds/util/string.hpp>
 
 #include <algorithm>
@@ -15,6 +17,32 @@ bool dds::needs_quoting(std::string_view s) {
     return !all_okay;
 }
 
+std::optional<fs::path> dds::find_program(std::string_view program) {
+    fs::path prog{program};
+    if (prog.has_parent_path()) {
+        return fs::exists(prog) ? std::optional(fs::absolute(prog)) : std::nullopt;
+    }
+#ifdef _WIN32
+    const auto path_sep = ";";
+    if (!prog.has_extension()) {
+        prog += ".exe";
+    }
+#else
+    const auto path_sep = ":";
+#endif
+    auto path_env = dds::getenv("PATH").value_or("");
+    for (auto dir : split_view(path_env, path_sep)) {
+        if (dir.empty()) {
+            continue;
+        }
+        auto cand = fs::path(dir) / prog;
+        if (fs::is_regular_file(cand)) {
+            return cand;
+        }
+    }
+    return std::nullopt;
+}
+
 std::string dds::quote_argument(std::string_view s) {
     if (!needs_quoting(s)) {
         return std::string(s);
@@ -2,6 +2,7 @@
 
 #include <chrono>
 #include <filesystem>
+#include <functional>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -11,6 +12,12 @@ namespace dds {
 
 bool needs_quoting(std::string_view);
 
+/**
+ * Find the executable that will be run for the given program name, in the same way as the
+ * operating system would search the PATH. Returns `nullopt` if there is no such executable.
+ */
+std::optional<std::filesystem::path> find_program(std::string_view program);
+
 std::string quote_argument(std::string_view);
 
 template <typename Container>
@@ -34,6 +41,16 @@ struct proc_result {
     bool okay() const noexcept { return retc == 0 && signal == 0; }
 };
 
+/**
+ * The method by which a subprocess is spawned. This only has an effect on POSIX systems.
+ */
+enum class proc_spawn_method {
+    /// Use posix_spawn() when possible, falling back to fork() when it cannot honor the options
+    automatic,
+    /// Always use fork() and exec()
+    fork,
+};
+
 struct proc_options {
     std::vector<std::string> command;
 
@@ -43,10 +60,27 @@ struct proc_options {
      * Timeout for the subprocess, in milliseconds. If zero, will wait forever
      */
     std::optional<std::chrono::milliseconds> timeout = std::nullopt;
+
+    proc_spawn_method spawn_method = proc_spawn_method::automatic;
 };
 
 proc_result run_proc(const proc_options& opts);
 
+/**
+ * Spawn a subprocess without waiting for it to complete. The output and exit status of the process
+ * are collected in the background, and `on_done` is invoked with the result once the process has
+ * exited.
+ *
+ * On POSIX systems, all subprocesses are tracked by a single supervisor thread, and `on_done` is
+ * invoked on that thread: It must not throw, and should not block for long. It will usually be
+ * used to hand the result off to other work, such as a `job_graph` job.
+ *
+ * If the executable cannot be found, `on_done` is invoked immediately on the calling thread with a
+ * failed result. If the process cannot be spawned for any other reason, this throws without
+ * invoking `on_done`.
+ */
+void run_proc_async(const proc_options& opts, std::function<void(proc_result)> on_done);
+
 inline proc_result run_proc(std::vector<std::string> args) {
     return run_proc(proc_options{.command = std::move(args)});
 }
@@ -5,16 +5,53 @@
 #include <dds/util/log.hpp>
 #include <dds/util/signal.hpp>
 
+#include <neo/assert.hpp>
+#include <neo/event.hpp>
+
+#include <fcntl.h>
 #include <poll.h>
 #include <signal.h>
+#include <spawn.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#if __linux__
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cerrno>
-#include <deque>
-#include <iostream>
+#include <cstring>
+#include <future>
+#include <iterator>
+#include <mutex>
 #include <system_error>
+#include <thread>
+
+// posix_spawn_file_actions_addchdir_np() is required to spawn a child in a different directory
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#define DDS_HAVE_SPAWN_ADDCHDIR 1
+#else
+#define DDS_HAVE_SPAWN_ADDCHDIR 0
+#endif
+
+// pipe2() creates a pipe with both ends already close-on-exec
+#if __linux__ || __FreeBSD__
+#define DDS_HAVE_PIPE2 1
+#else
+#define DDS_HAVE_PIPE2 0
+#endif
+
+// A pidfd becomes readable when its process exits, so it can be polled alongside pipes (Linux 5.3+)
+#if __linux__ && defined(SYS_pidfd_open)
+#define DDS_HAVE_PIDFD 1
+#else
+#define DDS_HAVE_PIDFD 0
+#endif
+
+extern char** environ;
 
 using namespace dds;
 
@@ -26,20 +63,80 @@ void check_rc(bool b, std::string_view s) {
     }
 }
 
-::pid_t spawn_child(const proc_options& opts, int stdout_pipe, int close_me) noexcept {
-    // We must allocate BEFORE fork(), since the CRT might stumble with malloc()-related locks that
-    // are held during the fork().
-    std::vector<const char*> strings;
-    strings.reserve(opts.command.size() + 1);
-    for (auto& s : opts.command) {
-        strings.push_back(s.data());
+/**
+ * Without pipe2(), a new pipe is inherited by any child that is spawned before we can mark it
+ * close-on-exec. In that case, pipe creation and spawning both happen while holding this mutex.
+ */
+std::mutex spawn_mutex;
+
+/**
+ * Returns a lock that must be held while creating pipes and spawning children. Does not lock
+ * anything if pipes are created close-on-exec atomically.
+ */
+std::unique_lock<std::mutex> lock_for_spawn() {
+    if (DDS_HAVE_PIPE2) {
+        return std::unique_lock<std::mutex>{};
     }
-    strings.push_back(nullptr);
+    return std::unique_lock<std::mutex>{spawn_mutex};
+}
 
-    std::string workdir = opts.cwd.value_or(fs::current_path()).string();
-    auto        not_found_err
+/**
+ * Create a pipe with both ends set close-on-exec. The caller must hold lock_for_spawn().
+ */
+int make_cloexec_pipe(int (&fds)[2]) noexcept {
+#if DDS_HAVE_PIPE2
+    return ::pipe2(fds, O_CLOEXEC);
+#else
+    auto rc = ::pipe(fds);
+    if (rc == 0) {
+        ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    }
+    return rc;
+#endif
+}
+
+/**
+ * Open a pidfd for the given child. Returns -1 if pidfds are not supported.
+ */
+int open_pidfd([[maybe_unused]] ::pid_t pid) noexcept {
+#if DDS_HAVE_PIDFD
+    // pidfd_open() always sets close-on-exec on the new file descriptor
+    return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+#else
+    return -1;
+#endif
+}
+
+/**
+ * The write end of the supervisor's wakeup pipe, for use by the SIGCHLD handler
+ */
+std::atomic<int> sigchld_wake_fd{-1};
+
+extern "C" void on_sigchld(int) {
+    auto saved_errno = errno;
+    auto fd          = sigchld_wake_fd.load();
+    if (fd >= 0) {
+        char c = 0;
+
+        [[maybe_unused]] auto rc = ::write(fd, &c, 1);
+    }
+    errno = saved_errno;
+}
+
+/**
+ * Spawn a child using fork() and execvp(). This is the most flexible method, but fork() must copy
+ * the page tables of the whole dds process, which becomes slower as dds uses more memory.
+ */
+::pid_t fork_child(const std::vector<const char*>& argv,
+                   const std::string&              workdir,
+                   int                             stdout_pipe,
+                   int                             close_me) noexcept {
+    // We must allocate BEFORE fork(), since the CRT might stumble with malloc()-related locks that
+    // are held during the fork().
+    auto not_found_err
         = fmt::format("[dds child executor] The requested executable [{}] could not be found.",
-                      strings[0]);
+                      argv[0]);
 
     auto child_pid = ::fork();
     if (child_pid != 0) {
@@ -51,10 +148,12 @@ void check_rc(bool b, std::string_view s) {
     check_rc(rc != -1, "Failed to dup2 stdout");
     rc = dup2(stdout_pipe, STDERR_FILENO);
     check_rc(rc != -1, "Failed to dup2 stderr");
-    rc = ::chdir(workdir.data());
-    check_rc(rc != -1, "Failed to chdir() for subprocess");
+    if (!workdir.empty()) {
+        rc = ::chdir(workdir.data());
+        check_rc(rc != -1, "Failed to chdir() for subprocess");
+    }
 
-    ::execvp(strings[0], (char* const*)strings.data());
+    ::execvp(argv[0], (char* const*)argv.data());
 
     if (errno == ENOENT) {
         std::fputs(not_found_err.c_str(), stderr);
@@ -67,72 +166,368 @@ void check_rc(bool b, std::string_view s) {
     std::_Exit(-1);
 }
 
-}  // namespace
+/**
+ * Spawn a child using posix_spawnp(). The C library is able to create the child without copying
+ * the address space of the parent (e.g. using vfork() or clone(CLONE_VM)), so this is much cheaper
+ * than fork() for a large parent process.
+ *
+ * Returns -1 and sets errno if the child could not be spawned, including if the executable could
+ * not be found.
+ */
+::pid_t posix_spawn_child(const std::vector<const char*>& argv,
+                          const std::string&              workdir,
+                          int                             stdout_pipe,
+                          int                             close_me) noexcept {
+    ::posix_spawn_file_actions_t actions;
+    auto                         rc = ::posix_spawn_file_actions_init(&actions);
+    if (rc != 0) {
+        errno = rc;
+        return -1;
+    }
+    ::posix_spawn_file_actions_addclose(&actions, close_me);
+    ::posix_spawn_file_actions_adddup2(&actions, stdout_pipe, STDOUT_FILENO);
+    ::posix_spawn_file_actions_adddup2(&actions, stdout_pipe, STDERR_FILENO);
+#if DDS_HAVE_SPAWN_ADDCHDIR
+    if (!workdir.empty()) {
+        ::posix_spawn_file_actions_addchdir_np(&actions, workdir.data());
+    }
+#else
+    neo_assert(expects,
+               workdir.empty(),
+               "posix_spawn() cannot change the working directory on this platform",
+               workdir);
+#endif
 
-proc_result dds::run_proc(const proc_options& opts) {
-    dds_log(debug, "Spawning subprocess: {}", quote_command(opts.command));
-    int  stdio_pipe[2] = {};
-    auto rc            = ::pipe(stdio_pipe);
-    check_rc(rc == 0, "Create stdio pipe for subprocess");
+    ::pid_t child_pid = 0;
 
-    int read_pipe  = stdio_pipe[0];
-    int write_pipe = stdio_pipe[1];
+    rc = ::posix_spawnp(&child_pid, argv[0], &actions, nullptr, (char* const*)argv.data(), environ);
+    ::posix_spawn_file_actions_destroy(&actions);
+    if (rc != 0) {
+        errno = rc;
+        return -1;
+    }
+    return child_pid;
+}
 
-    auto child = spawn_child(opts, write_pipe, read_pipe);
+/**
+ * Spawn a child process for the given options, with its stdout and stderr redirected to
+ * `stdout_pipe`. Returns -1 and sets errno if the child could not be spawned.
+ */
+::pid_t spawn_child(const proc_options& opts, int stdout_pipe, int close_me) noexcept {
+    std::vector<const char*> argv;
+    argv.reserve(opts.command.size() + 1);
+    for (auto& s : opts.command) {
+        argv.push_back(s.data());
+    }
+    argv.push_back(nullptr);
 
-    ::close(write_pipe);
+    std::string workdir = opts.cwd ? opts.cwd->string() : "";
+
+    auto use_fork = opts.spawn_method == proc_spawn_method::fork;
+    if (!DDS_HAVE_SPAWN_ADDCHDIR && !workdir.empty()) {
+        // We can only change the working directory of the child after fork()
+        use_fork = true;
+    }
+    if (use_fork) {
+        return fork_child(argv, workdir, stdout_pipe, close_me);
+    }
+    return posix_spawn_child(argv, workdir, stdout_pipe, close_me);
+}
 
-    pollfd stdio_fd;
-    stdio_fd.fd     = read_pipe;
-    stdio_fd.events = POLLIN;
+/**
+ * A running subprocess that is tracked by the supervisor
+ */
+struct child_proc {
+    ::pid_t pid;
+    // The read end of the child's stdio pipe. Set to -1 once the pipe reaches end-of-file
+    int read_fd;
+    // A pidfd for the child, polled once its output has closed. -1 if pidfds are not available,
+    // in which case the supervisor is woken by SIGCHLD instead
+    int                                                  pid_fd;
+    std::string                                          quoted_command;
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    proc_result                                          result;
+    std::function<void(proc_result)>                     on_done;
+};
 
-    proc_result res;
+/**
+ * Tracks every running subprocess from a single thread. The thread polls the stdio pipes of all
+ * children at once, accumulating their output, and reaps each child after its pipe is closed.
+ * New children are handed over through `add()`, which wakes the thread using a self-pipe.
+ *
+ * A child that has closed its output is waited on by polling its pidfd. Where pidfds are not
+ * available, a SIGCHLD handler writes to the self-pipe when any child exits.
+ */
+class supervisor {
+    std::mutex              _mut;
+    std::vector<child_proc> _incoming;
+    bool                    _stop = false;
+    int                     _wake_read;
+    int                     _wake_write;
+    std::thread             _thread;
+    std::once_flag          _sigchld_once;
 
-    using namespace std::chrono_literals;
+    void _wake() noexcept {
+        char c = 0;
+        // If the pipe is full, the thread is already due to wake up. Nothing to worry about.
+        [[maybe_unused]] auto rc = ::write(_wake_write, &c, 1);
+    }
 
-    /// Quirk: We _could_ just use opts.timeout.value_or, but it seems like something
-    /// is weird in GCC 9's data flow analysis and it will warn that `timeout` is
-    /// used uninitialized when its value is passed to poll() ??
-    auto timeout = -1ms;
-    if (opts.timeout) {
-        timeout = *opts.timeout;
+    void _run() noexcept;
+
+    void _watch_sigchld() {
+        std::call_once(_sigchld_once, [&] {
+            sigchld_wake_fd.store(_wake_write);
+            struct ::sigaction act = {};
+            act.sa_handler         = on_sigchld;
+            act.sa_flags           = SA_RESTART | SA_NOCLDSTOP;
+            ::sigemptyset(&act.sa_mask);
+            auto rc = ::sigaction(SIGCHLD, &act, nullptr);
+            check_rc(rc == 0, "Install SIGCHLD handler for the subprocess supervisor");
+        });
     }
+
+public:
+    supervisor() {
+        int pipes[2] = {};
+        {
+            auto lk = lock_for_spawn();
+            auto rc = make_cloexec_pipe(pipes);
+            check_rc(rc == 0, "Create subprocess supervisor wakeup pipe");
+        }
+        _wake_read  = pipes[0];
+        _wake_write = pipes[1];
+        for (auto fd : pipes) {
+            ::fcntl(fd, F_SETFL, O_NONBLOCK);
+        }
+        _thread = std::thread([this] { _run(); });
+    }
+
+    ~supervisor() {
+        {
+            std::scoped_lock lk{_mut};
+            _stop = true;
+        }
+        _wake();
+        _thread.join();
+        sigchld_wake_fd.store(-1);
+        ::close(_wake_read);
+        ::close(_wake_write);
+    }
+
+    static supervisor& get() {
+        static supervisor inst;
+        return inst;
+    }
+
+    void add(child_proc child) {
+        if (child.pid_fd < 0) {
+            // Installed before the child is handed over, so its exit cannot be missed
+            _watch_sigchld();
+        }
+        {
+            std::scoped_lock lk{_mut};
+            _incoming.push_back(std::move(child));
+        }
+        _wake();
+    }
+};
+
+void supervisor::_run() noexcept {
+    using namespace std::chrono_literals;
+    using clock = std::chrono::steady_clock;
+
+    auto log_subscr = neo::subscribe(&log::ev_log::print);
+
+    std::vector<child_proc> children;
+    std::vector<::pollfd>   pollfds;
+    // The children that correspond to the pollfds, after the wakeup pipe
+    std::vector<child_proc*> polled_children;
+    // A single read buffer, reused for every child
+    std::vector<char> buffer(64 * 1024);
+
     while (true) {
-        rc = ::poll(&stdio_fd, 1, static_cast<int>(timeout.count()));
-        if (rc && errno == EINTR) {
-            errno = 0;
-            continue;
+        {
+            std::scoped_lock lk{_mut};
+            if (_stop) {
+                break;
+            }
+            std::move(_incoming.begin(), _incoming.end(), std::back_inserter(children));
+            _incoming.clear();
         }
-        if (rc == 0) {
-            // Timeout!
-            ::kill(child, SIGINT);
-            timeout       = -1ms;
-            res.timed_out = true;
-            dds_log(debug, "Subprocess [{}] timed out", quote_command(opts.command));
+
+        pollfds.clear();
+        polled_children.clear();
+        pollfds.push_back({.fd = _wake_read, .events = POLLIN, .revents = 0});
+
+        auto now        = clock::now();
+        auto wait_until = std::optional<clock::time_point>{};
+        for (auto& child : children) {
+            if (child.read_fd >= 0) {
+                pollfds.push_back({.fd = child.read_fd, .events = POLLIN, .revents = 0});
+                polled_children.push_back(&child);
+            } else if (child.pid_fd >= 0) {
+                // The child closed its output, but may not have exited yet
+                pollfds.push_back({.fd = child.pid_fd, .events = POLLIN, .revents = 0});
+                polled_children.push_back(&child);
+            }
+            if (child.deadline && (!wait_until || *child.deadline < *wait_until)) {
+                wait_until = child.deadline;
+            }
+        }
+
+        int timeout_ms = -1;
+        if (wait_until) {
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(*wait_until - now);
+            timeout_ms     = static_cast<int>(std::max(remaining, 0ms).count());
+        }
+
+        auto rc = ::poll(pollfds.data(), pollfds.size(), timeout_ms);
+        if (rc < 0 && errno == EINTR) {
             continue;
         }
-        std::string buffer;
-        buffer.resize(1024);
-        auto nread = ::read(stdio_fd.fd, buffer.data(), buffer.size());
-        if (nread == 0) {
-            break;
+        neo_assert_always(invariant,
+                          rc >= 0,
+                          "poll() failed in the subprocess supervisor",
+                          std::strerror(errno));
+
+        if (pollfds[0].revents) {
+            // Drain the wakeup pipe. We'll pick up any new children at the top of the loop.
+            while (::read(_wake_read, buffer.data(), buffer.size()) > 0) {
+            }
+        }
+
+        for (std::size_t idx = 1; idx < pollfds.size(); ++idx) {
+            if (pollfds[idx].revents == 0) {
+                continue;
+            }
+            auto& child = *polled_children[idx - 1];
+            if (child.read_fd < 0) {
+                // The child has exited. It is reaped below.
+                continue;
+            }
+            auto nread = ::read(child.read_fd, buffer.data(), buffer.size());
+            if (nread < 0 && (errno == EINTR || errno == EAGAIN)) {
+                continue;
+            }
+            if (nread > 0) {
+                child.result.output.append(buffer.data(), static_cast<std::size_t>(nread));
+                continue;
+            }
+            if (nread < 0) {
+                dds_log(error,
+                        "Failed to read the output of subprocess [{}]: {}",
+                        child.quoted_command,
+                        std::strerror(errno));
+            }
+            ::close(child.read_fd);
+            child.read_fd = -1;
         }
-        check_rc(nread > 0, "Failed in read()");
-        res.output.append(buffer.begin(), buffer.begin() + nread);
+
+        now = clock::now();
+        for (auto& child : children) {
+            if (child.deadline && *child.deadline <= now) {
+                // Timeout!
+                ::kill(child.pid, SIGINT);
+                child.deadline         = std::nullopt;
+                child.result.timed_out = true;
+                dds_log(debug, "Subprocess [{}] timed out", child.quoted_command);
+            }
+        }
+
+        // Reap the children that have closed their output and exited
+        auto new_end = std::remove_if(children.begin(), children.end(), [&](child_proc& child) {
+            if (child.read_fd >= 0) {
+                return false;
+            }
+            int  status = 0;
+            auto wrc    = ::waitpid(child.pid, &status, WNOHANG);
+            if (wrc == 0 || (wrc < 0 && errno == EINTR)) {
+                // Not finished yet
+                return false;
+            }
+            if (wrc < 0) {
+                dds_log(error,
+                        "Failed to wait on subprocess [{}]: {}",
+                        child.quoted_command,
+                        std::strerror(errno));
+                child.result.retc = -1;
+            } else if (WIFEXITED(status)) {
+                child.result.retc = WEXITSTATUS(status);
+            } else if (WIFSIGNALED(status)) {
+                child.result.signal = WTERMSIG(status);
+            }
+            if (child.pid_fd >= 0) {
+                ::close(child.pid_fd);
+            }
+            child.on_done(std::move(child.result));
+            return true;
+        });
+        children.erase(new_end, children.end());
     }
+}
+
+}  // namespace
+
+void dds::run_proc_async(const proc_options& opts, std::function<void(proc_result)> on_done) {
+    auto quoted = quote_command(opts.command);
+    dds_log(debug, "Spawning subprocess: {}", quoted);
+    // Other threads may be spawning children at the same time as us. Don't let them inherit our
+    // pipe, or else we won't see end-of-file until their children exit too. (dup2() in the child
+    // clears close-on-exec on its copies of the pipe.)
+    auto spawn_lk      = lock_for_spawn();
+    int  stdio_pipe[2] = {};
+    auto rc            = make_cloexec_pipe(stdio_pipe);
+    check_rc(rc == 0, "Create stdio pipe for subprocess");
 
-    int status = 0;
-    rc         = ::waitpid(child, &status, 0);
-    check_rc(rc >= 0, "Failed in waitpid()");
+    int read_pipe  = stdio_pipe[0];
+    int write_pipe = stdio_pipe[1];
+
+    auto child = spawn_child(opts, write_pipe, read_pipe);
+    ::close(write_pipe);
+    if (spawn_lk.owns_lock()) {
+        spawn_lk.unlock();
+    }
+    if (child < 0 && errno == ENOENT) {
+        // Report a missing executable the same way that a child that fails to exec() would
+        ::close(read_pipe);
+        proc_result res;
+        res.retc   = 255;
+        res.output = fmt::format(
+            "[dds child executor] The requested executable [{}] could not be found.",
+            opts.command.front());
+        on_done(std::move(res));
+        return;
+    }
+    if (child < 0) {
+        ::close(read_pipe);
+        check_rc(false, "Failed to spawn a subprocess");
+    }
+    ::fcntl(read_pipe, F_SETFL, O_NONBLOCK);
 
-    if (WIFEXITED(status)) {
-        res.retc = WEXITSTATUS(status);
-    } else if (WIFSIGNALED(status)) {
-        res.signal = WTERMSIG(status);
+    child_proc proc{
+        .pid            = child,
+        .read_fd        = read_pipe,
+        .pid_fd         = open_pidfd(child),
+        .quoted_command = std::move(quoted),
+        .deadline       = std::nullopt,
+        .result         = {},
+        .on_done        = std::move(on_done),
+    };
+    if (opts.timeout) {
+        proc.deadline = std::chrono::steady_clock::now() + *opts.timeout;
     }
+    supervisor::get().add(std::move(proc));
+}
+
+proc_result dds::run_proc(const proc_options& opts) {
+    auto promise = std::make_shared<std::promise<proc_result>>();
+    auto future  = promise->get_future();
+    run_proc_async(opts, [promise](proc_result res) { promise->set_value(std::move(res)); });
+    auto res = future.get();
 
     cancellation_point();
     return res;
 }
 
-#endif  // _WIN32
\ No newline at end of file
+#endif  // _WIN32
@@ -0,0 +1,95 @@
+#include <dds/proc.hpp>
+
+#include <dds/util/time.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+#ifndef _WIN32
+
+TEST_CASE("Capture the output and exit code of a subprocess") {
+    auto res = dds::run_proc({"sh", "-c", "echo hello; echo oops >&2; exit 3"});
+    CHECK(res.retc == 3);
+    CHECK_FALSE(res.okay());
+    CHECK(res.output == "hello\noops\n");
+}
+
+TEST_CASE("Capture large output from a subprocess") {
+    auto res = dds::run_proc(
+        {"sh", "-c", "i=0; while [ $i -lt 20000 ]; do echo 0123456789; i=$((i+1)); done"});
+    CHECK(res.okay());
+    CHECK(res.output.size() == 20000 * 11);
+}
+
+TEST_CASE("Run a subprocess in another directory") {
+    auto res = dds::run_proc(dds::proc_options{.command = {"pwd"}, .cwd = "/"});
+    CHECK(res.okay());
+    CHECK(res.output == "/\n");
+}
+
+TEST_CASE("Time out a subprocess") {
+    auto res = dds::run_proc(dds::proc_options{.command = {"sleep", "10"}, .timeout = 50ms});
+    CHECK(res.timed_out);
+    CHECK(res.signal != 0);
+}
+
+TEST_CASE("Run many subprocesses concurrently") {
+    std::mutex              mut;
+    std::condition_variable cv;
+    int                     n_done = 0;
+    std::atomic_int         n_okay = 0;
+    const int               n_proc = 32;
+    for (int i = 0; i < n_proc; ++i) {
+        dds::run_proc_async(dds::proc_options{.command = {"sh", "-c", "sleep 0.1; echo done"}},
+                            [&](dds::proc_result res) {
+                                if (res.okay() && res.output == "done\n") {
+                                    ++n_okay;
+                                }
+                                std::scoped_lock lk{mut};
+                                ++n_done;
+                                cv.notify_all();
+                            });
+    }
+    std::unique_lock lk{mut};
+    cv.wait(lk, [&] { return n_done == n_proc; });
+    CHECK(n_okay == n_proc);
+}
+
+TEST_CASE("Report a missing executable") {
+    auto res = dds::run_proc({"dds-test-this-executable-does-not-exist"});
+    CHECK_FALSE(res.okay());
+    CHECK(res.output.find("could not be found") != std::string::npos);
+}
+
+TEST_CASE("Spawn latency as the resident size grows", "[.][bench]") {
+    // Hold a growing amount of touched memory, as dds does once it has loaded a large build plan
+    std::vector<std::vector<char>> ballast;
+    for (auto mib : {0, 256, 1024}) {
+        while (ballast.size() < static_cast<std::size_t>(mib) / 64) {
+            ballast.emplace_back(64 * 1024 * 1024, 'x');
+        }
+        for (auto method : {dds::proc_spawn_method::fork, dds::proc_spawn_method::automatic}) {
+            const int      n_spawns = 100;
+            dds::stopwatch timer;
+            for (int i = 0; i < n_spawns; ++i) {
+                auto res = dds::run_proc(
+                    dds::proc_options{.command = {"true"}, .spawn_method = method});
+                REQUIRE(res.okay());
+            }
+            auto per_spawn = timer.elapsed_us() / n_spawns;
+            std::cout << "Resident +" << mib << " MiB, "
+                      << (method == dds::proc_spawn_method::fork ? "fork()       " : "posix_spawn()")
+                      << ": " << per_spawn.count() << "us per spawn\n";
+        }
+    }
+}
+
+#endif
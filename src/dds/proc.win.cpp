@@ -6,6 +6,7 @@
 
 #include <fmt/core.h>
 #include <neo/assert.hpp>
+#include <neo/event.hpp>
 #include <wil/resource.h>
 
 #include <windows.h>
@@ -14,6 +15,7 @@
 #include <iomanip>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
 
 using namespace dds;
 using namespace std::chrono_literals;
@@ -130,4 +132,23 @@ proc_result dds::run_proc(const proc_options& opts) {
     return res;
 }
 
+void dds::run_proc_async(const proc_options& opts, std::function<void(proc_result)> on_done) {
+    // There is no process supervisor on Windows (yet). Wait for the process on a thread of its own.
+    std::thread([opts, on_done = std::move(on_done)] {
+        auto        log_subscr = neo::subscribe(&log::ev_log::print);
+        proc_result res;
+        try {
+            res = run_proc(opts);
+        } catch (const std::exception& e) {
+            res.retc   = -1;
+            res.output = e.what();
+        } catch (...) {
+            // Whatever went wrong, the waiter must still be told that the process is done
+            res.retc   = -1;
+            res.output = "[dds child executor] The subprocess failed for an unknown reason.";
+        }
+        on_done(std::move(res));
+    }).detach();
+}
+
 #endif  // _WIN32
\ No newline at end of file
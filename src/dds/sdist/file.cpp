@@ -68,5 +68,7 @@ std::optional<source_file> source_file::from_path(path_ref path, path_ref base_p
         return std::nullopt;
     }
 
-    return source_file{path, base_path, *kind};
+    // Computed lexically, since `fs::relative` would make several syscalls for every file
+    auto rel = path.lexically_normal().lexically_relative(base_path.lexically_normal());
+    return source_file{path, base_path, *kind, std::move(rel)};
 }
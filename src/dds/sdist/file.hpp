@@ -30,10 +30,14 @@ struct source_file {
      * The kind of the source file
      */
     source_kind kind;
+    /**
+     * The path to the file relative to `basis_path`
+     */
+    fs::path relpath;
 
     static std::optional<source_file> from_path(path_ref path, path_ref base_path) noexcept;
 
-    fs::path relative_path() const noexcept { return fs::relative(path, basis_path); }
+    path_ref relative_path() const noexcept { return relpath; }
 };
 
 using source_list = std::vector<source_file>;
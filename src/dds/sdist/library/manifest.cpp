@@ -41,7 +41,24 @@ library_manifest library_manifest::load_from_file(path_ref fpath) {
                         for_each{require_str{"Each 'uses' element should be a string"},
                                  put_into{std::back_inserter(lib.uses), [](std::string s) {
                                               return lm::split_usage_string(s);
-                                          }}}}});
+                                          }}}},
+                 if_key{"pch",
+                        require_str{"'pch' must be a string"},
+                        put_into{lib.pch, [](std::string s) { return fs::path(s); }}},
+                 if_key{"test_timeouts",
+                        require_obj{"'test_timeouts' must be an object"},
+                        mapping{[&](std::string key, auto&& dat) {
+                            if (!dat.is_double() || dat.as_double() < 0) {
+                                return walk.reject(
+                                    "Each 'test_timeouts' value must be a non-negative number of "
+                                    "seconds");
+                            }
+                            auto seconds = std::chrono::duration<double>(dat.as_double());
+                            lib.test_timeouts.emplace(
+                                std::move(key),
+                                std::chrono::duration_cast<std::chrono::milliseconds>(seconds));
+                            return walk.accept;
+                        }}}});
 
     return lib;
 }
@@ -5,6 +5,10 @@
 
 #include <libman/library.hpp>
 
+#include <chrono>
+#include <map>
+#include <optional>
+#include <string>
 #include <vector>
 
 namespace dds {
@@ -25,6 +29,11 @@ struct library_manifest {
     std::vector<lm::usage> uses;
     /// The libraries that the owning library must be linked with
     std::vector<lm::usage> links;
+    /// A header to precompile for the library's source files, relative to the library directory
+    std::optional<fs::path> pch;
+    /// Timeouts of individual tests, keyed by the path of the test's source file relative to the
+    /// library's source directory. Zero to wait forever.
+    std::map<std::string, std::chrono::milliseconds> test_timeouts;
 
     /**
      * Load the library manifest from an existing file
@@ -6,11 +6,15 @@
 #include <dds/sdist/root.hpp>
 #include <dds/util/algo.hpp>
 #include <dds/util/log.hpp>
+#include <dds/util/parallel.hpp>
 
 #include <neo/ref.hpp>
 #include <range/v3/view/filter.hpp>
+#include <range/v3/view/iota.hpp>
 #include <range/v3/view/transform.hpp>
 
+#include <optional>
+
 using namespace dds;
 
 namespace {
@@ -105,20 +109,30 @@ auto has_library_dirs
     = [](path_ref dir) { return fs::exists(dir / "src") || fs::exists(dir / "include"); };
 
 std::vector<library_root> dds::collect_libraries(path_ref root) {
-    std::vector<library_root> ret;
+    std::vector<fs::path> lib_dirs;
     if (has_library_dirs(root)) {
-        ret.emplace_back(library_root::from_directory(fs::canonical(root)));
+        lib_dirs.push_back(fs::canonical(root));
     }
 
     auto pf_libs_dir = root / "libs";
 
     if (fs::is_directory(pf_libs_dir)) {
-        extend(ret,
+        extend(lib_dirs,
                fs::directory_iterator(pf_libs_dir)            //
                    | neo::lref                                //
                    | ranges::views::filter(has_library_dirs)  //
-                   | ranges::views::transform(
-                       [&](auto p) { return library_root::from_directory(fs::canonical(p)); }));
+                   | ranges::views::transform([&](auto p) { return fs::canonical(p); }));
+    }
+
+    // Each library is a separate tree of files, so they may be scanned in parallel
+    std::vector<std::optional<library_root>> libs(lib_dirs.size());
+    parallel_run_or_throw(ranges::views::iota(std::size_t(0), lib_dirs.size()), 0, [&](auto n) {
+        libs[n] = library_root::from_directory(lib_dirs[n]);
+    });
+
+    std::vector<library_root> ret;
+    for (auto& lib : libs) {
+        ret.push_back(std::move(*lib));
     }
     return ret;
 }
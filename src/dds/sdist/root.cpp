@@ -1,22 +1,184 @@
 #include "./root.hpp"
 
-#include <neo/ref.hpp>
-#include <range/v3/range/conversion.hpp>
-#include <range/v3/view/filter.hpp>
-#include <range/v3/view/transform.hpp>
+#include <dds/util/hash.hpp>
+#include <dds/util/log.hpp>
+#include <dds/util/paths.hpp>
+#include <dds/util/string.hpp>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <random>
 
 using namespace dds;
 
+namespace {
+
+constexpr std::string_view index_header = "dds-source-index 1";
+
+/**
+ * A directory whose modification time is this recent may be modified again within the resolution
+ * of the filesystem's timestamps without its modification time changing, so it is not trusted.
+ */
+constexpr auto racy_mtime_window = std::chrono::seconds(2);
+
+/// The modification time that is recorded for a directory whose listing must not be reused
+constexpr auto untrusted_mtime = fs::file_time_type::min();
+
+/// The files and subdirectories within a single directory
+struct dir_listing {
+    fs::file_time_type       mtime = untrusted_mtime;
+    std::vector<std::string> files;
+    std::vector<std::string> subdirs;
+};
+
+/// The listings of every directory in a tree, keyed by the path of the directory relative to the
+/// root of the tree. The root is keyed by an empty string.
+using tree_listing = std::map<std::string, dir_listing>;
+
+fs::path index_file_path(path_ref root, path_ref index_dir) {
+    return index_dir / (sha256_hex(root.generic_string()).substr(0, 32) + ".idx");
+}
+
+tree_listing load_index(path_ref root, path_ref index_file) {
+    tree_listing    ret;
+    std::error_code ec;
+    auto            content = slurp_file(index_file, ec);
+    if (ec) {
+        return ret;
+    }
+    auto lines = split_view(content, "\n");
+    if (lines.size() < 2 || lines[0] != index_header || lines[1] != root.generic_string()) {
+        return ret;
+    }
+    dir_listing* cur = nullptr;
+    for (auto it = lines.begin() + 2; it != lines.end(); ++it) {
+        auto line = *it;
+        if (line.size() < 2 || line[1] != ' ') {
+            continue;
+        }
+        auto rest = line.substr(2);
+        if (line[0] == 'd') {
+            // A directory line holds its modification time and its path
+            auto space = rest.find(' ');
+            if (space == rest.npos) {
+                return {};
+            }
+            auto count = std::stoll(std::string(rest.substr(0, space)));
+            cur        = &ret[std::string(rest.substr(space + 1))];
+            cur->mtime = fs::file_time_type(fs::file_time_type::duration(count));
+        } else if (cur && line[0] == 'f') {
+            cur->files.emplace_back(rest);
+        } else if (cur && line[0] == 's') {
+            cur->subdirs.emplace_back(rest);
+        }
+    }
+    return ret;
+}
+
+void save_index(path_ref root, path_ref index_file, const tree_listing& tree) {
+    std::string content = fmt::format("{}\n{}\n", index_header, root.generic_string());
+    for (auto& [rel, listing] : tree) {
+        content += fmt::format("d {} {}\n", listing.mtime.time_since_epoch().count(), rel);
+        for (auto& name : listing.files) {
+            content += fmt::format("f {}\n", name);
+        }
+        for (auto& name : listing.subdirs) {
+            content += fmt::format("s {}\n", name);
+        }
+    }
+
+    // Write a temporary file and rename it into place, so that concurrent builds never see a
+    // partially written index
+    thread_local std::mt19937_64 rng{std::random_device{}()};
+    auto                         tmp = index_file;
+    tmp += fmt::format(".tmp-{:x}", rng());
+    fs::create_directories(index_file.parent_path());
+    {
+        auto out = dds::open(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+        out << content;
+    }
+    fs::rename(tmp, index_file);
+}
+
+dir_listing list_dir(path_ref dir) {
+    dir_listing ret;
+    for (auto& entry : fs::directory_iterator{dir}) {
+        auto name = entry.path().filename().string();
+        if (name.find('\n') != name.npos) {
+            // Cannot be written to the index, and certainly is not a source file
+            continue;
+        }
+        // Like a recursive directory iterator, do not descend into links to directories
+        if (entry.is_directory() && !entry.is_symlink()) {
+            ret.subdirs.push_back(std::move(name));
+        } else if (entry.is_regular_file()) {
+            ret.files.push_back(std::move(name));
+        }
+    }
+    std::sort(ret.files.begin(), ret.files.end());
+    std::sort(ret.subdirs.begin(), ret.subdirs.end());
+    return ret;
+}
+
+}  // namespace
+
 std::vector<source_file> source_root::collect_sources() const {
-    using namespace ranges::views;
-    // Collect all source files from the directory
-    return                                                                              //
-        fs::recursive_directory_iterator(path)                                          //
-        | neo::lref                                                                     //
-        | filter([](auto&& entry) { return entry.is_regular_file(); })                  //
-        | transform([&](auto&& entry) { return source_file::from_path(entry, path); })  //
-        // source_file::from_path returns an optional. Drop nulls
-        | filter([](auto&& opt) { return opt.has_value(); })  //
-        | transform([](auto&& opt) { return *opt; })          //
-        | ranges::to_vector;
+    return collect_source_files(path, dds_cache_dir() / "source-index");
+}
+
+std::vector<source_file> dds::collect_source_files(path_ref root, path_ref index_dir) {
+    auto index_file = index_file_path(root, index_dir);
+    auto prior      = load_index(root, index_file);
+    auto now        = fs::file_time_type::clock::now();
+
+    tree_listing             tree;
+    std::vector<std::string> queue    = {""};
+    std::size_t              n_listed = 0;
+    while (!queue.empty()) {
+        auto rel = std::move(queue.back());
+        queue.pop_back();
+        auto dir   = rel.empty() ? root : root / rel;
+        auto mtime = fs::last_write_time(dir);
+
+        auto  found   = prior.find(rel);
+        auto& listing = tree[rel];
+        if (found != prior.end() && found->second.mtime == mtime) {
+            listing = std::move(found->second);
+        } else {
+            listing = list_dir(dir);
+            ++n_listed;
+            if (now - mtime > racy_mtime_window) {
+                listing.mtime = mtime;
+            }
+        }
+        for (auto& sub : listing.subdirs) {
+            queue.push_back(rel.empty() ? sub : rel + "/" + sub);
+        }
+    }
+    dds_log(trace, "Listed {} of {} directories in [{}]", n_listed, tree.size(), root.string());
+
+    if (n_listed != 0) {
+        try {
+            save_index(root, index_file, tree);
+        } catch (const std::exception& e) {
+            dds_log(debug,
+                    "Failed to save the source index [{}]: {}",
+                    index_file.string(),
+                    e.what());
+        }
+    }
+
+    std::vector<source_file> ret;
+    for (auto& [rel, listing] : tree) {
+        auto dir = rel.empty() ? root : root / rel;
+        for (auto& name : listing.files) {
+            if (auto sf = source_file::from_path(dir / name, root)) {
+                ret.push_back(std::move(*sf));
+            }
+        }
+    }
+    return ret;
 }
@@ -17,6 +17,9 @@ struct source_root {
 
     /**
      * Generate a vector of every source file contained in this directory (including subdirectories)
+     *
+     * The listing of the directory is remembered in the user's cache directory. Refer to
+     * `collect_source_files()`.
      */
     std::vector<source_file> collect_sources() const;
 
@@ -26,4 +29,15 @@ struct source_root {
     bool exists() const noexcept { return fs::exists(path); }
 };
 
+/**
+ * Collect every source file within `root` and its subdirectories, ordered by path.
+ *
+ * The listing of every directory in the tree is saved in an index file within `index_dir`, along
+ * with the modification time of the directory. Adding, removing, or renaming a file changes the
+ * modification time of the directory that contains it, so a later call only lists the directories
+ * whose modification times have changed. If the index cannot be read or written, the tree is
+ * listed in full.
+ */
+std::vector<source_file> collect_source_files(path_ref root, path_ref index_dir);
+
 }  // namespace dds
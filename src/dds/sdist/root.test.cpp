@@ -0,0 +1,57 @@
+#include <dds/sdist/root.hpp>
+
+#include <dds/temp.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <fstream>
+
+namespace {
+
+struct tmp_tree {
+    dds::temporary_dir tempdir   = dds::temporary_dir::create();
+    dds::fs::path      root      = tempdir.path() / "src";
+    dds::fs::path      index_dir = tempdir.path() / "index";
+
+    void touch(std::string_view name) {
+        auto p = root / name;
+        dds::fs::create_directories(p.parent_path());
+        std::ofstream{p} << "content";
+    }
+
+    std::vector<std::string> collect() {
+        std::vector<std::string> ret;
+        for (auto& sf : dds::collect_source_files(root, index_dir)) {
+            ret.push_back(sf.relative_path().generic_string());
+        }
+        return ret;
+    }
+};
+
+}  // namespace
+
+TEST_CASE_METHOD(tmp_tree, "Collect the source files in a tree") {
+    touch("foo.cpp");
+    touch("foo.txt");
+    touch("bar/baz.hpp");
+    touch("bar/baz.test.cpp");
+    auto files = collect();
+    CHECK(files == std::vector<std::string>{"foo.cpp", "bar/baz.hpp", "bar/baz.test.cpp"});
+    // The second collection comes from the index, and must be the same
+    CHECK(collect() == files);
+}
+
+TEST_CASE_METHOD(tmp_tree, "Files that are added after the index is saved are found") {
+    touch("foo.cpp");
+    touch("bar/baz.hpp");
+    // Make the directories old enough that their listings are saved in the index
+    auto old = dds::fs::file_time_type::clock::now() - std::chrono::hours(1);
+    dds::fs::last_write_time(root, old);
+    dds::fs::last_write_time(root / "bar", old);
+    CHECK(collect().size() == 2);
+
+    touch("bar/qux.cpp");
+    CHECK(collect() == std::vector<std::string>{"foo.cpp", "bar/baz.hpp", "bar/qux.cpp"});
+    dds::fs::remove(root / "foo.cpp");
+    CHECK(collect() == std::vector<std::string>{"bar/baz.hpp", "bar/qux.cpp"});
+}
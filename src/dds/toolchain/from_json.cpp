@@ -75,6 +75,8 @@ toolchain dds::parse_toolchain_json_data(const json5::data& dat, std::string_vie
     opt_string     obj_suffix;
     opt_string     exe_prefix;
     opt_string     exe_suffix;
+    opt_string     pch_suffix;
+    opt_string     bmi_suffix;
     opt_string_seq base_warning_flags;
     opt_string_seq base_flags;
     opt_string_seq base_c_flags;
@@ -87,6 +89,11 @@ toolchain dds::parse_toolchain_json_data(const json5::data& dat, std::string_vie
     opt_string_seq create_archive;
     opt_string_seq link_executable;
     opt_string_seq tty_flags;
+    opt_string_seq prefix_map_template;
+    opt_string_seq create_pch_template;
+    opt_string_seq use_pch_template;
+    opt_string_seq scan_modules_template;
+    opt_string_seq use_modules_template;
 
     // For copy-pasting convenience: ‘{}’
 
@@ -172,12 +179,19 @@ toolchain dds::parse_toolchain_json_data(const json5::data& dat, std::string_vie
                     KEY_EXTEND_FLAGS(create_archive),
                     KEY_EXTEND_FLAGS(link_executable),
                     KEY_EXTEND_FLAGS(tty_flags),
+                    KEY_EXTEND_FLAGS(prefix_map_template),
+                    KEY_EXTEND_FLAGS(create_pch_template),
+                    KEY_EXTEND_FLAGS(use_pch_template),
+                    KEY_EXTEND_FLAGS(scan_modules_template),
+                    KEY_EXTEND_FLAGS(use_modules_template),
                     KEY_STRING(obj_prefix),
                     KEY_STRING(obj_suffix),
                     KEY_STRING(archive_prefix),
                     KEY_STRING(archive_suffix),
                     KEY_STRING(exe_prefix),
                     KEY_STRING(exe_suffix),
+                    KEY_STRING(pch_suffix),
+                    KEY_STRING(bmi_suffix),
                     [&](auto key, auto) -> walk_result {
                         auto dym = did_you_mean(key,
                                                 {
@@ -200,6 +214,13 @@ toolchain dds::parse_toolchain_json_data(const json5::data& dat, std::string_vie
                                                     "exe_prefix",
                                                     "exe_suffix",
                                                     "tty_flags",
+                                                    "prefix_map_template",
+                                                    "create_pch_template",
+                                                    "use_pch_template",
+                                                    "pch_suffix",
+                                                    "scan_modules_template",
+                                                    "use_modules_template",
+                                                    "bmi_suffix",
                                                 });
                         fail(context,
                              "Unknown toolchain advanced-config key ‘{}’ (Did you mean ‘{}’?)",
@@ -734,5 +755,85 @@ toolchain dds::parse_toolchain_json_data(const json5::data& dat, std::string_vie
         }
     });
 
+    tc.prefix_map_template = read_opt(prefix_map_template, [&]() -> string_seq {
+        if (!compiler_id) {
+            // Without knowing the compiler, we cannot remap paths. This only affects the paths
+            // that are recorded in the compiler's outputs.
+            return {};
+        }
+        if (is_msvc) {
+            // MSVC has no equivalent option
+            return {};
+        } else if (is_gnu_like) {
+            return {"-ffile-prefix-map=[old]=[new]"};
+        } else {
+            assert(false && "Impossible compiler_id while deducing `prefix_map_template`");
+            std::terminate();
+        }
+    });
+
+    tc.create_pch_template = read_opt(create_pch_template, [&]() -> string_seq {
+        if (is_gnu_like) {
+            // The header is given in place of a source file, and the precompiled header is written
+            // to the output path
+            return {"-x", "c++-header"};
+        } else if (is_msvc) {
+            // The header is compiled as a source file that also force-includes itself. This writes
+            // an object file, which must be linked with the objects that use the precompiled header
+            return {"/TP", "/Yc[header]", "/FI[header]", "/Fp[pch]"};
+        }
+        // Precompiled headers are not used with other compilers
+        return {};
+    });
+
+    tc.use_pch_template = read_opt(use_pch_template, [&]() -> string_seq {
+        if (is_gnu_like) {
+            // Both compilers look for the precompiled header beside the included header, and
+            // fall back to the header if there is none
+            return {"-include", "[header]"};
+        } else if (is_msvc) {
+            return {"/Yu[header]", "/FI[header]", "/Fp[pch]"};
+        }
+        return {};
+    });
+
+    tc.pch_suffix = read_opt(pch_suffix, [&]() -> string {
+        if (is_gnu) {
+            return ".gch";
+        } else if (is_clang || is_msvc) {
+            return ".pch";
+        }
+        return "";
+    });
+
+    tc.scan_modules_template = read_opt(scan_modules_template, [&]() -> string_seq {
+        if (is_gnu) {
+            // The source file is only preprocessed, and the module dependencies are written in the
+            // P1689 format
+            return {"-fmodules-ts",
+                    "-E",
+                    "-fdeps-format=p1689r5",
+                    "-fdeps-file=[ddi]",
+                    "-fdeps-target=[obj]"};
+        }
+        // Clang and MSVC scan with separate tools, rather than with a compiler flag
+        return {};
+    });
+
+    tc.use_modules_template = read_opt(use_modules_template, [&]() -> string_seq {
+        if (is_gnu) {
+            // The module mapper file names the interface file of each module
+            return {"-fmodules-ts", "-fmodule-mapper=[map]"};
+        }
+        return {};
+    });
+
+    tc.bmi_suffix = read_opt(bmi_suffix, [&]() -> string {
+        if (is_gnu) {
+            return ".gcm";
+        }
+        return "";
+    });
+
     return tc.realize();
 }
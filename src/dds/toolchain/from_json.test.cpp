@@ -239,3 +239,152 @@ TEST_CASE("Manipulate a toolchain and file compilation") {
                                       "-fPIC",
                                       "-pthread"});
 }
+
+TEST_CASE("Remap path prefixes in compiler outputs") {
+    dds::compile_file_spec cfs;
+    cfs.source_path = "foo.cpp";
+    cfs.out_path    = "foo.o";
+    dds::toolchain_knobs knobs{
+        .prefix_maps = {{"/work/proj", "proj"}, {"/work/proj/_build", "out"}},
+    };
+
+    auto tc  = dds::parse_toolchain_json5("{compiler_id: 'gnu'}");
+    auto cmd = tc.create_compile_command(cfs, dds::fs::current_path(), knobs);
+    CHECK(cmd.command
+          == std::vector<std::string>{"g++",
+                                      "-ffile-prefix-map=/work/proj=proj",
+                                      "-ffile-prefix-map=/work/proj/_build=out",
+                                      "-MD",
+                                      "-MF",
+                                      "foo.o.d",
+                                      "-MQ",
+                                      "foo.o",
+                                      "-c",
+                                      "foo.cpp",
+                                      "-ofoo.o",
+                                      "-fPIC",
+                                      "-pthread"});
+
+    tc  = dds::parse_toolchain_json5(
+        "{compiler_id: 'gnu', advanced: {prefix_map_template: '-fdebug-prefix-map=[old]=[new]'}}");
+    cmd = tc.create_compile_command(cfs, dds::fs::current_path(), knobs);
+    CHECK(cmd.command[1] == "-fdebug-prefix-map=/work/proj=proj");
+
+    // MSVC has no option to remap paths
+    tc  = dds::parse_toolchain_json5("{compiler_id: 'msvc'}");
+    cmd = tc.create_compile_command(cfs, dds::fs::current_path(), knobs);
+    CHECK(cmd.command[1] == "/showIncludes");
+}
+
+TEST_CASE("Create and use precompiled headers") {
+    dds::compile_file_spec cfs;
+    cfs.source_path = "pch.hpp";
+    cfs.out_path    = "pch.hpp.gch";
+    cfs.create_pch  = dds::pch_spec{"pch.hpp", "pch.hpp.gch"};
+
+    auto tc = dds::parse_toolchain_json5("{compiler_id: 'gnu'}");
+    REQUIRE(tc.supports_pch());
+    CHECK(tc.pch_suffix() == ".gch");
+    auto cmd = tc.create_compile_command(cfs, dds::fs::current_path(), {});
+    CHECK(cmd.command
+          == std::vector<std::string>{"g++",
+                                      "-x",
+                                      "c++-header",
+                                      "-MD",
+                                      "-MF",
+                                      "pch.hpp.gch.d",
+                                      "-MQ",
+                                      "pch.hpp.gch",
+                                      "-c",
+                                      "pch.hpp",
+                                      "-opch.hpp.gch",
+                                      "-fPIC",
+                                      "-pthread"});
+    CHECK_FALSE(cmd.pch_input);
+
+    cfs.source_path = "foo.cpp";
+    cfs.out_path    = "foo.o";
+    cfs.create_pch.reset();
+    cfs.use_pch = dds::pch_spec{"pch.hpp", "pch.hpp.gch"};
+    cmd         = tc.create_compile_command(cfs, dds::fs::current_path(), {});
+    CHECK(cmd.command[1] == "-include");
+    CHECK(cmd.command[2] == "pch.hpp");
+    CHECK(cmd.pch_input == dds::fs::path("pch.hpp.gch"));
+
+    tc = dds::parse_toolchain_json5("{compiler_id: 'clang'}");
+    CHECK(tc.supports_pch());
+    CHECK(tc.pch_suffix() == ".pch");
+
+    tc = dds::parse_toolchain_json5(
+        "{compiler_id: 'clang', advanced: {use_pch_template: '-include-pch [pch]'}}");
+    cmd = tc.create_compile_command(cfs, dds::fs::current_path(), {});
+    CHECK(cmd.command[1] == "-include-pch");
+    CHECK(cmd.command[2] == "pch.hpp.gch");
+    CHECK_FALSE(tc.pch_creates_object());
+
+    // MSVC writes an object file along with the precompiled header
+    tc = dds::parse_toolchain_json5("{compiler_id: 'msvc'}");
+    REQUIRE(tc.supports_pch());
+    CHECK(tc.pch_creates_object());
+    cfs.source_path = "pch.hpp";
+    cfs.out_path    = "pch.hpp.obj";
+    cfs.create_pch  = dds::pch_spec{"pch.hpp", "pch.hpp.pch"};
+    cfs.use_pch.reset();
+    cmd = tc.create_compile_command(cfs, dds::fs::current_path(), {});
+    CHECK(cmd.command
+          == std::vector<std::string>{"cl.exe",
+                                      "/TP",
+                                      "/Ycpch.hpp",
+                                      "/FIpch.hpp",
+                                      "/Fppch.hpp.pch",
+                                      "/showIncludes",
+                                      "/c",
+                                      "pch.hpp",
+                                      "/Fopch.hpp.obj",
+                                      "/MT",
+                                      "/nologo",
+                                      "/permissive-",
+                                      "/EHsc"});
+}
+
+TEST_CASE("Scan and use C++ modules") {
+    dds::compile_file_spec cfs;
+    cfs.source_path  = "foo.cpp";
+    cfs.out_path     = "foo.o.ddi.i";
+    cfs.scan_modules = dds::module_scan_spec{"foo.o.ddi", "foo.o"};
+
+    auto tc = dds::parse_toolchain_json5("{compiler_id: 'gnu'}");
+    REQUIRE(tc.supports_modules());
+    CHECK(tc.bmi_suffix() == ".gcm");
+    auto cmd = tc.create_compile_command(cfs, dds::fs::current_path(), {});
+    CHECK(cmd.command
+          == std::vector<std::string>{"g++",
+                                      "-fmodules-ts",
+                                      "-E",
+                                      "-fdeps-format=p1689r5",
+                                      "-fdeps-file=foo.o.ddi",
+                                      "-fdeps-target=foo.o",
+                                      "-MD",
+                                      "-MF",
+                                      "foo.o.ddi.i.d",
+                                      "-MQ",
+                                      "foo.o.ddi.i",
+                                      "-c",
+                                      "foo.cpp",
+                                      "-ofoo.o.ddi.i",
+                                      "-fPIC",
+                                      "-pthread"});
+
+    cfs.out_path = "foo.o";
+    cfs.scan_modules.reset();
+    cfs.module_mapper = "module.map";
+    cmd               = tc.create_compile_command(cfs, dds::fs::current_path(), {});
+    CHECK(cmd.command[1] == "-fmodules-ts");
+    CHECK(cmd.command[2] == "-fmodule-mapper=module.map");
+
+    // Other compilers require a separate scanning tool
+    tc = dds::parse_toolchain_json5("{compiler_id: 'clang'}");
+    CHECK_FALSE(tc.supports_modules());
+    tc = dds::parse_toolchain_json5("{compiler_id: 'msvc'}");
+    CHECK_FALSE(tc.supports_modules());
+}
@@ -20,6 +20,11 @@ struct toolchain_prep {
     string_seq link_exe;
     string_seq warning_flags;
     string_seq tty_flags;
+    string_seq prefix_map_template;
+    string_seq create_pch_template;
+    string_seq use_pch_template;
+    string_seq scan_modules_template;
+    string_seq use_modules_template;
 
     std::string archive_prefix;
     std::string archive_suffix;
@@ -27,6 +32,8 @@ struct toolchain_prep {
     std::string object_suffix;
     std::string exe_prefix;
     std::string exe_suffix;
+    std::string pch_suffix;
+    std::string bmi_suffix;
 
     enum file_deps_mode deps_mode;
 
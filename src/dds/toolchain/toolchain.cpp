@@ -9,6 +9,7 @@
 
 #include <range/v3/view/transform.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <initializer_list>
 #include <optional>
@@ -25,22 +26,29 @@ using opt_string = optional<string>;
 
 toolchain toolchain::realize(const toolchain_prep& prep) {
     toolchain ret;
-    ret._c_compile           = prep.c_compile;
-    ret._cxx_compile         = prep.cxx_compile;
-    ret._inc_template        = prep.include_template;
-    ret._extern_inc_template = prep.external_include_template;
-    ret._def_template        = prep.define_template;
-    ret._link_archive        = prep.link_archive;
-    ret._link_exe            = prep.link_exe;
-    ret._warning_flags       = prep.warning_flags;
-    ret._archive_prefix      = prep.archive_prefix;
-    ret._archive_suffix      = prep.archive_suffix;
-    ret._object_prefix       = prep.object_prefix;
-    ret._object_suffix       = prep.object_suffix;
-    ret._exe_prefix          = prep.exe_prefix;
-    ret._exe_suffix          = prep.exe_suffix;
-    ret._deps_mode           = prep.deps_mode;
-    ret._tty_flags           = prep.tty_flags;
+    ret._c_compile             = prep.c_compile;
+    ret._cxx_compile           = prep.cxx_compile;
+    ret._inc_template          = prep.include_template;
+    ret._extern_inc_template   = prep.external_include_template;
+    ret._def_template          = prep.define_template;
+    ret._link_archive          = prep.link_archive;
+    ret._link_exe              = prep.link_exe;
+    ret._warning_flags         = prep.warning_flags;
+    ret._archive_prefix        = prep.archive_prefix;
+    ret._archive_suffix        = prep.archive_suffix;
+    ret._object_prefix         = prep.object_prefix;
+    ret._object_suffix         = prep.object_suffix;
+    ret._exe_prefix            = prep.exe_prefix;
+    ret._exe_suffix            = prep.exe_suffix;
+    ret._deps_mode             = prep.deps_mode;
+    ret._tty_flags             = prep.tty_flags;
+    ret._prefix_map_template   = prep.prefix_map_template;
+    ret._create_pch_template   = prep.create_pch_template;
+    ret._use_pch_template      = prep.use_pch_template;
+    ret._pch_suffix            = prep.pch_suffix;
+    ret._scan_modules_template = prep.scan_modules_template;
+    ret._use_modules_template  = prep.use_modules_template;
+    ret._bmi_suffix            = prep.bmi_suffix;
     return ret;
 }
 
@@ -52,6 +60,38 @@ vector<string> toolchain::external_include_args(const fs::path& p) const noexcep
     return replace(_extern_inc_template, "[path]", p.string());
 }
 
+vector<string> toolchain::prefix_map_args(const path_prefix_map& map) const noexcept {
+    return replace(replace(_prefix_map_template, "[old]", map.from.string()), "[new]", map.to);
+}
+
+static vector<string> pch_args(const vector<string>& tmpl, const pch_spec& pch) {
+    return replace(replace(tmpl, "[header]", pch.header.string()), "[pch]", pch.pch_path.string());
+}
+
+vector<string> toolchain::create_pch_args(const pch_spec& pch) const noexcept {
+    return pch_args(_create_pch_template, pch);
+}
+
+vector<string> toolchain::use_pch_args(const pch_spec& pch) const noexcept {
+    return pch_args(_use_pch_template, pch);
+}
+
+vector<string> toolchain::scan_modules_args(const module_scan_spec& scan) const noexcept {
+    return replace(replace(_scan_modules_template, "[ddi]", scan.ddi_path.string()),
+                   "[obj]",
+                   scan.object_path.string());
+}
+
+vector<string> toolchain::use_modules_args(path_ref mapper) const noexcept {
+    return replace(_use_modules_template, "[map]", mapper.string());
+}
+
+bool toolchain::pch_creates_object() const noexcept {
+    return std::any_of(_create_pch_template.begin(), _create_pch_template.end(), [](auto& arg) {
+        return arg.find("[pch]") != arg.npos;
+    });
+}
+
 vector<string> toolchain::definition_args(std::string_view s) const noexcept {
     return replace(_def_template, "[def]", s);
 }
@@ -76,35 +116,18 @@ static auto shortest_path_args(path_ref base, R&& r) {
 compile_command_info toolchain::create_compile_command(const compile_file_spec& spec,
                                                        path_ref                 cwd,
                                                        toolchain_knobs knobs) const noexcept {
-    using namespace std::literals;
-
-    dds_log(trace,
-            "Calculate compile command for source file [{}] to object file [{}]",
-            spec.source_path.string(),
-            spec.out_path.string());
-
-    language lang = spec.lang;
-    if (lang == language::automatic) {
-        if (spec.source_path.extension() == ".c" || spec.source_path.extension() == ".C") {
-            lang = language::c;
-        } else {
-            lang = language::cxx;
-        }
-    }
+    return create_compile_command(spec, create_compile_command_template(spec, cwd, knobs));
+}
 
-    vector<string> flags;
+compile_command_template toolchain::create_compile_command_template(
+    const compile_file_spec& spec, path_ref cwd, toolchain_knobs knobs) const noexcept {
+    compile_command_template ret;
+    auto&                    flags = ret.leading_flags;
     if (knobs.is_tty) {
         dds_log(trace, "Enabling TTY flags.");
         extend(flags, _tty_flags);
     }
 
-    if (knobs.cache_buster) {
-        // This is simply a CPP definition that is used to "bust" any caches that rely on inspecting
-        // the command-line of the compiler (including our own).
-        auto def = replace(_def_template, "[def]", "__dds_cachebust=" + *knobs.cache_buster);
-        extend(flags, def);
-    }
-
     dds_log(trace, "#include-search dirs:");
     for (auto&& inc_dir : spec.include_dirs) {
         dds_log(trace, "  - search: {}", inc_dir.string());
@@ -135,33 +158,83 @@ compile_command_info toolchain::create_compile_command(const compile_file_spec&
         extend(flags, _warning_flags);
     }
 
-    std::optional<fs::path> gnu_depfile_path;
+    for (auto&& map : knobs.prefix_maps) {
+        dds_log(trace, "  - map path prefix: {} -> {}", map.from.string(), map.to);
+        extend(ret.trailing_flags, prefix_map_args(map));
+    }
+    return ret;
+}
+
+compile_command_info
+toolchain::create_compile_command(const compile_file_spec&        spec,
+                                  const compile_command_template& tmpl) const noexcept {
+    using namespace std::literals;
+
+    dds_log(trace,
+            "Calculate compile command for source file [{}] to object file [{}]",
+            spec.source_path.string(),
+            spec.out_path.string());
+
+    language lang = spec.lang;
+    if (lang == language::automatic) {
+        if (spec.source_path.extension() == ".c" || spec.source_path.extension() == ".C") {
+            lang = language::c;
+        } else {
+            lang = language::cxx;
+        }
+    }
 
+    // Only these flags are particular to the file. The rest come from the template.
+    vector<string> file_flags;
+
+    std::optional<fs::path> pch_input;
+    if (spec.create_pch) {
+        dds_log(trace, "  - precompile header: {}", spec.create_pch->header.string());
+        extend(file_flags, create_pch_args(*spec.create_pch));
+    } else if (spec.use_pch) {
+        dds_log(trace, "  - use precompiled header: {}", spec.use_pch->pch_path.string());
+        extend(file_flags, use_pch_args(*spec.use_pch));
+        pch_input = spec.use_pch->pch_path;
+    }
+
+    if (spec.scan_modules) {
+        dds_log(trace, "  - scan module dependencies: {}", spec.scan_modules->ddi_path.string());
+        extend(file_flags, scan_modules_args(*spec.scan_modules));
+    } else if (spec.module_mapper) {
+        dds_log(trace, "  - module mapper: {}", spec.module_mapper->string());
+        extend(file_flags, use_modules_args(*spec.module_mapper));
+    }
+
+    auto in_str  = spec.source_path.string();
+    auto out_str = spec.out_path.string();
+
+    std::optional<fs::path> gnu_depfile_path;
+    vector<string>          deps_flags;
     if (_deps_mode == file_deps_mode::gnu) {
         gnu_depfile_path = spec.out_path;
         gnu_depfile_path->replace_extension(gnu_depfile_path->extension().string() + ".d");
-        extend(flags,
-               {"-MD"sv,
-                "-MF"sv,
-                std::string_view(gnu_depfile_path->string()),
-                "-MQ"sv,
-                std::string_view(spec.out_path.string())});
+        deps_flags = {"-MD", "-MF", gnu_depfile_path->string(), "-MQ", out_str};
     } else if (_deps_mode == file_deps_mode::msvc) {
-        flags.push_back("/showIncludes");
+        deps_flags.push_back("/showIncludes");
     }
 
     vector<string> command;
     auto&          cmd_template = lang == language::c ? _c_compile : _cxx_compile;
-    for (auto arg : cmd_template) {
+    command.reserve(cmd_template.size() + tmpl.leading_flags.size() + file_flags.size()
+                    + tmpl.trailing_flags.size() + deps_flags.size());
+    for (auto& arg : cmd_template) {
         if (arg == "[flags]") {
-            extend(command, flags);
-        } else {
-            arg = replace(arg, "[in]", spec.source_path.string());
-            arg = replace(arg, "[out]", spec.out_path.string());
+            extend(command, tmpl.leading_flags);
+            extend(command, file_flags);
+            extend(command, tmpl.trailing_flags);
+            extend(command, deps_flags);
+        } else if (arg.find('[') == arg.npos) {
             command.push_back(arg);
+        } else {
+            command.push_back(replace(replace(arg, "[in]", in_str), "[out]", out_str));
         }
     }
-    return {command, gnu_depfile_path};
+    return {std::move(command), std::move(gnu_depfile_path), std::move(pch_input)};
 }
 
 vector<string> toolchain::create_archive_command(const archive_spec& spec,
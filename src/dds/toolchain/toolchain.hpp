@@ -16,11 +16,42 @@ enum class language {
     cxx,
 };
 
+/**
+ * A directory whose path should be replaced with a fixed name wherever the compiler would
+ * otherwise record the absolute path, such as in debug information and `__FILE__`
+ */
+struct path_prefix_map {
+    fs::path    from;
+    std::string to;
+};
+
 struct toolchain_knobs {
     bool is_tty = false;
     // Directory storing tweaks for the compilation
-    std::optional<fs::path>    tweaks_dir{};
-    std::optional<std::string> cache_buster{};
+    std::optional<fs::path> tweaks_dir{};
+    // Path prefixes to remap in compiler outputs. More specific prefixes must come later.
+    std::vector<path_prefix_map> prefix_maps{};
+};
+
+/**
+ * A precompiled header that is created or used by a compilation
+ */
+struct pch_spec {
+    /// The header that is precompiled
+    fs::path header;
+    /// The precompiled header file. Compilers that search for it beside the header expect it to be
+    /// named by the header's path followed by the toolchain's `pch_suffix()`.
+    fs::path pch_path;
+};
+
+/**
+ * A scan of the C++ module dependencies of a translation unit
+ */
+struct module_scan_spec {
+    /// The file to which the module dependencies are written, in the P1689 format
+    fs::path ddi_path;
+    /// The object file that will be compiled from the translation unit
+    fs::path object_path;
 };
 
 struct compile_file_spec {
@@ -31,11 +62,37 @@ struct compile_file_spec {
     std::vector<fs::path>    external_include_dirs = {};
     language                 lang                  = language::automatic;
     bool                     enable_warnings       = false;
+    // If set, the compilation precompiles this header instead of compiling a source file
+    std::optional<pch_spec> create_pch = std::nullopt;
+    // If set, the compilation includes this precompiled header before its source file
+    std::optional<pch_spec> use_pch = std::nullopt;
+    // If set, the source file is only scanned for module dependencies, rather than compiled
+    std::optional<module_scan_spec> scan_modules = std::nullopt;
+    // If set, the compilation provides or imports modules, whose interface files are named in
+    // this module mapper file
+    std::optional<fs::path> module_mapper = std::nullopt;
 };
 
 struct compile_command_info {
     std::vector<std::string> command;
     std::optional<fs::path>  gnu_depfile_path;
+    // The precompiled header that is read by the compilation. Compilers do not list it among the
+    // dependencies of their output.
+    std::optional<fs::path> pch_input = std::nullopt;
+};
+
+/**
+ * The flags of a compile command that are determined by the rules of the compilation rather than
+ * by the file that is compiled: The #include search directories, the preprocessor definitions, the
+ * warning flags, and the flags given by the toolchain knobs. Files that are compiled with the same
+ * rules share a template, and the compile command of each file is created by adding the flags that
+ * are particular to it.
+ */
+struct compile_command_template {
+    // The flags that precede the flags of each file
+    std::vector<std::string> leading_flags;
+    // The flags that follow the flags of each file, except for its dependency output flags
+    std::vector<std::string> trailing_flags;
 };
 
 struct archive_spec {
@@ -62,6 +119,11 @@ class toolchain {
     string_seq _link_exe;
     string_seq _warning_flags;
     string_seq _tty_flags;
+    string_seq _prefix_map_template;
+    string_seq _create_pch_template;
+    string_seq _use_pch_template;
+    string_seq _scan_modules_template;
+    string_seq _use_modules_template;
 
     std::string _archive_prefix;
     std::string _archive_suffix;
@@ -69,6 +131,8 @@ class toolchain {
     std::string _object_suffix;
     std::string _exe_prefix;
     std::string _exe_suffix;
+    std::string _pch_suffix;
+    std::string _bmi_suffix;
 
     enum file_deps_mode _deps_mode;
 
@@ -80,15 +144,62 @@ public:
     auto& archive_suffix() const noexcept { return _archive_suffix; }
     auto& object_suffix() const noexcept { return _object_suffix; }
     auto& executable_suffix() const noexcept { return _exe_suffix; }
+    auto& pch_suffix() const noexcept { return _pch_suffix; }
+    auto& bmi_suffix() const noexcept { return _bmi_suffix; }
     auto  deps_mode() const noexcept { return _deps_mode; }
 
+    /**
+     * Whether the toolchain is able to create and use precompiled headers
+     */
+    bool supports_pch() const noexcept {
+        return !_create_pch_template.empty() && !_use_pch_template.empty() && !_pch_suffix.empty();
+    }
+
+    /**
+     * Whether creating a precompiled header also creates an object file, which must be linked
+     * together with the objects that use the precompiled header. If so, the object file is the
+     * output of the compilation, and the precompiled header is written to the `[pch]` path.
+     */
+    bool pch_creates_object() const noexcept;
+
+    /**
+     * Whether the toolchain is able to scan for C++ module dependencies, and to compile the
+     * translation units that provide and import modules
+     */
+    bool supports_modules() const noexcept {
+        return !_scan_modules_template.empty() && !_use_modules_template.empty()
+            && !_bmi_suffix.empty();
+    }
+
     std::vector<std::string> definition_args(std::string_view s) const noexcept;
     std::vector<std::string> include_args(const fs::path& p) const noexcept;
     std::vector<std::string> external_include_args(const fs::path& p) const noexcept;
+    std::vector<std::string> prefix_map_args(const path_prefix_map& map) const noexcept;
+    std::vector<std::string> create_pch_args(const pch_spec& pch) const noexcept;
+    std::vector<std::string> use_pch_args(const pch_spec& pch) const noexcept;
+    std::vector<std::string> scan_modules_args(const module_scan_spec& scan) const noexcept;
+    std::vector<std::string> use_modules_args(path_ref mapper) const noexcept;
 
     compile_command_info
     create_compile_command(const compile_file_spec&, path_ref cwd, toolchain_knobs) const noexcept;
 
+    /**
+     * Create the flags that are shared by the compile commands of files that have the same include
+     * directories, definitions, and warnings as the given spec. Only those attributes of the spec
+     * are used.
+     */
+    compile_command_template create_compile_command_template(const compile_file_spec&,
+                                                             path_ref cwd,
+                                                             toolchain_knobs) const noexcept;
+
+    /**
+     * Create the compile command for the given file from a template that was created for its rules.
+     * The include directories, definitions, and warnings of the spec are ignored in favor of those
+     * of the template.
+     */
+    compile_command_info create_compile_command(const compile_file_spec&,
+                                                const compile_command_template&) const noexcept;
+
     std::vector<std::string>
     create_archive_command(const archive_spec&, path_ref cwd, toolchain_knobs) const noexcept;
 
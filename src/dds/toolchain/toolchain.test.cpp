@@ -1,8 +1,80 @@
 #include <dds/toolchain/toolchain.hpp>
 
+#include <dds/toolchain/from_json.hpp>
+#include <dds/util/time.hpp>
+
 #include <catch2/catch.hpp>
+#include <fmt/core.h>
+
+#include <iostream>
 
 TEST_CASE("Builtin toolchains reject multiple standards") {
     const std::optional<dds::toolchain> parsed = dds::toolchain::get_builtin("c++11:c++14:gcc");
     CHECK_FALSE(parsed.has_value());
 }
+
+namespace {
+
+dds::compile_file_spec make_shared_spec() {
+    dds::compile_file_spec spec;
+    for (int i = 0; i < 30; ++i) {
+        spec.include_dirs.push_back(dds::fs::current_path() / fmt::format("include-{}", i));
+        spec.external_include_dirs.push_back(dds::fs::current_path() / fmt::format("ext-{}", i));
+        spec.definitions.push_back(fmt::format("DEFINE_{}=1", i));
+    }
+    spec.enable_warnings = true;
+    return spec;
+}
+
+}  // namespace
+
+TEST_CASE("Create compile commands from a shared template") {
+    auto                 tc = dds::parse_toolchain_json5("{compiler_id: 'gnu'}");
+    dds::toolchain_knobs knobs{
+        .is_tty      = true,
+        .prefix_maps = {{"/work/proj", "proj"}},
+    };
+    auto spec = make_shared_spec();
+    auto tmpl = tc.create_compile_command_template(spec, dds::fs::current_path(), knobs);
+
+    spec.source_path = "foo.cpp";
+    spec.out_path    = "foo.o";
+    spec.use_pch     = dds::pch_spec{"pch.hpp", "pch.hpp.gch"};
+    auto direct      = tc.create_compile_command(spec, dds::fs::current_path(), knobs);
+    auto templated   = tc.create_compile_command(spec, tmpl);
+    CHECK(templated.command == direct.command);
+    CHECK(templated.gnu_depfile_path == direct.gnu_depfile_path);
+    CHECK(templated.pch_input == direct.pch_input);
+
+    // The template supplies the include directories, not the spec
+    spec.include_dirs.clear();
+    CHECK(tc.create_compile_command(spec, tmpl).command == direct.command);
+}
+
+TEST_CASE("Compile command construction time", "[.][bench]") {
+    auto tc    = dds::parse_toolchain_json5("{compiler_id: 'gnu'}");
+    auto cwd   = dds::fs::current_path();
+    auto specs = std::vector<dds::compile_file_spec>(10'000, make_shared_spec());
+    for (auto i = 0u; i < specs.size(); ++i) {
+        specs[i].source_path = cwd / fmt::format("src/file-{}.cpp", i);
+        specs[i].out_path    = cwd / fmt::format("_build/obj/file-{}.cpp.o", i);
+    }
+
+    std::size_t    n_args = 0;
+    dds::stopwatch timer;
+    for (auto& spec : specs) {
+        n_args += tc.create_compile_command(spec, cwd, {}).command.size();
+    }
+    auto direct_ms = timer.elapsed_ms().count();
+
+    timer.reset();
+    auto tmpl = tc.create_compile_command_template(specs.front(), cwd, {});
+    for (auto& spec : specs) {
+        n_args -= tc.create_compile_command(spec, tmpl).command.size();
+    }
+    auto templated_ms = timer.elapsed_ms().count();
+
+    CHECK(n_args == 0);
+    std::cout << "Created " << specs.size() << " compile commands in " << direct_ms
+              << "ms, or in " << templated_ms << "ms from a shared template\n";
+}
@@ -6,7 +6,9 @@
 
 #include <fmt/core.h>
 
+#include <algorithm>
 #include <stdexcept>
+#include <unordered_set>
 
 using namespace dds;
 
@@ -21,6 +23,7 @@ const lm::library* usage_requirement_map::get(const lm::usage& key) const noexce
 lm::library& usage_requirement_map::add(std::string ns, std::string name) {
     auto pair                   = std::pair(library_key{ns, name}, lm::library{});
     auto [inserted, did_insert] = _reqs.try_emplace(library_key{ns, name}, lm::library());
+    _closures.clear();
     if (!did_insert) {
         throw_user_error<errc::dup_lib_name>("More than one library is registered as `{}/{}'",
                                              ns,
@@ -39,38 +42,115 @@ usage_requirement_map usage_requirement_map::from_lm_index(const lm::index& idx)
     return ret;
 }
 
+namespace {
+
+/// Remove all but the first occurrence of each path
+void keep_first_occurrences(std::vector<fs::path>& paths) {
+    std::unordered_set<std::string> seen;
+    std::erase_if(paths, [&](const fs::path& p) { return !seen.insert(p.native()).second; });
+}
+
+/// Remove all but the last occurrence of each path. If the given paths are the concatenation of
+/// several dependency-ordered sequences, the result is dependency-ordered.
+void keep_last_occurrences(std::vector<fs::path>& paths) {
+    std::reverse(paths.begin(), paths.end());
+    keep_first_occurrences(paths);
+    std::reverse(paths.begin(), paths.end());
+}
+
+}  // namespace
+
+const usage_requirement_map::closure&
+usage_requirement_map::_closure_of(const lm::usage& key, closure_map& memo) const {
+    // The libraries whose closures are being computed, for detecting cycles
+    std::vector<const lm::usage*> path;
+
+    auto visit = [&](auto& visit, const lm::usage& key) -> const closure& {
+        auto found = memo.find(key);
+        if (found != memo.end()) {
+            return found->second;
+        }
+        auto on_path = std::find_if(path.begin(), path.end(), [&](auto u) {
+            return u->namespace_ == key.namespace_ && u->name == key.name;
+        });
+        if (on_path != path.end()) {
+            std::string cycle;
+            for (auto it = on_path; it != path.end(); ++it) {
+                cycle += fmt::format("'{}/{}' -> ", (*it)->namespace_, (*it)->name);
+            }
+            cycle += fmt::format("'{}/{}'", key.namespace_, key.name);
+            throw_user_error<errc::usage_cycle>("Libraries use or link each other in a cycle: {}",
+                                                cycle);
+        }
+        auto lib = get(key);
+        if (!lib) {
+            if (path.empty()) {
+                throw_user_error<errc::unknown_usage_name>(
+                    "Unable to find usage requirements for '{}/{}'",
+                    key.namespace_,
+                    key.name);
+            }
+            throw_user_error<errc::unknown_usage_name>(
+                "Unable to find usage requirements for '{}/{}' (Required by '{}/{}')",
+                key.namespace_,
+                key.name,
+                path.back()->namespace_,
+                path.back()->name);
+        }
+
+        path.push_back(&key);
+        closure ret;
+        ret.include_paths = lib->include_paths;
+        if (lib->linkable_path) {
+            ret.link_paths.push_back(*lib->linkable_path);
+        }
+        for (const auto& dep : lib->uses) {
+            auto& dep_closure = visit(visit, dep);
+            extend(ret.include_paths, dep_closure.include_paths);
+            extend(ret.link_paths, dep_closure.link_paths);
+        }
+        for (const auto& link : lib->links) {
+            extend(ret.link_paths, visit(visit, link).link_paths);
+        }
+        path.pop_back();
+
+        keep_first_occurrences(ret.include_paths);
+        keep_last_occurrences(ret.link_paths);
+        return memo.emplace(key, std::move(ret)).first->second;
+    };
+    return visit(visit, key);
+}
+
+void usage_requirement_map::compute_closures() {
+    closure_map closures;
+    for (auto& [key, lib] : _reqs) {
+        _closure_of(key, closures);
+    }
+    _closures = std::move(closures);
+}
+
 std::vector<fs::path> usage_requirement_map::link_paths(const lm::usage& key) const {
-    auto req = get(key);
-    if (!req) {
-        throw_user_error<errc::unknown_usage_name>("Unable to find linking requirement '{}/{}'",
-                                                   key.namespace_,
-                                                   key.name);
+    if (auto found = _closures.find(key); found != _closures.end()) {
+        return found->second.link_paths;
     }
+    closure_map memo;
+    return _closure_of(key, memo).link_paths;
+}
+
+std::vector<fs::path>
+usage_requirement_map::combined_link_paths(const std::vector<lm::usage>& keys) const {
     std::vector<fs::path> ret;
-    if (req->linkable_path) {
-        ret.push_back(*req->linkable_path);
-    }
-    for (const auto& dep : req->uses) {
-        extend(ret, link_paths(dep));
-    }
-    for (const auto& link : req->links) {
-        extend(ret, link_paths(link));
+    for (auto& key : keys) {
+        extend(ret, link_paths(key));
     }
+    keep_last_occurrences(ret);
     return ret;
 }
 
 std::vector<fs::path> usage_requirement_map::include_paths(const lm::usage& usage) const {
-    std::vector<fs::path> ret;
-    auto                  lib = get(usage.namespace_, usage.name);
-    if (!lib) {
-        throw_user_error<
-            errc::unknown_usage_name>("Cannot find non-existent usage requirements for '{}/{}'",
-                                      usage.namespace_,
-                                      usage.name);
-    }
-    extend(ret, lib->include_paths);
-    for (const auto& transitive : lib->uses) {
-        extend(ret, include_paths(transitive));
+    if (auto found = _closures.find(usage); found != _closures.end()) {
+        return found->second.include_paths;
     }
-    return ret;
+    closure_map memo;
+    return _closure_of(usage, memo).include_paths;
 }
@@ -8,6 +8,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 namespace dds {
 
@@ -32,17 +33,54 @@ class usage_requirement_map {
         }
     };
 
+    /// The transitive requirements of a library
+    struct closure {
+        /// The include directories of the library and of every library that it uses, without
+        /// duplicates
+        std::vector<fs::path> include_paths;
+        /// The linkable files of the library and of every library that it uses or links, without
+        /// duplicates. Each file comes before the files of the libraries that it depends upon.
+        std::vector<fs::path> link_paths;
+    };
+
     std::map<library_key, lm::library, library_key_compare> _reqs;
+    std::map<library_key, closure, library_key_compare>     _closures;
+
+    using closure_map = decltype(_closures);
+    const closure& _closure_of(const lm::usage&, closure_map&) const;
 
 public:
     const lm::library* get(const lm::usage& key) const noexcept;
     const lm::library* get(std::string ns, std::string name) const noexcept {
         return get({ns, name});
     }
+    /**
+     * Add a library with the given name. This discards the closures that were computed by
+     * `compute_closures()`.
+     */
     lm::library& add(std::string ns, std::string name);
     void         add(std::string ns, std::string name, lm::library lib) { add(ns, name) = lib; }
 
+    /**
+     * Compute the transitive requirements of every library, so that they are not computed again by
+     * each call to `link_paths()` or `include_paths()`. Libraries must not be modified afterwards.
+     * @throws user_error<errc::usage_cycle> if libraries use or link each other in a cycle
+     * @throws user_error<errc::unknown_usage_name> if a library uses or links an unknown library
+     */
+    void compute_closures();
+
+    /**
+     * The files to link for the given library, and for every library that it uses or links. Each
+     * file is given once, before the files of the libraries that it depends upon.
+     */
     std::vector<fs::path> link_paths(const lm::usage&) const;
+    /**
+     * The files to link for all of the given libraries, as for the single library version
+     */
+    std::vector<fs::path> combined_link_paths(const std::vector<lm::usage>&) const;
+    /**
+     * The include directories of the given library, and of every library that it uses
+     */
     std::vector<fs::path> include_paths(const lm::usage& req) const;
 
     static usage_requirement_map from_lm_index(const lm::index&) noexcept;
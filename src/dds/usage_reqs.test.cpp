@@ -0,0 +1,62 @@
+#include <dds/usage_reqs.hpp>
+
+#include <dds/error/errors.hpp>
+
+#include <catch2/catch.hpp>
+
+namespace {
+
+lm::library& add_lib(dds::usage_requirement_map& ureqs,
+                     std::string                 name,
+                     std::vector<lm::usage>      uses,
+                     std::vector<lm::usage>      links = {}) {
+    auto& lib = ureqs.add("test", name);
+    lib.include_paths.push_back(name + "/include");
+    lib.linkable_path = name + ".a";
+    lib.uses          = std::move(uses);
+    lib.links         = std::move(links);
+    return lib;
+}
+
+using paths = std::vector<dds::fs::path>;
+
+}  // namespace
+
+TEST_CASE("Usage requirements of a diamond") {
+    dds::usage_requirement_map ureqs;
+    add_lib(ureqs, "base", {});
+    add_lib(ureqs, "left", {{"test", "base"}});
+    add_lib(ureqs, "right", {}, {{"test", "base"}});
+    add_lib(ureqs, "top", {{"test", "left"}, {"test", "right"}});
+
+    auto check = [&] {
+        CHECK(ureqs.link_paths({"test", "top"}) == paths{"top.a", "left.a", "right.a", "base.a"});
+        // Only `uses` propagate include directories
+        CHECK(ureqs.include_paths({"test", "top"})
+              == paths{"top/include", "left/include", "base/include", "right/include"});
+        CHECK(ureqs.include_paths({"test", "right"}) == paths{"right/include"});
+        // Libraries shared by several links are only linked once, after everything that needs them
+        CHECK(ureqs.combined_link_paths({{"test", "base"}, {"test", "left"}})
+              == paths{"left.a", "base.a"});
+    };
+    check();
+    ureqs.compute_closures();
+    check();
+}
+
+TEST_CASE("Usage requirements may not form a cycle") {
+    dds::usage_requirement_map ureqs;
+    add_lib(ureqs, "a", {{"test", "b"}});
+    add_lib(ureqs, "b", {}, {{"test", "c"}});
+    add_lib(ureqs, "c", {{"test", "a"}});
+    CHECK_THROWS_AS(ureqs.compute_closures(), dds::user_error<dds::errc::usage_cycle>);
+    CHECK_THROWS_AS(ureqs.link_paths({"test", "b"}), dds::user_error<dds::errc::usage_cycle>);
+}
+
+TEST_CASE("Usage requirements must be known") {
+    dds::usage_requirement_map ureqs;
+    add_lib(ureqs, "a", {{"test", "missing"}});
+    CHECK_THROWS_AS(ureqs.compute_closures(), dds::user_error<dds::errc::unknown_usage_name>);
+    CHECK_THROWS_AS(ureqs.include_paths({"test", "nope"}),
+                    dds::user_error<dds::errc::unknown_usage_name>);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <dds/util/fs.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace dds {
+
+/**
+ * The changes to the files within a set of watched directories
+ */
+struct fs_changes {
+    /// Files whose content or attributes have been modified
+    std::vector<fs::path> modified;
+    /// Files and directories that have been created, removed, or renamed
+    std::vector<fs::path> created_or_removed;
+    /// Whether changes have been lost because too many occurred at once, so any file may have
+    /// changed
+    bool overflowed = false;
+
+    bool empty() const noexcept {
+        return modified.empty() && created_or_removed.empty() && !overflowed;
+    }
+};
+
+/**
+ * Watches directory trees for changes to the files within them. Directories that are created within
+ * a watched tree are watched as well.
+ *
+ * This is only implemented on Linux, using inotify. On other platforms, the constructor throws.
+ */
+class fs_watcher {
+    struct impl;
+    std::unique_ptr<impl> _impl;
+
+public:
+    /**
+     * Begin watching the given directories, and every directory within them.
+     * @param roots The directories to watch
+     * @param excluded Directories within the roots that are not watched, along with their contents
+     * @throws std::system_error if the directories cannot be watched, such as when the system's
+     * limit on the number of watches is reached
+     */
+    fs_watcher(const std::vector<fs::path>& roots, std::vector<fs::path> excluded);
+    ~fs_watcher();
+
+    /**
+     * Collect the changes that have occurred since the watcher was created, or since the previous
+     * call. This does not wait for any change to occur.
+     */
+    fs_changes collect();
+};
+
+}  // namespace dds
@@ -0,0 +1,160 @@
+#if __linux__
+
+#include "./fs_watch.hpp"
+
+#include <dds/util/algo.hpp>
+#include <dds/util/log.hpp>
+
+#include <fmt/core.h>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <system_error>
+
+using namespace dds;
+
+namespace {
+
+constexpr std::uint32_t watch_mask = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE
+    | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK;
+
+[[noreturn]] void throw_errno(std::string_view what, path_ref p) {
+    throw std::system_error(std::error_code(errno, std::system_category()),
+                            fmt::format("{} [{}]", what, p.string()));
+}
+
+}  // namespace
+
+struct fs_watcher::impl {
+    int                     fd = -1;
+    std::map<int, fs::path> dirs;
+    std::vector<fs::path>   excluded;
+
+    ~impl() {
+        if (fd != -1) {
+            ::close(fd);
+        }
+    }
+
+    void watch_tree(path_ref dir) {
+        if (std::find(excluded.begin(), excluded.end(), dir) != excluded.end()) {
+            return;
+        }
+        auto wd = ::inotify_add_watch(fd, dir.c_str(), watch_mask);
+        if (wd == -1) {
+            if (errno == ENOENT || errno == ENOTDIR) {
+                // Removed before we got to it. The removal is reported by its parent.
+                return;
+            }
+            if (errno == ENOSPC) {
+                throw_errno("Reached the limit on inotify watches (Refer to the "
+                            "fs.inotify.max_user_watches setting) while watching directory",
+                            dir);
+            }
+            throw_errno("Failed to watch directory", dir);
+        }
+        // A directory that is moved within the tree keeps its watch, which is now at a new path
+        dirs[wd] = dir;
+
+        std::error_code ec;
+        for (auto& entry : fs::directory_iterator{dir, ec}) {
+            if (entry.is_directory(ec) && !entry.is_symlink(ec)) {
+                watch_tree(entry.path());
+            }
+        }
+    }
+
+    void unwatch_tree(path_ref dir) {
+        std::erase_if(dirs, [&](auto& pair) {
+            auto rel = pair.second.lexically_relative(dir);
+            if (rel.empty() || *rel.begin() == "..") {
+                return false;
+            }
+            ::inotify_rm_watch(fd, pair.first);
+            return true;
+        });
+    }
+};
+
+fs_watcher::fs_watcher(const std::vector<fs::path>& roots, std::vector<fs::path> excluded)
+    : _impl(std::make_unique<impl>()) {
+    _impl->fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_impl->fd == -1) {
+        throw std::system_error(std::error_code(errno, std::system_category()),
+                                "Failed to create an inotify instance");
+    }
+    for (auto& dir : excluded) {
+        _impl->excluded.push_back(fs::weakly_canonical(dir));
+    }
+    for (auto& root : roots) {
+        _impl->watch_tree(fs::weakly_canonical(root));
+    }
+    dds_log(debug, "Watching {} directories for changes", _impl->dirs.size());
+}
+
+fs_watcher::~fs_watcher() = default;
+
+fs_changes fs_watcher::collect() {
+    fs_changes ret;
+    // Events are aligned to the alignment of the event structure
+    alignas(::inotify_event) char buf[64 * 1024];
+    while (true) {
+        auto n_read = ::read(_impl->fd, buf, sizeof buf);
+        if (n_read == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            throw std::system_error(std::error_code(errno, std::system_category()),
+                                    "Failed to read inotify events");
+        }
+
+        for (char* ptr = buf; ptr < buf + n_read;) {
+            ::inotify_event ev;
+            std::memcpy(&ev, ptr, sizeof ev);
+            std::string_view name{ptr + sizeof ev, ev.len};
+            name = name.substr(0, name.find('\0'));
+            ptr += sizeof ev + ev.len;
+
+            if (ev.mask & IN_Q_OVERFLOW) {
+                ret.overflowed = true;
+                continue;
+            }
+            auto dir = _impl->dirs.find(ev.wd);
+            if (dir == _impl->dirs.end()) {
+                continue;
+            }
+            if (ev.mask & IN_IGNORED) {
+                // The directory is gone, and so is its watch
+                _impl->dirs.erase(dir);
+                continue;
+            }
+            auto path = name.empty() ? dir->second : dir->second / name;
+            if ((ev.mask & (IN_CREATE | IN_MOVED_TO)) && (ev.mask & IN_ISDIR)) {
+                _impl->watch_tree(path);
+            }
+            if ((ev.mask & IN_MOVE_SELF) && !fs::is_directory(path)) {
+                // Moved out of the watched trees, so the paths of its watches are meaningless
+                _impl->unwatch_tree(path);
+            }
+            if (ev.mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF
+                           | IN_MOVE_SELF)) {
+                ret.created_or_removed.push_back(std::move(path));
+            } else if (ev.mask & (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE)) {
+                ret.modified.push_back(std::move(path));
+            }
+        }
+    }
+    sort_unique_erase(ret.modified);
+    sort_unique_erase(ret.created_or_removed);
+    return ret;
+}
+
+#endif
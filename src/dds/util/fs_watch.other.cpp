@@ -0,0 +1,20 @@
+#if !__linux__
+
+#include "./fs_watch.hpp"
+
+#include <system_error>
+
+using namespace dds;
+
+struct fs_watcher::impl {};
+
+fs_watcher::fs_watcher(const std::vector<fs::path>&, std::vector<fs::path>) {
+    throw std::system_error(std::make_error_code(std::errc::function_not_supported),
+                            "Watching for file changes is not supported on this platform");
+}
+
+fs_watcher::~fs_watcher() = default;
+
+fs_changes fs_watcher::collect() { return {}; }
+
+#endif
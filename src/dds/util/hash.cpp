@@ -0,0 +1,150 @@
+#include "./hash.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <system_error>
+
+using namespace dds;
+
+namespace {
+
+constexpr std::array<std::uint32_t, 64> round_constants = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+constexpr std::uint32_t rotr(std::uint32_t v, int n) noexcept { return (v >> n) | (v << (32 - n)); }
+
+}  // namespace
+
+sha256::sha256() noexcept
+    : _state{0x6a09e667,
+             0xbb67ae85,
+             0x3c6ef372,
+             0xa54ff53a,
+             0x510e527f,
+             0x9b05688c,
+             0x1f83d9ab,
+             0x5be0cd19} {}
+
+void sha256::_compress(const unsigned char* block) noexcept {
+    std::array<std::uint32_t, 64> w;
+    for (int i = 0; i < 16; ++i) {
+        w[i] = (std::uint32_t(block[i * 4]) << 24) | (std::uint32_t(block[i * 4 + 1]) << 16)
+            | (std::uint32_t(block[i * 4 + 2]) << 8) | std::uint32_t(block[i * 4 + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+        auto s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        auto s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i]    = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    auto [a, b, c, d, e, f, g, h] = _state;
+    for (int i = 0; i < 64; ++i) {
+        auto s1    = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+        auto ch    = (e & f) ^ (~e & g);
+        auto temp1 = h + s1 + ch + round_constants[i] + w[i];
+        auto s0    = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+        auto maj   = (a & b) ^ (a & c) ^ (b & c);
+        auto temp2 = s0 + maj;
+        h          = g;
+        g          = f;
+        f          = e;
+        e          = d + temp1;
+        d          = c;
+        c          = b;
+        b          = a;
+        a          = temp1 + temp2;
+    }
+
+    _state[0] += a;
+    _state[1] += b;
+    _state[2] += c;
+    _state[3] += d;
+    _state[4] += e;
+    _state[5] += f;
+    _state[6] += g;
+    _state[7] += h;
+}
+
+void sha256::update(std::string_view bytes) noexcept {
+    auto ptr = reinterpret_cast<const unsigned char*>(bytes.data());
+    auto len = bytes.size();
+    _total_len += len;
+
+    if (_block_len != 0) {
+        auto n = std::min(len, _block.size() - _block_len);
+        std::memcpy(_block.data() + _block_len, ptr, n);
+        _block_len += n;
+        ptr += n;
+        len -= n;
+        if (_block_len < _block.size()) {
+            return;
+        }
+        _compress(_block.data());
+        _block_len = 0;
+    }
+
+    while (len >= _block.size()) {
+        _compress(ptr);
+        ptr += _block.size();
+        len -= _block.size();
+    }
+
+    std::memcpy(_block.data(), ptr, len);
+    _block_len = len;
+}
+
+std::string sha256::hex_digest() noexcept {
+    auto bit_len = _total_len * 8;
+
+    // Pad with a single set bit, then zeros until there is room for the 64-bit length at the end
+    const unsigned char one_bit = 0x80;
+    update(std::string_view(reinterpret_cast<const char*>(&one_bit), 1));
+    const char zeros[64] = {};
+    auto       pad_len   = (_block_len <= 56) ? 56 - _block_len : 120 - _block_len;
+    update(std::string_view(zeros, pad_len));
+
+    unsigned char len_bytes[8];
+    for (int i = 0; i < 8; ++i) {
+        len_bytes[i] = static_cast<unsigned char>(bit_len >> (56 - i * 8));
+    }
+    update(std::string_view(reinterpret_cast<const char*>(len_bytes), 8));
+
+    constexpr std::string_view hex_chars = "0123456789abcdef";
+    std::string                ret;
+    ret.reserve(64);
+    for (auto word : _state) {
+        for (int shift = 28; shift >= 0; shift -= 4) {
+            ret.push_back(hex_chars[(word >> shift) & 0xf]);
+        }
+    }
+    return ret;
+}
+
+std::string dds::sha256_hex(std::string_view bytes) noexcept {
+    sha256 hash;
+    hash.update(bytes);
+    return hash.hex_digest();
+}
+
+std::string dds::sha256_file(path_ref file) {
+    auto                    in = dds::open(file, std::ios::in | std::ios::binary);
+    sha256                  hash;
+    std::array<char, 65536> buf;
+    while (in) {
+        in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+        hash.update(std::string_view(buf.data(), static_cast<std::size_t>(in.gcount())));
+    }
+    if (in.bad()) {
+        throw std::system_error(std::make_error_code(std::errc::io_error),
+                                "Failed to read file for hashing: " + file.string());
+    }
+    return hash.hex_digest();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <dds/util/fs.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace dds {
+
+/**
+ * Incrementally computes a SHA-256 digest. Feed data with `update()`, then obtain the digest with
+ * `hex_digest()`.
+ */
+class sha256 {
+    std::array<std::uint32_t, 8>  _state;
+    std::array<unsigned char, 64> _block{};
+    std::size_t                   _block_len = 0;
+    std::uint64_t                 _total_len = 0;
+
+    void _compress(const unsigned char* block) noexcept;
+
+public:
+    sha256() noexcept;
+
+    /**
+     * Append the given bytes to the hashed data
+     */
+    void update(std::string_view bytes) noexcept;
+
+    /**
+     * Finish the digest and return it as a string of 64 lowercase hexadecimal digits. No more data
+     * may be added afterwards.
+     */
+    std::string hex_digest() noexcept;
+};
+
+/**
+ * Compute the SHA-256 digest of the given bytes, as a string of hexadecimal digits
+ */
+std::string sha256_hex(std::string_view bytes) noexcept;
+
+/**
+ * Compute the SHA-256 digest of the content of the given file, as a string of hexadecimal digits.
+ * Throws if the file cannot be read.
+ */
+std::string sha256_file(path_ref file);
+
+}  // namespace dds
@@ -0,0 +1,32 @@
+#include <dds/util/hash.hpp>
+
+#include <catch2/catch.hpp>
+
+TEST_CASE("Compute SHA-256 digests") {
+    struct case_ {
+        std::string_view input;
+        std::string_view expect;
+    };
+
+    auto cur = GENERATE(Catch::Generators::values<case_>({
+        {"", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+        {"abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+        {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+         "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+    }));
+
+    CHECK(dds::sha256_hex(cur.input) == cur.expect);
+}
+
+TEST_CASE("SHA-256 of data given in pieces") {
+    std::string data(1000, 'a');
+
+    // Feed the data in uneven pieces that straddle the internal block boundaries
+    dds::sha256 hash;
+    for (std::size_t pos = 0; pos < data.size(); pos += 37) {
+        hash.update(std::string_view(data).substr(pos, 37));
+    }
+    CHECK(hash.hex_digest() == dds::sha256_hex(data));
+    CHECK(dds::sha256_hex(std::string(1'000'000, 'a'))
+          == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
@@ -0,0 +1,51 @@
+#include "./intern.hpp"
+
+#include <cassert>
+#include <mutex>
+
+using namespace dds;
+
+string_table::id string_table::intern(std::string_view str) {
+    {
+        std::shared_lock lk{_mut};
+        auto             found = _index.find(str);
+        if (found != _index.end()) {
+            return found->second;
+        }
+    }
+    std::unique_lock lk{_mut};
+    // Another thread may have added it while we were unlocked
+    auto found = _index.find(str);
+    if (found != _index.end()) {
+        return found->second;
+    }
+    auto  new_id = static_cast<id>(_strings.size());
+    auto& stored = _strings.emplace_back(str);
+    _index.emplace(stored, new_id);
+    _n_bytes += stored.capacity() + 1;
+    return new_id;
+}
+
+const std::string& string_table::get(id i) const noexcept {
+    std::shared_lock lk{_mut};
+    assert(i < _strings.size());
+    return _strings[i];
+}
+
+std::size_t string_table::size() const noexcept {
+    std::shared_lock lk{_mut};
+    return _strings.size();
+}
+
+std::size_t string_table::memory_usage() const noexcept {
+    std::shared_lock lk{_mut};
+    // Each entry also costs a string object in the deque and a node in the index
+    auto per_entry
+        = sizeof(std::string) + sizeof(std::string_view) + sizeof(id) + 2 * sizeof(void*);
+    return _n_bytes + _strings.size() * per_entry;
+}
+
+string_table& string_table::global() noexcept {
+    static string_table inst;
+    return inst;
+}
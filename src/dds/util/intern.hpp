@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace dds {
+
+/**
+ * A thread-safe, append-only table of strings. Each distinct string is stored once, and is
+ * identified by a small integer that remains valid (along with references to the stored string)
+ * for the lifetime of the table.
+ *
+ * Build plans hold many copies of the same few strings, such as the qualified name and output
+ * directory of a library, which is repeated for every one of its source files. Interning them
+ * keeps each plan small.
+ */
+class string_table {
+public:
+    using id = std::uint32_t;
+
+private:
+    mutable std::shared_mutex _mut;
+    // A deque never moves its elements, so the views held by the index remain valid
+    std::deque<std::string>                   _strings;
+    std::unordered_map<std::string_view, id> _index;
+    std::size_t                               _n_bytes = 0;
+
+public:
+    /**
+     * Get the ID of the given string, adding it to the table if it is not already present
+     */
+    id intern(std::string_view str);
+
+    /**
+     * Get the string that has the given ID. The ID must have been returned by `intern()`.
+     */
+    const std::string& get(id) const noexcept;
+
+    /**
+     * The number of distinct strings in the table
+     */
+    std::size_t size() const noexcept;
+
+    /**
+     * The approximate number of bytes of memory that are used by the table
+     */
+    std::size_t memory_usage() const noexcept;
+
+    /**
+     * Get the table that is shared by the whole process, in which build plans intern their strings
+     */
+    static string_table& global() noexcept;
+};
+
+}  // namespace dds
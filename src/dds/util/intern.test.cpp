@@ -0,0 +1,23 @@
+#include <dds/util/intern.hpp>
+
+#include <catch2/catch.hpp>
+
+TEST_CASE("Intern strings") {
+    dds::string_table table;
+    auto              foo = table.intern("foo");
+    auto              bar = table.intern("bar");
+    CHECK(foo != bar);
+    CHECK(table.intern("foo") == foo);
+    CHECK(table.intern(std::string("bar")) == bar);
+    CHECK(table.size() == 2);
+
+    // References to the stored strings are not invalidated by adding more strings
+    auto& foo_str = table.get(foo);
+    for (int i = 0; i < 1000; ++i) {
+        table.intern(std::to_string(i));
+    }
+    CHECK(&table.get(foo) == &foo_str);
+    CHECK(foo_str == "foo");
+    CHECK(table.get(table.intern("")) == "");
+    CHECK(table.size() == 1003);
+}
@@ -0,0 +1,291 @@
+#include "./job_graph.hpp"
+
+#include <dds/util/log.hpp>
+#include <dds/util/parallel.hpp>
+#include <dds/util/signal.hpp>
+#include <dds/util/time.hpp>
+
+#include <neo/assert.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+using namespace dds;
+
+namespace {
+
+/**
+ * Orders job IDs such that the job with the greatest priority is at the top of a heap. Ties are
+ * broken in favor of the job that was added to the graph first, keeping execution order stable.
+ */
+struct priority_order {
+    const std::vector<job_graph::duration>* priorities;
+
+    bool operator()(job_graph::job_id left, job_graph::job_id right) const noexcept {
+        auto lp = (*priorities)[left];
+        auto rp = (*priorities)[right];
+        if (lp != rp) {
+            return lp < rp;
+        }
+        return left > right;
+    }
+};
+
+using ready_queue
+    = std::priority_queue<job_graph::job_id, std::vector<job_graph::job_id>, priority_order>;
+
+}  // namespace
+
+job_graph::job_id job_graph::add_job(std::function<void()> fn, duration cost) {
+    _jobs.push_back(job{std::move(fn), {}, {}, 0, cost});
+    ++_n_sync_jobs;
+    return _jobs.size() - 1;
+}
+
+job_graph::job_id job_graph::add_async_job(std::function<void(async_done)> start, duration cost) {
+    _jobs.push_back(job{{}, std::move(start), {}, 0, cost});
+    return _jobs.size() - 1;
+}
+
+void job_graph::add_dependency(job_id dependent, job_id dependency) {
+    neo_assert(expects,
+               dependent < _jobs.size() && dependency < _jobs.size(),
+               "Invalid job ID given to add_dependency()",
+               dependent,
+               dependency,
+               _jobs.size());
+    neo_assert(expects, dependent != dependency, "A job cannot depend upon itself", dependent);
+    _jobs[dependency].dependents.push_back(dependent);
+    ++_jobs[dependent].n_dependencies;
+}
+
+std::vector<job_graph::duration> job_graph::_calc_priorities() const {
+    // Visit the jobs in reverse topological order, so that every dependent of a job has its
+    // priority calculated before the job itself.
+    std::vector<std::size_t> n_unvisited_dependents;
+    std::vector<job_id>      stack;
+    for (job_id id = 0; id < _jobs.size(); ++id) {
+        n_unvisited_dependents.push_back(_jobs[id].dependents.size());
+        if (_jobs[id].dependents.empty()) {
+            stack.push_back(id);
+        }
+    }
+
+    std::vector<std::vector<job_id>> dependencies(_jobs.size());
+    for (job_id id = 0; id < _jobs.size(); ++id) {
+        for (auto dependent : _jobs[id].dependents) {
+            dependencies[dependent].push_back(id);
+        }
+    }
+
+    std::vector<duration> priorities(_jobs.size());
+    while (!stack.empty()) {
+        auto id = stack.back();
+        stack.pop_back();
+        duration longest_tail{};
+        for (auto dependent : _jobs[id].dependents) {
+            longest_tail = std::max(longest_tail, priorities[dependent]);
+        }
+        priorities[id] = _jobs[id].cost + longest_tail;
+        for (auto dependency : dependencies[id]) {
+            if (--n_unvisited_dependents[dependency] == 0) {
+                stack.push_back(dependency);
+            }
+        }
+    }
+    return priorities;
+}
+
+job_graph::estimate job_graph::estimate_duration(int n_jobs) const {
+    n_jobs = calc_n_jobs(n_jobs);
+
+    auto priorities = _calc_priorities();
+
+    estimate ret;
+    for (auto prio : priorities) {
+        ret.critical_path = std::max(ret.critical_path, prio);
+    }
+
+    // Simulate the execution of the graph, making the same scheduling decisions that run() would
+    // make if every job took exactly as long as its estimated cost.
+    std::vector<std::size_t> n_pending;
+    ready_queue              ready{priority_order{&priorities}};
+    for (job_id id = 0; id < _jobs.size(); ++id) {
+        n_pending.push_back(_jobs[id].n_dependencies);
+        if (n_pending.back() == 0) {
+            ready.push(id);
+        }
+    }
+
+    using running_job = std::pair<duration, job_id>;
+    std::priority_queue<running_job, std::vector<running_job>, std::greater<>> running;
+
+    duration now{};
+    while (!ready.empty() || !running.empty()) {
+        while (!ready.empty() && running.size() < static_cast<std::size_t>(n_jobs)) {
+            auto id = ready.top();
+            ready.pop();
+            running.emplace(now + _jobs[id].cost, id);
+        }
+        auto [end_time, id] = running.top();
+        running.pop();
+        now = end_time;
+        for (auto dependent : _jobs[id].dependents) {
+            if (--n_pending[dependent] == 0) {
+                ready.push(dependent);
+            }
+        }
+    }
+    ret.makespan = now;
+    return ret;
+}
+
+bool job_graph::run(int n_jobs) const {
+    n_jobs = calc_n_jobs(n_jobs);
+
+    std::mutex              mut;
+    std::condition_variable cv;
+
+    auto priorities = _calc_priorities();
+
+    // The number of unfinished dependencies of each job. A job is ready when this reaches zero.
+    std::vector<std::size_t> n_pending;
+    ready_queue              ready{priority_order{&priorities}};
+    for (job_id id = 0; id < _jobs.size(); ++id) {
+        n_pending.push_back(_jobs[id].n_dependencies);
+        if (n_pending.back() == 0) {
+            ready.push(id);
+        }
+    }
+
+    // The number of jobs that have started but not finished. This includes asynchronous jobs that
+    // are waiting for their work to complete, and which do not occupy a thread.
+    std::size_t                     n_active   = 0;
+    std::size_t                     n_finished = 0;
+    std::vector<std::exception_ptr> exceptions;
+    // Asynchronous jobs whose work has completed, and the functions that will finish them
+    std::deque<std::pair<job_id, std::function<void()>>> finishers;
+
+    // Mark a job as finished. Must be called with the lock held.
+    auto job_done = [&](job_id id, std::exception_ptr eptr) {
+        --n_active;
+        if (eptr) {
+            exceptions.push_back(eptr);
+        } else {
+            ++n_finished;
+            for (auto dependent : _jobs[id].dependents) {
+                if (--n_pending[dependent] == 0) {
+                    ready.push(dependent);
+                }
+            }
+        }
+        cv.notify_all();
+    };
+
+    auto stopping = [&] { return !exceptions.empty() || is_cancelled(); };
+
+    auto run_jobs = [&] {
+        std::unique_lock lk{mut};
+        while (true) {
+            cv.wait(lk, [&] {
+                return !finishers.empty() || n_active == 0
+                    || (!ready.empty() && n_active < static_cast<std::size_t>(n_jobs)
+                        && !stopping());
+            });
+
+            if (!finishers.empty()) {
+                // Finishing jobs that are already underway takes precedence over starting new ones
+                auto [id, finish] = std::move(finishers.front());
+                finishers.pop_front();
+                lk.unlock();
+
+                std::exception_ptr eptr;
+                try {
+                    finish();
+                } catch (...) {
+                    eptr = std::current_exception();
+                }
+
+                lk.lock();
+                job_done(id, eptr);
+                continue;
+            }
+
+            if (n_active == 0 && (ready.empty() || stopping())) {
+                // Either something failed, the user cancelled, or there is nothing underway that
+                // could make more work become ready. Either way: We're done.
+                break;
+            }
+
+            if (ready.empty() || n_active >= static_cast<std::size_t>(n_jobs) || stopping()) {
+                // Wait for jobs that are underway
+                continue;
+            }
+
+            auto id = ready.top();
+            ready.pop();
+            ++n_active;
+            lk.unlock();
+
+            std::exception_ptr eptr;
+            auto&              job = _jobs[id];
+            try {
+                if (job.fn) {
+                    job.fn();
+                } else {
+                    job.start_async([&, id](std::function<void()> finish) {
+                        std::scoped_lock lk{mut};
+                        finishers.emplace_back(id, std::move(finish));
+                        cv.notify_all();
+                    });
+                }
+            } catch (...) {
+                eptr = std::current_exception();
+            }
+
+            lk.lock();
+            if (job.fn || eptr) {
+                job_done(id, eptr);
+            }
+        }
+    };
+
+    // Predict how long we will take, so that the quality of the job cost estimates can be checked
+    // against the real execution time.
+    auto           predicted = estimate_duration(n_jobs);
+    dds::stopwatch timer;
+
+    // Asynchronous jobs do not occupy a thread while their work is underway, so we only need
+    // enough threads to prepare and finish them.
+    auto n_workers = static_cast<std::size_t>(n_jobs);
+    if (_n_sync_jobs == 0) {
+        auto n_cpus = std::max(std::thread::hardware_concurrency(), 1u);
+        n_workers   = std::min(n_workers, std::size_t(n_cpus));
+    }
+    n_workers = std::min(n_workers, _jobs.size());
+    thread_pool::global().fan_out(n_workers, run_jobs);
+
+    if (predicted.critical_path.count() != 0) {
+        dds_log(debug,
+                "Executed {} jobs in {:L}ms (predicted {:L}ms, critical path {:L}ms)",
+                n_finished,
+                timer.elapsed_ms().count(),
+                predicted.makespan.count(),
+                predicted.critical_path.count());
+    }
+
+    for (auto eptr : exceptions) {
+        log_exception(eptr);
+    }
+    neo_assert(invariant,
+               !exceptions.empty() || is_cancelled() || n_finished == _jobs.size(),
+               "Not every job in the job graph was executed. Is there a dependency cycle?",
+               n_finished,
+               _jobs.size());
+    return exceptions.empty();
+}
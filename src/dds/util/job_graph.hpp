@@ -0,0 +1,116 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace dds {
+
+/**
+ * A directed acyclic graph of jobs to be executed in parallel. Each job may depend on any number of
+ * other jobs in the graph, and a job will only begin executing once all of its dependencies have
+ * completed successfully.
+ *
+ * This allows unrelated work to proceed without waiting on a global barrier. For example, a static
+ * library can be archived as soon as its own object files are compiled, even while the object files
+ * of other libraries are still being compiled.
+ *
+ * Each job may be given an estimated cost. When more jobs are ready than can be executed at once,
+ * the jobs with the longest remaining path through the graph (the sum of the estimated costs of the
+ * job and of the most expensive chain of jobs that depend upon it) are started first.
+ */
+class job_graph {
+public:
+    /// An opaque identifier of a job within a graph
+    using job_id = std::size_t;
+    /// The unit of estimated job costs
+    using duration = std::chrono::milliseconds;
+    /**
+     * Given to an asynchronous job when it is started. The job must invoke this exactly once, from
+     * any thread, when its asynchronous work has completed. The given function will then be
+     * executed on one of the graph's threads to finish the job. If that function throws, the job
+     * has failed.
+     */
+    using async_done = std::function<void(std::function<void()> finish)>;
+
+    /**
+     * The predicted execution time of a graph.
+     */
+    struct estimate {
+        /// The longest chain of dependent jobs. No amount of parallelism can finish sooner.
+        duration critical_path{};
+        /// The time to execute the graph with a given number of jobs, if all estimates are exact.
+        duration makespan{};
+    };
+
+private:
+    struct job {
+        /// The work to perform, for a synchronous job
+        std::function<void()> fn;
+        /// Starts the work, for an asynchronous job
+        std::function<void(async_done)> start_async;
+        /// The jobs that depend on this job
+        std::vector<job_id> dependents;
+        /// The number of jobs that this job depends upon
+        std::size_t n_dependencies = 0;
+        /// The estimated cost of executing this job
+        duration cost{};
+    };
+
+    std::vector<job> _jobs;
+    std::size_t      _n_sync_jobs = 0;
+
+    std::vector<duration> _calc_priorities() const;
+
+public:
+    /**
+     * Add a new job to the graph. The job will have no dependencies until they are added with
+     * `add_dependency()`.
+     * @param fn The work to perform
+     * @param cost The estimated time that the job will take to execute
+     */
+    job_id add_job(std::function<void()> fn, duration cost = {});
+
+    /**
+     * Add a new asynchronous job to the graph. When the job is ready, `start` is invoked to begin
+     * its work, and it should return as soon as that work is underway, such as when a subprocess
+     * has been spawned. Until the job invokes the `async_done` that it is given, it holds one of
+     * the `n_jobs` slots given to `run()`, but does not occupy a thread. If `start` throws, the job
+     * has failed and `async_done` must not be called.
+     * @param start Begins the work of the job
+     * @param cost The estimated time that the job will take to execute
+     */
+    job_id add_async_job(std::function<void(async_done)> start, duration cost = {});
+
+    /**
+     * Declare that `dependent` must not start until `dependency` has completed.
+     */
+    void add_dependency(job_id dependent, job_id dependency);
+
+    /**
+     * The number of jobs in the graph
+     */
+    std::size_t size() const noexcept { return _jobs.size(); }
+
+    /**
+     * Predict the time it will take to `run()` the graph with `n_jobs` parallel jobs, based on the
+     * estimated cost of each job.
+     */
+    estimate estimate_duration(int n_jobs) const;
+
+    /**
+     * Execute every job in the graph on the global `thread_pool`, running up to `n_jobs` jobs in
+     * parallel. If `n_jobs` is less than one, a default based on the hardware concurrency will be
+     * used.
+     *
+     * If any job throws an exception, then no further jobs will be started, and the exceptions will
+     * be logged once all running jobs have finished. If the user cancels, no further jobs will be
+     * started, and it is up to the caller to check for cancellation.
+     *
+     * @returns `true` if every job completed successfully, `false` otherwise.
+     */
+    bool run(int n_jobs) const;
+};
+
+}  // namespace dds
@@ -0,0 +1,166 @@
+#include <dds/util/job_graph.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Jobs execute after their dependencies") {
+    dds::job_graph   graph;
+    std::mutex       mut;
+    std::vector<int> order;
+    auto             push = [&](int n) {
+        return [&, n] {
+            std::scoped_lock lk{mut};
+            order.push_back(n);
+        };
+    };
+
+    auto first  = graph.add_job(push(1));
+    auto second = graph.add_job(push(2));
+    auto third  = graph.add_job(push(3));
+    graph.add_dependency(third, second);
+    graph.add_dependency(second, first);
+
+    CHECK(graph.run(4));
+    CHECK(order == std::vector<int>({1, 2, 3}));
+}
+
+TEST_CASE("Diamond dependencies execute each job once") {
+    dds::job_graph   graph;
+    std::atomic_int  n_executed = 0;
+    std::atomic_bool saw_bad_order{false};
+    std::atomic_int  n_done_mid = 0;
+
+    auto top = graph.add_job([&] { ++n_executed; });
+    auto mid = [&] {
+        ++n_executed;
+        ++n_done_mid;
+    };
+    auto left   = graph.add_job(mid);
+    auto right  = graph.add_job(mid);
+    auto bottom = graph.add_job([&] {
+        ++n_executed;
+        if (n_done_mid != 2) {
+            saw_bad_order = true;
+        }
+    });
+    graph.add_dependency(left, top);
+    graph.add_dependency(right, top);
+    graph.add_dependency(bottom, left);
+    graph.add_dependency(bottom, right);
+
+    CHECK(graph.run(8));
+    CHECK(n_executed == 4);
+    CHECK_FALSE(saw_bad_order);
+}
+
+TEST_CASE("A failing job prevents its dependents from running") {
+    dds::job_graph   graph;
+    std::atomic_bool dependent_ran{false};
+
+    auto failing   = graph.add_job([] { throw std::runtime_error("Job failed (intentionally)"); });
+    auto dependent = graph.add_job([&] { dependent_ran = true; });
+    graph.add_dependency(dependent, failing);
+
+    CHECK_FALSE(graph.run(2));
+    CHECK_FALSE(dependent_ran);
+}
+
+TEST_CASE("An empty job graph succeeds") {
+    dds::job_graph graph;
+    CHECK(graph.run(0));
+}
+
+TEST_CASE("Jobs on the critical path are started first") {
+    using std::chrono::milliseconds;
+    dds::job_graph   graph;
+    std::vector<int> order;
+    auto             push = [&](int n) { return [&, n] { order.push_back(n); }; };
+
+    // A cheap job with no dependents, and an equally cheap job that gates an expensive one
+    auto lone  = graph.add_job(push(1), milliseconds(10));
+    auto gate  = graph.add_job(push(2), milliseconds(10));
+    auto heavy = graph.add_job(push(3), milliseconds(1000));
+    graph.add_dependency(heavy, gate);
+    (void)lone;
+
+    CHECK(graph.run(1));
+    CHECK(order == std::vector<int>({2, 3, 1}));
+}
+
+TEST_CASE("Estimate the duration of a job graph") {
+    using std::chrono::milliseconds;
+    dds::job_graph graph;
+    auto           nop = [] {};
+
+    auto a = graph.add_job(nop, milliseconds(100));
+    auto b = graph.add_job(nop, milliseconds(300));
+    auto c = graph.add_job(nop, milliseconds(200));
+    auto d = graph.add_job(nop, milliseconds(50));
+    graph.add_dependency(d, a);
+    graph.add_dependency(d, b);
+    (void)c;
+
+    auto serial = graph.estimate_duration(1);
+    CHECK(serial.critical_path == milliseconds(350));
+    CHECK(serial.makespan == milliseconds(650));
+
+    auto wide = graph.estimate_duration(3);
+    CHECK(wide.critical_path == milliseconds(350));
+    CHECK(wide.makespan == milliseconds(350));
+
+    // With two workers, 'b' and 'c' start first (300ms and 200ms remaining), then 'a' follows 'c'
+    // and 'd' can start once 'a' completes at 300ms.
+    auto two = graph.estimate_duration(2);
+    CHECK(two.makespan == milliseconds(350));
+}
+
+TEST_CASE("Asynchronous jobs hold a job slot until they are finished") {
+    dds::job_graph           graph;
+    std::mutex               mut;
+    std::vector<std::thread> threads;
+    std::atomic_int          n_in_flight   = 0;
+    std::atomic_int          max_in_flight = 0;
+    std::atomic_int          n_finished    = 0;
+
+    for (int i = 0; i < 6; ++i) {
+        graph.add_async_job([&](dds::job_graph::async_done done) {
+            auto n = ++n_in_flight;
+            for (auto prev = max_in_flight.load(); prev < n;) {
+                max_in_flight.compare_exchange_weak(prev, n);
+            }
+            // Complete the work on another thread, as if waiting on a subprocess
+            std::scoped_lock lk{mut};
+            threads.emplace_back([&, done] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                --n_in_flight;
+                done([&] { ++n_finished; });
+            });
+        });
+    }
+
+    CHECK(graph.run(2));
+    for (auto& t : threads) {
+        t.join();
+    }
+    CHECK(n_finished == 6);
+    CHECK(max_in_flight <= 2);
+}
+
+TEST_CASE("A failing asynchronous job prevents its dependents from running") {
+    dds::job_graph   graph;
+    std::atomic_bool dependent_ran{false};
+
+    auto failing = graph.add_async_job([](dds::job_graph::async_done done) {
+        done([] { throw std::runtime_error("Job failed (intentionally)"); });
+    });
+    auto dependent = graph.add_job([&] { dependent_ran = true; });
+    graph.add_dependency(dependent, failing);
+
+    CHECK_FALSE(graph.run(2));
+    CHECK_FALSE(dependent_ran);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <dds/util/fs.hpp>
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace dds {
+
+/**
+ * A connection over a local socket, which is named by a path in the filesystem. Data is exchanged
+ * as lines of text.
+ *
+ * Local sockets are only implemented on Unix-like platforms. On other platforms, nothing can be
+ * connected to.
+ */
+class local_connection {
+    int         _fd = -1;
+    std::string _buffer;
+
+public:
+    explicit local_connection(int fd) noexcept
+        : _fd(fd) {}
+    local_connection(local_connection&& other) noexcept
+        : _fd(std::exchange(other._fd, -1))
+        , _buffer(std::move(other._buffer)) {}
+    local_connection& operator=(local_connection&&) = delete;
+    ~local_connection();
+
+    /**
+     * Connect to the socket at the given path. Returns `nullopt` if nothing is listening there.
+     */
+    static std::optional<local_connection> connect(path_ref socket_path) noexcept;
+
+    /**
+     * Send the given line, to which a newline is appended. Returns `false` if the other end of the
+     * connection has gone away.
+     */
+    bool write_line(std::string_view line) noexcept;
+
+    /**
+     * Receive the next line, without its newline. Returns `nullopt` once the other end of the
+     * connection has closed it.
+     */
+    std::optional<std::string> read_line();
+};
+
+/**
+ * A listening local socket, which is removed from the filesystem when the listener is destroyed
+ */
+class local_listener {
+    int      _fd = -1;
+    fs::path _path;
+
+    local_listener(int fd, fs::path path) noexcept
+        : _fd(fd)
+        , _path(std::move(path)) {}
+
+public:
+    local_listener(local_listener&& other) noexcept
+        : _fd(std::exchange(other._fd, -1))
+        , _path(std::move(other._path)) {}
+    local_listener& operator=(local_listener&&) = delete;
+    ~local_listener();
+
+    /**
+     * Listen on a socket at the given path. A stale socket file that nothing is listening on is
+     * replaced.
+     * @throws std::system_error if the socket cannot be created, including when another process
+     * is already listening on it
+     */
+    static local_listener listen(path_ref socket_path);
+
+    /**
+     * Wait up to `timeout` for a connection. Returns `nullopt` if no connection was made in that
+     * time, or if the wait was interrupted by a signal.
+     */
+    std::optional<local_connection> accept(std::chrono::milliseconds timeout);
+};
+
+}  // namespace dds
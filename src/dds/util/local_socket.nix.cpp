@@ -0,0 +1,173 @@
+#ifndef _WIN32
+
+#include "./local_socket.hpp"
+
+#include <fmt/core.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+using namespace dds;
+
+namespace {
+
+[[noreturn]] void throw_errno(std::string_view what, path_ref p) {
+    throw std::system_error(std::error_code(errno, std::system_category()),
+                            fmt::format("{} [{}]", what, p.string()));
+}
+
+/**
+ * Fill a socket address for the given path. Returns `false` if the path is too long.
+ */
+bool make_address(path_ref socket_path, ::sockaddr_un& addr) noexcept {
+    auto str = socket_path.string();
+    addr     = {};
+    if (str.size() >= sizeof addr.sun_path) {
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, str.data(), str.size());
+    return true;
+}
+
+/// Don't raise SIGPIPE when sending to a connection whose other end has gone away
+#ifdef MSG_NOSIGNAL
+constexpr int send_flags = MSG_NOSIGNAL;
+#else
+constexpr int send_flags = 0;
+#endif
+
+/// Keep the descriptor from being inherited by subprocesses, such as compilers
+int close_on_exec(int fd) noexcept {
+    if (fd != -1) {
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return fd;
+}
+
+int new_socket() noexcept { return close_on_exec(::socket(AF_UNIX, SOCK_STREAM, 0)); }
+
+}  // namespace
+
+local_connection::~local_connection() {
+    if (_fd != -1) {
+        ::close(_fd);
+    }
+}
+
+std::optional<local_connection> local_connection::connect(path_ref socket_path) noexcept {
+    ::sockaddr_un addr;
+    if (!make_address(socket_path, addr)) {
+        return std::nullopt;
+    }
+    local_connection ret{new_socket()};
+    if (ret._fd == -1
+        || ::connect(ret._fd, reinterpret_cast<::sockaddr*>(&addr), sizeof addr) != 0) {
+        return std::nullopt;
+    }
+    return ret;
+}
+
+bool local_connection::write_line(std::string_view line) noexcept {
+    std::string data{line};
+    data.push_back('\n');
+    std::string_view remaining = data;
+    while (!remaining.empty()) {
+        auto n_sent = ::send(_fd, remaining.data(), remaining.size(), send_flags);
+        if (n_sent == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        remaining.remove_prefix(static_cast<std::size_t>(n_sent));
+    }
+    return true;
+}
+
+std::optional<std::string> local_connection::read_line() {
+    while (true) {
+        auto nl = _buffer.find('\n');
+        if (nl != _buffer.npos) {
+            auto line = _buffer.substr(0, nl);
+            _buffer.erase(0, nl + 1);
+            return line;
+        }
+        char buf[4096];
+        auto n_read = ::recv(_fd, buf, sizeof buf, 0);
+        if (n_read == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n_read <= 0) {
+            return std::nullopt;
+        }
+        _buffer.append(buf, static_cast<std::size_t>(n_read));
+    }
+}
+
+local_listener::~local_listener() {
+    if (_fd != -1) {
+        ::close(_fd);
+        std::error_code ec;
+        fs::remove(_path, ec);
+    }
+}
+
+local_listener local_listener::listen(path_ref socket_path) {
+    ::sockaddr_un addr;
+    if (!make_address(socket_path, addr)) {
+        errno = ENAMETOOLONG;
+        throw_errno("Socket path is too long", socket_path);
+    }
+    if (fs::exists(socket_path)) {
+        if (local_connection::connect(socket_path)) {
+            errno = EADDRINUSE;
+            throw_errno("Another process is already listening on socket", socket_path);
+        }
+        // Left behind by a process that did not exit cleanly
+        fs::remove(socket_path);
+    }
+    fs::create_directories(socket_path.parent_path());
+
+    local_listener ret{new_socket(), socket_path};
+    if (ret._fd == -1) {
+        throw_errno("Failed to create socket", socket_path);
+    }
+    if (::bind(ret._fd, reinterpret_cast<::sockaddr*>(&addr), sizeof addr) != 0) {
+        // Don't remove a socket file that belongs to someone else
+        ::close(std::exchange(ret._fd, -1));
+        throw_errno("Failed to bind socket", socket_path);
+    }
+    if (::listen(ret._fd, 8) != 0) {
+        throw_errno("Failed to listen on socket", socket_path);
+    }
+    return ret;
+}
+
+std::optional<local_connection> local_listener::accept(std::chrono::milliseconds timeout) {
+    ::pollfd pfd{.fd = _fd, .events = POLLIN, .revents = 0};
+    auto     rc = ::poll(&pfd, 1, static_cast<int>(timeout.count()));
+    if (rc == -1 && errno != EINTR) {
+        throw_errno("Failed to wait for a connection on socket", _path);
+    }
+    if (rc <= 0) {
+        return std::nullopt;
+    }
+    auto fd = close_on_exec(::accept(_fd, nullptr, nullptr));
+    if (fd == -1) {
+        if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN) {
+            return std::nullopt;
+        }
+        throw_errno("Failed to accept a connection on socket", _path);
+    }
+    return local_connection{fd};
+}
+
+#endif
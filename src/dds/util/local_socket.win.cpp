@@ -0,0 +1,30 @@
+#ifdef _WIN32
+
+#include "./local_socket.hpp"
+
+#include <system_error>
+
+using namespace dds;
+
+local_connection::~local_connection() = default;
+
+std::optional<local_connection> local_connection::connect(path_ref) noexcept {
+    return std::nullopt;
+}
+
+bool local_connection::write_line(std::string_view) noexcept { return false; }
+
+std::optional<std::string> local_connection::read_line() { return std::nullopt; }
+
+local_listener::~local_listener() = default;
+
+local_listener local_listener::listen(path_ref) {
+    throw std::system_error(std::make_error_code(std::errc::function_not_supported),
+                            "Local sockets are not supported on this platform");
+}
+
+std::optional<local_connection> local_listener::accept(std::chrono::milliseconds) {
+    return std::nullopt;
+}
+
+#endif
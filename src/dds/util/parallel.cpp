@@ -4,8 +4,27 @@
 
 #include <dds/util/log.hpp>
 
+#include <neo/assert.hpp>
+#include <neo/event.hpp>
+
+#include <deque>
+
 using namespace dds;
 
+namespace {
+
+/// The pool and index of the worker running on the current thread, if any.
+thread_local thread_pool* tl_current_pool = nullptr;
+thread_local std::size_t  tl_worker_index = 0;
+
+}  // namespace
+
+struct thread_pool::worker {
+    std::mutex                        mut;
+    std::deque<std::function<void()>> tasks;
+    std::thread                       thread;
+};
+
 void dds::log_exception(std::exception_ptr eptr) noexcept {
     try {
         std::rethrow_exception(eptr);
@@ -15,3 +34,158 @@ void dds::log_exception(std::exception_ptr eptr) noexcept {
         dds_log(error, "{}", e.what());
     }
 }
+
+int dds::calc_n_jobs(int n_jobs) noexcept {
+    if (n_jobs < 1) {
+        n_jobs = static_cast<int>(std::thread::hardware_concurrency()) + 2;
+    }
+    return n_jobs;
+}
+
+thread_pool::thread_pool(std::size_t max_threads)
+    : _workers(new worker[max_threads])
+    , _max_threads(max_threads) {
+    neo_assert(expects, max_threads > 0, "A thread pool must allow at least one thread");
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::scoped_lock lk{_idle_mut};
+        _stop = true;
+    }
+    _idle_cv.notify_all();
+    for (auto idx = 0u; idx < size(); ++idx) {
+        _workers[idx].thread.join();
+    }
+}
+
+thread_pool& thread_pool::global() noexcept {
+    // Builds will often run many more jobs than there are CPUs, since most jobs are spent waiting
+    // on a subprocess. Allow plenty of room.
+    static thread_pool inst{1024};
+    return inst;
+}
+
+void thread_pool::ensure_threads(std::size_t n) {
+    n = std::min(n, _max_threads);
+    if (size() >= n) {
+        return;
+    }
+    std::scoped_lock lk{_start_mut};
+    for (auto idx = size(); idx < n; ++idx) {
+        _workers[idx].thread = std::thread([this, idx] { _worker_main(idx); });
+        // Publish the new worker so that other workers may steal from it
+        _n_threads.store(idx + 1, std::memory_order_release);
+    }
+}
+
+void thread_pool::submit(std::function<void()> task) {
+    if (size() == 0) {
+        ensure_threads(1);
+    }
+    std::size_t idx;
+    if (tl_current_pool == this) {
+        idx = tl_worker_index;
+    } else {
+        idx = _next_victim.fetch_add(1, std::memory_order_relaxed) % size();
+    }
+    {
+        std::scoped_lock lk{_workers[idx].mut};
+        _workers[idx].tasks.push_back(std::move(task));
+    }
+    {
+        // Lock to ensure that a worker that is about to sleep does not miss this task
+        std::scoped_lock lk{_idle_mut};
+        ++_n_queued;
+    }
+    _idle_cv.notify_one();
+}
+
+bool thread_pool::_try_run_one(std::size_t idx) noexcept {
+    std::function<void()> task;
+    {
+        // Take the newest task from our own queue
+        auto&            self = _workers[idx];
+        std::scoped_lock lk{self.mut};
+        if (!self.tasks.empty()) {
+            task = std::move(self.tasks.back());
+            self.tasks.pop_back();
+        }
+    }
+    const auto n_threads = size();
+    for (std::size_t off = 1; !task && off < n_threads; ++off) {
+        // Steal the oldest task from another worker
+        auto&            victim = _workers[(idx + off) % n_threads];
+        std::scoped_lock lk{victim.mut};
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    --_n_queued;
+    task();
+    return true;
+}
+
+void thread_pool::_worker_main(std::size_t idx) noexcept {
+    auto log_subscr = neo::subscribe(&log::ev_log::print);
+    tl_current_pool = this;
+    tl_worker_index = idx;
+
+    while (true) {
+        if (_try_run_one(idx)) {
+            continue;
+        }
+        std::unique_lock lk{_idle_mut};
+        _idle_cv.wait(lk, [&] { return _stop || _n_queued.load() != 0; });
+        if (_stop) {
+            break;
+        }
+    }
+}
+
+void thread_pool::fan_out(std::size_t n_workers, const std::function<void()>& fn) {
+    if (n_workers == 0) {
+        return;
+    }
+
+    // Pool invocations may begin after we return, so they share their state by ownership.
+    struct shared_state {
+        std::mutex                   mut;
+        std::condition_variable      cv;
+        bool                         sealed    = false;
+        std::size_t                  n_running = 0;
+        const std::function<void()>* fn;
+    };
+    auto state = std::make_shared<shared_state>();
+    state->fn  = &fn;
+
+    ensure_threads(n_workers - 1);
+    for (auto n = 1u; n < n_workers; ++n) {
+        submit([state] {
+            {
+                std::scoped_lock lk{state->mut};
+                if (state->sealed) {
+                    // The caller has moved on. `fn` may no longer be valid.
+                    return;
+                }
+                ++state->n_running;
+            }
+            (*state->fn)();
+            {
+                std::scoped_lock lk{state->mut};
+                --state->n_running;
+            }
+            state->cv.notify_all();
+        });
+    }
+
+    fn();
+
+    std::unique_lock lk{state->mut};
+    state->sealed = true;
+    state->cv.wait(lk, [&] { return state->n_running == 0; });
+}
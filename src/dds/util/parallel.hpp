@@ -1,69 +1,194 @@
 #pragma once
 
 #include <dds/util/log.hpp>
-
-#include <neo/event.hpp>
+#include <dds/util/signal.hpp>
 
 #include <algorithm>
-#include <iterator>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <stdexcept>
-#include <thread>
+#include <type_traits>
 #include <vector>
 
 namespace dds {
 
 void log_exception(std::exception_ptr) noexcept;
 
-template <typename Range, typename Func>
-bool parallel_run(Range&& rng, int n_jobs, Func&& fn) {
-    // We don't bother with a nice thread pool, as the overhead of most build
-    // tasks dwarf the cost of interlocking.
-    std::mutex mut;
+/**
+ * A persistent pool of worker threads. Each worker owns a double-ended queue of tasks: A worker
+ * takes the most recently pushed task from its own queue, and an idle worker will steal the oldest
+ * task from the queue of another worker. Tasks that are submitted from a worker thread are pushed
+ * onto that worker's own queue, and tasks from other threads are spread among the workers.
+ *
+ * Worker threads are started on-demand by `ensure_threads()`, and are stopped and joined when the
+ * pool is destroyed. Each worker thread is subscribed to print log messages.
+ */
+class thread_pool {
+    struct worker;
 
-    auto       iter = rng.begin();
-    const auto stop = rng.end();
+    // The workers. This array is never reallocated, so that workers may access each other's queues
+    // without interlocking with the creation of new workers.
+    std::unique_ptr<worker[]> _workers;
+    const std::size_t         _max_threads;
+    std::atomic_size_t        _n_threads{0};
+    std::mutex                _start_mut;
 
-    std::vector<std::exception_ptr> exceptions;
+    // Idle workers wait on this. `_n_queued` is the number of tasks in all queues.
+    std::mutex              _idle_mut;
+    std::condition_variable _idle_cv;
+    std::atomic_size_t      _n_queued{0};
+    std::atomic_size_t      _next_victim{0};
+    bool                    _stop = false;
 
-    auto run_one = [&]() mutable {
-        auto log_subscr = neo::subscribe(&log::ev_log::print);
+    void _worker_main(std::size_t idx) noexcept;
+    bool _try_run_one(std::size_t idx) noexcept;
 
-        while (true) {
-            std::unique_lock lk{mut};
-            if (!exceptions.empty()) {
-                break;
-            }
-            if (iter == stop) {
+public:
+    /**
+     * Create a pool that may hold up to `max_threads` worker threads. No threads are started until
+     * requested with `ensure_threads()`.
+     */
+    explicit thread_pool(std::size_t max_threads);
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    /**
+     * Get the pool that is shared by the whole process
+     */
+    static thread_pool& global() noexcept;
+
+    /**
+     * The number of worker threads that are currently running
+     */
+    std::size_t size() const noexcept { return _n_threads.load(std::memory_order_acquire); }
+
+    /**
+     * Start worker threads until at least `n` are running, or the pool's maximum is reached.
+     */
+    void ensure_threads(std::size_t n);
+
+    /**
+     * Enqueue a task to be run by a worker. The task must not throw. If no worker threads have
+     * been started, one will be started.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * Invoke `fn` concurrently on up to `n_workers` threads: The calling thread, and up to
+     * `n_workers - 1` tasks on the pool. Returns after the calling thread's invocation has returned
+     * and every pool invocation that began has returned. Pool invocations that have not begun by
+     * then are skipped. Because the caller always participates, this will make progress even if
+     * called from within a pool task while all other workers are busy.
+     *
+     * `fn` is expected to pull work from some shared source until it is exhausted, and must not
+     * throw.
+     */
+    void fan_out(std::size_t n_workers, const std::function<void()>& fn);
+};
+
+/**
+ * Calculate the number of parallel jobs to use, given a user-requested number. If `n_jobs` is less
+ * than one, a default based on the hardware concurrency will be used.
+ */
+int calc_n_jobs(int n_jobs) noexcept;
+
+namespace detail {
+
+/**
+ * Implements `parallel_run()` and `parallel_run_or_throw()`. Returns the exceptions that were
+ * thrown by invocations of `fn`, in the order in which they were thrown.
+ */
+template <typename Range, typename Func>
+std::vector<std::exception_ptr> parallel_run_collect(Range&& rng, int n_jobs, Func&& fn) {
+    using reference = decltype(*rng.begin());
+    // Keep the addresses of referred-to elements, rather than copies of them
+    constexpr bool by_address = std::is_lvalue_reference_v<reference>;
+    using item_type           = std::conditional_t<by_address,
+                                         std::remove_reference_t<reference>*,
+                                         std::remove_cvref_t<reference>>;
+    std::vector<item_type> items;
+    for (auto&& item : rng) {
+        if constexpr (by_address) {
+            items.push_back(std::addressof(item));
+        } else {
+            items.push_back(static_cast<decltype(item)&&>(item));
+        }
+    }
+
+    std::atomic_size_t              next_idx{0};
+    std::atomic_bool                failed{false};
+    std::mutex                      exc_mut;
+    std::vector<std::exception_ptr> exceptions;
+
+    auto run_some = [&] {
+        while (!failed.load(std::memory_order_relaxed) && !is_cancelled()) {
+            auto idx = next_idx.fetch_add(1, std::memory_order_relaxed);
+            if (idx >= items.size()) {
                 break;
             }
-            auto&& item = *iter;
-            ++iter;
-            lk.unlock();
             try {
-                fn(item);
+                if constexpr (by_address) {
+                    fn(*items[idx]);
+                } else {
+                    fn(items[idx]);
+                }
             } catch (...) {
-                lk.lock();
+                std::scoped_lock lk{exc_mut};
                 exceptions.push_back(std::current_exception());
-                break;
+                failed = true;
             }
         }
     };
 
-    std::unique_lock         lk{mut};
-    std::vector<std::thread> threads;
-    if (n_jobs < 1) {
-        n_jobs = std::thread::hardware_concurrency() + 2;
-    }
-    std::generate_n(std::back_inserter(threads), n_jobs, [&] { return std::thread(run_one); });
-    lk.unlock();
-    for (auto& t : threads) {
-        t.join();
+    auto n_workers = std::min(static_cast<std::size_t>(calc_n_jobs(n_jobs)), items.size());
+    thread_pool::global().fan_out(n_workers, run_some);
+
+    if (exceptions.empty() && next_idx.load() < items.size()) {
+        // We stopped early without failing, so we must have been cancelled.
+        cancellation_point();
     }
+    return exceptions;
+}
+
+}  // namespace detail
+
+/**
+ * Invoke `fn` on every element of `rng`, with up to `n_jobs` invocations running in parallel on the
+ * global thread pool. The range is fully evaluated on the calling thread before any work begins.
+ * If the range yields references, `fn` is given the referred-to objects themselves. Otherwise, the
+ * yielded values are stored, and `fn` is given each stored value.
+ *
+ * If any invocation throws, no further invocations will be started and the exceptions will be
+ * logged. If the user cancels the operation, no further invocations will be started and this will
+ * throw `user_cancelled` once all running invocations have finished.
+ *
+ * @returns `true` if every invocation completed successfully, `false` otherwise.
+ */
+template <typename Range, typename Func>
+bool parallel_run(Range&& rng, int n_jobs, Func&& fn) {
+    auto exceptions = detail::parallel_run_collect(rng, n_jobs, fn);
     for (auto eptr : exceptions) {
         log_exception(eptr);
     }
     return exceptions.empty();
 }
 
-}  // namespace dds
\ No newline at end of file
+/**
+ * Like `parallel_run()`, but if any invocation throws, the first exception that was thrown is
+ * rethrown to the caller once all running invocations have finished, rather than being logged.
+ */
+template <typename Range, typename Func>
+void parallel_run_or_throw(Range&& rng, int n_jobs, Func&& fn) {
+    auto exceptions = detail::parallel_run_collect(rng, n_jobs, fn);
+    if (!exceptions.empty()) {
+        std::rethrow_exception(exceptions.front());
+    }
+}
+
+}  // namespace dds
@@ -0,0 +1,134 @@
+#include <dds/util/parallel.hpp>
+
+#include <dds/util/time.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+TEST_CASE("Run a function on every item in parallel") {
+    std::vector<int> items(1000);
+    std::iota(items.begin(), items.end(), 1);
+    std::atomic_int sum = 0;
+    CHECK(dds::parallel_run(items, 8, [&](int n) { sum += n; }));
+    CHECK(sum == 500500);
+}
+
+TEST_CASE("Run a function on the elements of the range, not on copies") {
+    struct counter {
+        int n = 0;
+        counter()               = default;
+        counter(const counter&) = delete;
+    };
+    std::vector<counter> items(100);
+    CHECK(dds::parallel_run(items, 8, [&](counter& c) { ++c.n; }));
+    CHECK(std::all_of(items.begin(), items.end(), [](auto& c) { return c.n == 1; }));
+}
+
+TEST_CASE("Stop running after the first failure") {
+    std::vector<int> items(1000);
+    std::iota(items.begin(), items.end(), 0);
+    std::atomic_int n_run = 0;
+    CHECK_FALSE(dds::parallel_run(items, 1, [&](int n) {
+        ++n_run;
+        if (n == 10) {
+            throw std::runtime_error("Task failed (intentionally)");
+        }
+    }));
+    CHECK(n_run == 11);
+}
+
+TEST_CASE("Rethrow the first failure to the caller") {
+    std::vector<int> items(1000);
+    std::iota(items.begin(), items.end(), 0);
+    auto fail_late = [](int n) {
+        if (n >= 10) {
+            throw std::runtime_error(std::to_string(n));
+        }
+    };
+    CHECK_THROWS_WITH(dds::parallel_run_or_throw(items, 1, fail_late), "10");
+    CHECK_NOTHROW(dds::parallel_run_or_throw(items, 8, [&](int) {}));
+}
+
+TEST_CASE("Nested parallel runs make progress") {
+    std::vector<int> outer(64);
+    std::vector<int> inner(64, 1);
+    std::atomic_int  sum = 0;
+    CHECK(dds::parallel_run(outer, 0, [&](int) {
+        if (!dds::parallel_run(inner, 0, [&](int n) { sum += n; })) {
+            throw std::runtime_error("Inner parallel_run failed");
+        }
+    }));
+    CHECK(sum == 64 * 64);
+}
+
+TEST_CASE("Submit tasks to a thread pool") {
+    constexpr std::size_t n_tasks = 1000;
+
+    std::vector<std::atomic_int> n_runs(n_tasks);
+    std::mutex                   mut;
+    std::condition_variable      cv;
+    std::size_t                  n_done = 0;
+    {
+        dds::thread_pool pool{4};
+        pool.ensure_threads(4);
+        CHECK(pool.size() == 4);
+        for (std::size_t idx = 0; idx < n_tasks; ++idx) {
+            pool.submit([&, idx] {
+                ++n_runs[idx];
+                std::scoped_lock lk{mut};
+                ++n_done;
+                cv.notify_all();
+            });
+        }
+        // Destroying the pool discards the tasks that are still queued, so wait for all of them
+        std::unique_lock lk{mut};
+        cv.wait(lk, [&] { return n_done == n_tasks; });
+    }
+    CHECK(std::all_of(n_runs.begin(), n_runs.end(), [](auto& n) { return n == 1; }));
+}
+
+TEST_CASE("Fan out work on a thread pool") {
+    constexpr std::size_t n_items = 1000;
+
+    std::vector<std::atomic_int> n_runs(n_items);
+    std::atomic_size_t           next = 0;
+    dds::thread_pool             pool{4};
+    // Every invocation takes items until they are exhausted. The calling thread's invocation does
+    // not return before then, so every item is processed once fan_out() returns.
+    pool.fan_out(4, [&] {
+        for (auto idx = next++; idx < n_items; idx = next++) {
+            ++n_runs[idx];
+        }
+    });
+    CHECK(std::all_of(n_runs.begin(), n_runs.end(), [](auto& n) { return n == 1; }));
+}
+
+TEST_CASE("Dispatch overhead of parallel_run", "[.][bench]") {
+    std::vector<int> items(100'000);
+    std::iota(items.begin(), items.end(), 0);
+    std::atomic<std::int64_t> sum = 0;
+
+    // Warm up the global pool so that thread startup is not measured
+    dds::parallel_run(items, 0, [&](int n) { sum += n; });
+
+    for (int n_jobs : {1, 4, 0}) {
+        sum = 0;
+        dds::stopwatch timer;
+        CHECK(dds::parallel_run(items, n_jobs, [&](int n) { sum += n; }));
+        auto elapsed = timer.elapsed_as<std::chrono::nanoseconds>();
+        CHECK(sum == 4'999'950'000);
+        std::cout << "parallel_run of " << items.size() << " trivial items with -j" << n_jobs
+                  << ": " << elapsed.count() / 1000 << "us ("
+                  << elapsed.count() / static_cast<long>(items.size()) << "ns per item)\n";
+    }
+}
@@ -0,0 +1,37 @@
+#include "./stat_cache.hpp"
+
+#include <functional>
+
+using namespace dds;
+
+std::optional<fs::file_time_type> stat_cache::last_write_time(path_ref file) {
+    auto  key   = file.string();
+    auto& shard = _shards[std::hash<std::string>{}(key) % _shards.size()];
+    {
+        std::scoped_lock lk{shard.mut};
+        auto             found = shard.mtimes.find(key);
+        if (found != shard.mtimes.end()) {
+            return found->second;
+        }
+    }
+
+    // Stat the file without holding the lock. If another thread races us to the same file, we'll
+    // both store the same answer.
+    std::error_code                   ec;
+    std::optional<fs::file_time_type> mtime = fs::last_write_time(file, ec);
+    if (ec) {
+        mtime.reset();
+    }
+
+    std::scoped_lock lk{shard.mut};
+    shard.mtimes.emplace(std::move(key), mtime);
+    return mtime;
+}
+
+void stat_cache::forget(path_ref file) {
+    auto  key   = file.string();
+    auto& shard = _shards[std::hash<std::string>{}(key) % _shards.size()];
+
+    std::scoped_lock lk{shard.mut};
+    shard.mtimes.erase(key);
+}
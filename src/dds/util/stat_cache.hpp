@@ -0,0 +1,55 @@
+#pragma once
+
+#include <dds/util/fs.hpp>
+
+#include <array>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace dds {
+
+/**
+ * A thread-safe cache of file modification times. Each distinct path is only stat'd once, no
+ * matter how many times or from how many threads it is queried. This is useful when checking a
+ * large number of outputs for being up-to-date, since many of them will share the same inputs (e.g.
+ * a popular header file).
+ *
+ * Entries are only invalidated when asked, so the cache should either live for the duration of a
+ * single analysis, or its owner must `forget()` files as they change.
+ */
+class stat_cache {
+    struct shard {
+        std::mutex                                                         mut;
+        std::unordered_map<std::string, std::optional<fs::file_time_type>> mtimes;
+    };
+
+    // Split the cache into shards, so that concurrent lookups rarely contend on the same lock
+    std::array<shard, 16> _shards;
+
+public:
+    /**
+     * Get the modification time of the given file. Returns `nullopt` if the file does not exist
+     * (or cannot be stat'd).
+     */
+    std::optional<fs::file_time_type> last_write_time(path_ref file);
+
+    /**
+     * Discard the cached modification time of the given file, if any
+     */
+    void forget(path_ref file);
+
+    /**
+     * Discard the cached modification time of every file for which `pred` returns `true`
+     */
+    template <typename Pred>
+    void forget_if(Pred&& pred) {
+        for (auto& shard : _shards) {
+            std::scoped_lock lk{shard.mut};
+            std::erase_if(shard.mtimes, [&](auto& pair) { return pred(fs::path(pair.first)); });
+        }
+    }
+};
+
+}  // namespace dds
@@ -55,6 +55,18 @@ def test_simple_lib(tmp_project: Project) -> None:
     assert list(tmp_project.build_root.glob('libtest-library.*')) != [], 'No archive was created'
 
 
+def test_lib_with_pch(tmp_project: Project) -> None:
+    """
+    Test that the header named by the library manifest is included before each
+    source file of the library.
+    """
+    tmp_project.write('src/foo/pch.hpp', '#pragma once\n#include <string>\n')
+    tmp_project.write('src/foo/foo.cpp', 'std::string foo() { return "foo"; }')
+    tmp_project.library_json = {'name': 'foo', 'pch': 'src/foo/pch.hpp'}
+    tmp_project.build()
+    assert list(tmp_project.build_root.glob('libfoo.*')) != [], 'No archive was created'
+
+
 def test_lib_with_just_test(tmp_project: Project) -> None:
     tmp_project.write('src/foo.test.cpp', 'int main() {}')
     tmp_project.build()